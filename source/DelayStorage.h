@@ -0,0 +1,127 @@
+//  Copyright (c) 2022 Arne Scheffler
+//  This code is distributed under the terms of the GNU General Public License
+
+//  MVerb is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  at your option) any later version.
+//
+//  MVerb is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this MVerb.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef DELAYSTORAGE_H
+#define DELAYSTORAGE_H
+
+#include <cstdint>
+#include <cstring>
+
+#include "IsaNamespace.h"
+
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+MVERB_NAMESPACE_BEGIN
+
+//sample formats for the memory of the delay lines. The lines always compute in T, they convert
+//with DelayStorage<T, S>::Load on every read and with Store on every write. Storing 16 bit halves
+//the memory of an engine and the bandwidth the lines need. A sample of all zero bits is 0 in
+//every format, so zeroed memory is a silent line.
+//16 bit fixed point is no option: a tail decays by 100 dB and more in the lines and would end in
+//the rounding noise and limit cycles of the last bits.
+
+//IEEE 754 binary16: 11 bit mantissa with the range of a float down to 6e-8, converted with
+//F16C where the compiler targets it (e.g. -mf16c or -march=native)
+struct HalfSample
+{
+    uint16_t bits;
+};
+
+template<typename T, typename S>
+struct DelayStorage
+{
+    static T Load(S sample)
+    {
+        return sample;
+    }
+
+    static S Store(T value)
+    {
+        return value;
+    }
+};
+
+template<typename T>
+struct DelayStorage<T, HalfSample>
+{
+    static T Load(HalfSample sample)
+    {
+#if defined(__F16C__)
+        return _cvtsh_ss(sample.bits);
+#else
+        //exponent rebiased, subnormal halves normalized by a float subtraction
+        const uint32_t shiftedExponent = 0x7c00u << 13;
+        uint32_t bits = (sample.bits & 0x7fffu) << 13;
+        uint32_t exponent = bits & shiftedExponent;
+        bits += (127 - 15) << 23;
+        if(exponent == shiftedExponent)
+            bits += (128 - 16) << 23;
+        else if(exponent == 0){
+            bits += 1 << 23;
+            bits = fromFloat(toFloat(bits) - toFloat(113u << 23));
+        }
+        bits |= uint32_t(sample.bits & 0x8000u) << 16;
+        return toFloat(bits);
+#endif
+    }
+
+    //rounds to nearest even
+    static HalfSample Store(T value)
+    {
+#if defined(__F16C__)
+        return {uint16_t(_cvtss_sh(float(value), 0))};
+#else
+        uint32_t bits = fromFloat(float(value));
+        uint32_t sign = bits & 0x80000000u;
+        bits ^= sign;
+        uint16_t result;
+        if(bits >= (127u + 16) << 23)
+            result = bits > 255u << 23 ? 0x7e00 : 0x7c00;
+        else if(bits < 113u << 23){
+            //subnormal half, the float addition rounds the mantissa into place
+            const uint32_t magic = ((127 - 15) + (23 - 10) + 1) << 23;
+            result = uint16_t(fromFloat(toFloat(bits) + toFloat(magic)) - magic);
+        }
+        else{
+            uint32_t odd = (bits >> 13) & 1;
+            bits += ((15u - 127u) << 23) + 0xfff + odd;
+            result = uint16_t(bits >> 13);
+        }
+        return {uint16_t(result | (sign >> 16))};
+#endif
+    }
+
+private:
+    static float toFloat(uint32_t bits)
+    {
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    static uint32_t fromFloat(float value)
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+};
+
+MVERB_NAMESPACE_END
+
+#endif
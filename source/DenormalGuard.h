@@ -0,0 +1,68 @@
+//  Copyright (c) 2022 Arne Scheffler
+//  This code is distributed under the terms of the GNU General Public License
+
+//  MVerb is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  at your option) any later version.
+//
+//  MVerb is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this MVerb.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef DENORMALGUARD_H
+#define DENORMALGUARD_H
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define DENORMALGUARD_SSE 1
+#elif defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__))
+#define DENORMALGUARD_AARCH64 1
+#endif
+
+//flushes subnormal results and operands to zero (FTZ and DAZ on x86, FZ on AArch64) while the
+//guard lives and restores the previous mode afterwards. A reverb tail decays right through the
+//subnormal range where every operation can cost a hundred times as much. Put one around each
+//call into the engine from a thread that does not own the floating point mode, i.e. the host's
+//audio thread. Other targets compile to nothing.
+class DenormalGuard
+{
+public:
+    DenormalGuard()
+    {
+#if DENORMALGUARD_SSE
+        state = _mm_getcsr();
+        _mm_setcsr(state | FlushToZero | DenormalsAreZero);
+#elif DENORMALGUARD_AARCH64
+        __asm__ __volatile__("mrs %0, fpcr" : "=r"(state));
+        __asm__ __volatile__("msr fpcr, %0" : : "r"(state | FlushToZero));
+#endif
+    }
+
+    ~DenormalGuard()
+    {
+#if DENORMALGUARD_SSE
+        _mm_setcsr(state);
+#elif DENORMALGUARD_AARCH64
+        __asm__ __volatile__("msr fpcr, %0" : : "r"(state));
+#endif
+    }
+
+    DenormalGuard(const DenormalGuard&) = delete;
+    DenormalGuard& operator=(const DenormalGuard&) = delete;
+
+private:
+#if DENORMALGUARD_SSE
+    enum : unsigned { FlushToZero = 0x8000, DenormalsAreZero = 0x0040 };
+    unsigned state;
+#elif DENORMALGUARD_AARCH64
+    enum : unsigned long { FlushToZero = 1ul << 24 };
+    unsigned long state;
+#endif
+};
+
+#endif
@@ -0,0 +1,34 @@
+//  Copyright (c) 2022 Arne Scheffler
+//  This code is distributed under the terms of the GNU General Public License
+
+//  MVerb is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  at your option) any later version.
+//
+//  MVerb is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this MVerb.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ISANAMESPACE_H
+#define ISANAMESPACE_H
+
+//with MVERB_ISA_NAMESPACE defined the engine headers declare everything in that namespace. A
+//translation unit compiled for another instruction set then gets types and inline functions of
+//its own, which the linker can not mix up with the ones of the baseline build, see
+//MVerbDispatch.h. Inline functions from outside the engine (the standard library) are not
+//covered, the build makes them local to the object, see CMakeLists.txt. Without it the engine
+//is in the global namespace as always.
+#ifdef MVERB_ISA_NAMESPACE
+#define MVERB_NAMESPACE_BEGIN namespace MVERB_ISA_NAMESPACE {
+#define MVERB_NAMESPACE_END }
+#else
+#define MVERB_NAMESPACE_BEGIN
+#define MVERB_NAMESPACE_END
+#endif
+
+#endif
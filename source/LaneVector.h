@@ -0,0 +1,538 @@
+//  Copyright (c) 2022 Arne Scheffler
+//  This code is distributed under the terms of the GNU General Public License
+
+//  MVerb is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  at your option) any later version.
+//
+//  MVerb is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this MVerb.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef LANEVECTOR_H
+#define LANEVECTOR_H
+
+#include <cstring>
+#include <type_traits>
+
+#include "IsaNamespace.h"
+
+//define LANEVECTOR_SSE2 as 0 to build the portable version on x86 as well
+#ifndef LANEVECTOR_SSE2
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LANEVECTOR_SSE2 1
+#else
+#define LANEVECTOR_SSE2 0
+#endif
+#endif
+
+#if LANEVECTOR_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+MVERB_NAMESPACE_BEGIN
+
+//N samples processed as the lanes of one vector, every operation works on each lane on its
+//own. Each lane gives bit for bit the result of the same scalar code.
+//
+//Scalar operands have to be of type T, other types do not compile so no double constant
+//silently turns into a float one. Code which computes in double for float samples (like the
+//original MVerb expressions do) converts with Widen() and Narrow(). Only up to two lanes (the
+//stereo engine) widen to double, wider vectors of independent reverbs stay in T.
+template<typename T, int N>
+struct LaneVector
+{
+    using Scalar = T;
+    using Wide = LaneVector<typename std::conditional<(N <= 2), double, T>::type, N>;
+
+    T lanes[N];
+
+    LaneVector() = default;
+
+    explicit LaneVector(T value)
+    {
+        for(int k = 0; k < N; k++)
+            lanes[k] = value;
+    }
+
+    LaneVector(T lane0, T lane1)
+    {
+        static_assert(N == 2, "only for two lanes");
+        lanes[0] = lane0;
+        lanes[1] = lane1;
+    }
+
+    static LaneVector Load(const T* input)
+    {
+        LaneVector result;
+        for(int k = 0; k < N; k++)
+            result.lanes[k] = input[k];
+        return result;
+    }
+
+    //lane k is loaded from the interleaved ring buffers of DelayLineLanes, the sample at
+    //base[((position - delays[k]) & mask) * N + k]
+    static LaneVector Gather(const T* base, unsigned position, const int* delays, unsigned mask)
+    {
+        LaneVector result;
+        for(int k = 0; k < N; k++)
+            result.lanes[k] = base[((position - delays[k]) & mask) * N + k];
+        return result;
+    }
+
+    void Store(T* output) const
+    {
+        for(int k = 0; k < N; k++)
+            output[k] = lanes[k];
+    }
+
+    T Get(int lane) const
+    {
+        return lanes[lane];
+    }
+
+    void Set(int lane, T value)
+    {
+        lanes[lane] = value;
+    }
+
+    static LaneVector Min(LaneVector a, const LaneVector& b)
+    {
+        for(int k = 0; k < N; k++)
+            a.lanes[k] = b.lanes[k] < a.lanes[k] ? b.lanes[k] : a.lanes[k];
+        return a;
+    }
+
+    static LaneVector Max(LaneVector a, const LaneVector& b)
+    {
+        for(int k = 0; k < N; k++)
+            a.lanes[k] = a.lanes[k] < b.lanes[k] ? b.lanes[k] : a.lanes[k];
+        return a;
+    }
+
+    //lanes in reverse order, swaps left and right
+    LaneVector Swap() const
+    {
+        LaneVector result;
+        for(int k = 0; k < N; k++)
+            result.lanes[k] = lanes[N - 1 - k];
+        return result;
+    }
+
+    Wide Widen() const
+    {
+        Wide result;
+        for(int k = 0; k < N; k++)
+            result.lanes[k] = lanes[k];
+        return result;
+    }
+
+    static LaneVector Narrow(const Wide& wide)
+    {
+        LaneVector result;
+        for(int k = 0; k < N; k++)
+            result.lanes[k] = static_cast<T>(wide.lanes[k]);
+        return result;
+    }
+
+    friend LaneVector operator+(LaneVector a, const LaneVector& b)
+    {
+        for(int k = 0; k < N; k++)
+            a.lanes[k] = a.lanes[k] + b.lanes[k];
+        return a;
+    }
+
+    friend LaneVector operator-(LaneVector a, const LaneVector& b)
+    {
+        for(int k = 0; k < N; k++)
+            a.lanes[k] = a.lanes[k] - b.lanes[k];
+        return a;
+    }
+
+    friend LaneVector operator*(LaneVector a, const LaneVector& b)
+    {
+        for(int k = 0; k < N; k++)
+            a.lanes[k] = a.lanes[k] * b.lanes[k];
+        return a;
+    }
+
+    friend LaneVector operator-(LaneVector a)
+    {
+        for(int k = 0; k < N; k++)
+            a.lanes[k] = -a.lanes[k];
+        return a;
+    }
+
+    friend LaneVector operator+(const LaneVector& a, T b) { return a + LaneVector(b); }
+    friend LaneVector operator-(const LaneVector& a, T b) { return a - LaneVector(b); }
+    friend LaneVector operator*(const LaneVector& a, T b) { return a * LaneVector(b); }
+    template<typename S> friend LaneVector operator+(const LaneVector&, S) = delete;
+    template<typename S> friend LaneVector operator-(const LaneVector&, S) = delete;
+    template<typename S> friend LaneVector operator*(const LaneVector&, S) = delete;
+
+    LaneVector& operator+=(const LaneVector& b) { return *this = *this + b; }
+};
+
+#if LANEVECTOR_SSE2
+
+//left and right of the double engine in one SSE2 register
+template<>
+struct LaneVector<double, 2>
+{
+    using Scalar = double;
+    using Wide = LaneVector<double, 2>;
+
+    __m128d v;
+
+    LaneVector() = default;
+    explicit LaneVector(__m128d value) : v(value) {}
+    explicit LaneVector(double value) : v(_mm_set1_pd(value)) {}
+    LaneVector(double lane0, double lane1) : v(_mm_set_pd(lane1, lane0)) {}
+
+    static LaneVector Load(const double* input)
+    {
+        return LaneVector(_mm_loadu_pd(input));
+    }
+
+    static LaneVector Gather(const double* base, unsigned position, const int* delays, unsigned mask)
+    {
+        const double* lane0 = base + ((position - delays[0]) & mask) * 2;
+        const double* lane1 = base + ((position - delays[1]) & mask) * 2 + 1;
+        return LaneVector(_mm_loadh_pd(_mm_load_sd(lane0), lane1));
+    }
+
+    void Store(double* output) const
+    {
+        _mm_storeu_pd(output, v);
+    }
+
+    double Get(int lane) const
+    {
+        return lane == 0 ? _mm_cvtsd_f64(v) : _mm_cvtsd_f64(_mm_unpackhi_pd(v, v));
+    }
+
+    void Set(int lane, double value)
+    {
+        v = lane == 0 ? _mm_move_sd(v, _mm_set_sd(value)) : _mm_unpacklo_pd(v, _mm_set_sd(value));
+    }
+
+    static LaneVector Min(LaneVector a, LaneVector b) { return LaneVector(_mm_min_pd(a.v, b.v)); }
+    static LaneVector Max(LaneVector a, LaneVector b) { return LaneVector(_mm_max_pd(a.v, b.v)); }
+
+    LaneVector Swap() const
+    {
+        return LaneVector(_mm_shuffle_pd(v, v, 1));
+    }
+
+    Wide Widen() const
+    {
+        return *this;
+    }
+
+    static LaneVector Narrow(const Wide& wide)
+    {
+        return wide;
+    }
+
+    friend LaneVector operator+(LaneVector a, LaneVector b) { return LaneVector(_mm_add_pd(a.v, b.v)); }
+    friend LaneVector operator-(LaneVector a, LaneVector b) { return LaneVector(_mm_sub_pd(a.v, b.v)); }
+    friend LaneVector operator*(LaneVector a, LaneVector b) { return LaneVector(_mm_mul_pd(a.v, b.v)); }
+    friend LaneVector operator-(LaneVector a) { return LaneVector(_mm_xor_pd(a.v, _mm_set1_pd(-0.))); }
+
+    friend LaneVector operator+(LaneVector a, double b) { return a + LaneVector(b); }
+    friend LaneVector operator-(LaneVector a, double b) { return a - LaneVector(b); }
+    friend LaneVector operator*(LaneVector a, double b) { return a * LaneVector(b); }
+    template<typename S> friend LaneVector operator+(LaneVector, S) = delete;
+    template<typename S> friend LaneVector operator-(LaneVector, S) = delete;
+    template<typename S> friend LaneVector operator*(LaneVector, S) = delete;
+
+    LaneVector& operator+=(LaneVector b) { return *this = *this + b; }
+};
+
+//left and right of the float engine in the lower half of an SSE register. The double
+//expressions of the engine convert to a full SSE2 double register and back.
+template<>
+struct LaneVector<float, 2>
+{
+    using Scalar = float;
+    using Wide = LaneVector<double, 2>;
+
+    __m128 v;
+
+    LaneVector() = default;
+    explicit LaneVector(__m128 value) : v(value) {}
+    explicit LaneVector(float value) : v(_mm_set1_ps(value)) {}
+    LaneVector(float lane0, float lane1) : v(_mm_setr_ps(lane0, lane1, 0.f, 0.f)) {}
+
+    //both lanes as one 64 bit move, through memcpy as the floats must not be accessed as a double
+    static LaneVector Load(const float* input)
+    {
+        double pair;
+        memcpy(&pair, input, sizeof(pair));
+        return LaneVector(_mm_castpd_ps(_mm_set_sd(pair)));
+    }
+
+    static LaneVector Gather(const float* base, unsigned position, const int* delays, unsigned mask)
+    {
+        const float* lane0 = base + ((position - delays[0]) & mask) * 2;
+        const float* lane1 = base + ((position - delays[1]) & mask) * 2 + 1;
+        return LaneVector(_mm_unpacklo_ps(_mm_load_ss(lane0), _mm_load_ss(lane1)));
+    }
+
+    void Store(float* output) const
+    {
+        double pair = _mm_cvtsd_f64(_mm_castps_pd(v));
+        memcpy(output, &pair, sizeof(pair));
+    }
+
+    float Get(int lane) const
+    {
+        return lane == 0 ? _mm_cvtss_f32(v) : _mm_cvtss_f32(_mm_shuffle_ps(v, v, 1));
+    }
+
+    void Set(int lane, float value)
+    {
+        *this = lane == 0 ? LaneVector(value, Get(1)) : LaneVector(Get(0), value);
+    }
+
+    static LaneVector Min(LaneVector a, LaneVector b) { return LaneVector(_mm_min_ps(a.v, b.v)); }
+    static LaneVector Max(LaneVector a, LaneVector b) { return LaneVector(_mm_max_ps(a.v, b.v)); }
+
+    LaneVector Swap() const
+    {
+        return LaneVector(_mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 2, 0, 1)));
+    }
+
+    Wide Widen() const
+    {
+        return Wide(_mm_cvtps_pd(v));
+    }
+
+    static LaneVector Narrow(const Wide& wide)
+    {
+        return LaneVector(_mm_cvtpd_ps(wide.v));
+    }
+
+    friend LaneVector operator+(LaneVector a, LaneVector b) { return LaneVector(_mm_add_ps(a.v, b.v)); }
+    friend LaneVector operator-(LaneVector a, LaneVector b) { return LaneVector(_mm_sub_ps(a.v, b.v)); }
+    friend LaneVector operator*(LaneVector a, LaneVector b) { return LaneVector(_mm_mul_ps(a.v, b.v)); }
+    friend LaneVector operator-(LaneVector a) { return LaneVector(_mm_xor_ps(a.v, _mm_set1_ps(-0.f))); }
+
+    friend LaneVector operator+(LaneVector a, float b) { return a + LaneVector(b); }
+    friend LaneVector operator-(LaneVector a, float b) { return a - LaneVector(b); }
+    friend LaneVector operator*(LaneVector a, float b) { return a * LaneVector(b); }
+    template<typename S> friend LaneVector operator+(LaneVector, S) = delete;
+    template<typename S> friend LaneVector operator-(LaneVector, S) = delete;
+    template<typename S> friend LaneVector operator*(LaneVector, S) = delete;
+
+    LaneVector& operator+=(LaneVector b) { return *this = *this + b; }
+};
+
+//the lane types of MVerbBatch: four, eight or sixteen independent reverbs, computed in float
+
+template<>
+struct LaneVector<float, 4>
+{
+    using Scalar = float;
+    using Wide = LaneVector<float, 4>;
+
+    __m128 v;
+
+    LaneVector() = default;
+    explicit LaneVector(__m128 value) : v(value) {}
+    explicit LaneVector(float value) : v(_mm_set1_ps(value)) {}
+
+    static LaneVector Load(const float* input) { return LaneVector(_mm_loadu_ps(input)); }
+
+    static LaneVector Gather(const float* base, unsigned position, const int* delays, unsigned mask)
+    {
+        return LaneVector(_mm_setr_ps(base[((position - delays[0]) & mask) * 4],
+                                      base[((position - delays[1]) & mask) * 4 + 1],
+                                      base[((position - delays[2]) & mask) * 4 + 2],
+                                      base[((position - delays[3]) & mask) * 4 + 3]));
+    }
+
+    void Store(float* output) const { _mm_storeu_ps(output, v); }
+
+    float Get(int lane) const
+    {
+        alignas(16) float values[4];
+        _mm_store_ps(values, v);
+        return values[lane];
+    }
+
+    void Set(int lane, float value)
+    {
+        alignas(16) float values[4];
+        _mm_store_ps(values, v);
+        values[lane] = value;
+        v = _mm_load_ps(values);
+    }
+
+    Wide Widen() const { return *this; }
+    static LaneVector Narrow(const Wide& wide) { return wide; }
+
+    static LaneVector Min(LaneVector a, LaneVector b) { return LaneVector(_mm_min_ps(a.v, b.v)); }
+    static LaneVector Max(LaneVector a, LaneVector b) { return LaneVector(_mm_max_ps(a.v, b.v)); }
+
+    //lanes in reverse order, crosses the halves of both tanks of MVerbSurround
+    LaneVector Swap() const { return LaneVector(_mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 1, 2, 3))); }
+
+    friend LaneVector operator+(LaneVector a, LaneVector b) { return LaneVector(_mm_add_ps(a.v, b.v)); }
+    friend LaneVector operator-(LaneVector a, LaneVector b) { return LaneVector(_mm_sub_ps(a.v, b.v)); }
+    friend LaneVector operator*(LaneVector a, LaneVector b) { return LaneVector(_mm_mul_ps(a.v, b.v)); }
+    friend LaneVector operator-(LaneVector a) { return LaneVector(_mm_xor_ps(a.v, _mm_set1_ps(-0.f))); }
+
+    friend LaneVector operator+(LaneVector a, float b) { return a + LaneVector(b); }
+    friend LaneVector operator-(LaneVector a, float b) { return a - LaneVector(b); }
+    friend LaneVector operator*(LaneVector a, float b) { return a * LaneVector(b); }
+    template<typename S> friend LaneVector operator+(LaneVector, S) = delete;
+    template<typename S> friend LaneVector operator-(LaneVector, S) = delete;
+    template<typename S> friend LaneVector operator*(LaneVector, S) = delete;
+
+    LaneVector& operator+=(LaneVector b) { return *this = *this + b; }
+};
+
+#endif
+
+#if defined(__AVX2__)
+
+template<>
+struct LaneVector<float, 8>
+{
+    using Scalar = float;
+    using Wide = LaneVector<float, 8>;
+
+    __m256 v;
+
+    LaneVector() = default;
+    explicit LaneVector(__m256 value) : v(value) {}
+    explicit LaneVector(float value) : v(_mm256_set1_ps(value)) {}
+
+    static LaneVector Load(const float* input) { return LaneVector(_mm256_loadu_ps(input)); }
+
+    //the offsets are computed in an integer vector as well
+    static LaneVector Gather(const float* base, unsigned position, const int* delays, unsigned mask)
+    {
+        __m256i offsets = _mm256_sub_epi32(_mm256_set1_epi32(position),
+                                           _mm256_loadu_si256(reinterpret_cast<const __m256i*>(delays)));
+        offsets = _mm256_and_si256(offsets, _mm256_set1_epi32(mask));
+        offsets = _mm256_add_epi32(_mm256_slli_epi32(offsets, 3), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+        return LaneVector(_mm256_i32gather_ps(base, offsets, 4));
+    }
+
+    void Store(float* output) const { _mm256_storeu_ps(output, v); }
+
+    float Get(int lane) const
+    {
+        alignas(32) float values[8];
+        _mm256_store_ps(values, v);
+        return values[lane];
+    }
+
+    void Set(int lane, float value)
+    {
+        alignas(32) float values[8];
+        _mm256_store_ps(values, v);
+        values[lane] = value;
+        v = _mm256_load_ps(values);
+    }
+
+    Wide Widen() const { return *this; }
+    static LaneVector Narrow(const Wide& wide) { return wide; }
+
+    static LaneVector Min(LaneVector a, LaneVector b) { return LaneVector(_mm256_min_ps(a.v, b.v)); }
+    static LaneVector Max(LaneVector a, LaneVector b) { return LaneVector(_mm256_max_ps(a.v, b.v)); }
+
+    friend LaneVector operator+(LaneVector a, LaneVector b) { return LaneVector(_mm256_add_ps(a.v, b.v)); }
+    friend LaneVector operator-(LaneVector a, LaneVector b) { return LaneVector(_mm256_sub_ps(a.v, b.v)); }
+    friend LaneVector operator*(LaneVector a, LaneVector b) { return LaneVector(_mm256_mul_ps(a.v, b.v)); }
+    friend LaneVector operator-(LaneVector a) { return LaneVector(_mm256_xor_ps(a.v, _mm256_set1_ps(-0.f))); }
+
+    friend LaneVector operator+(LaneVector a, float b) { return a + LaneVector(b); }
+    friend LaneVector operator-(LaneVector a, float b) { return a - LaneVector(b); }
+    friend LaneVector operator*(LaneVector a, float b) { return a * LaneVector(b); }
+    template<typename S> friend LaneVector operator+(LaneVector, S) = delete;
+    template<typename S> friend LaneVector operator-(LaneVector, S) = delete;
+    template<typename S> friend LaneVector operator*(LaneVector, S) = delete;
+
+    LaneVector& operator+=(LaneVector b) { return *this = *this + b; }
+};
+
+#endif
+
+#if defined(__AVX512F__)
+
+template<>
+struct LaneVector<float, 16>
+{
+    using Scalar = float;
+    using Wide = LaneVector<float, 16>;
+
+    __m512 v;
+
+    LaneVector() = default;
+    explicit LaneVector(__m512 value) : v(value) {}
+    explicit LaneVector(float value) : v(_mm512_set1_ps(value)) {}
+
+    static LaneVector Load(const float* input) { return LaneVector(_mm512_loadu_ps(input)); }
+
+    static LaneVector Gather(const float* base, unsigned position, const int* delays, unsigned mask)
+    {
+        __m512i offsets = _mm512_sub_epi32(_mm512_set1_epi32(position), _mm512_loadu_si512(delays));
+        offsets = _mm512_and_si512(offsets, _mm512_set1_epi32(mask));
+        //the masked forms, the plain ones start from an undefined register gcc warns about
+        offsets = _mm512_add_epi32(_mm512_mask_slli_epi32(offsets, 0xffff, offsets, 4),
+                                   _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+        return LaneVector(_mm512_mask_i32gather_ps(_mm512_setzero_ps(), 0xffff, offsets, base, 4));
+    }
+
+    void Store(float* output) const { _mm512_storeu_ps(output, v); }
+
+    float Get(int lane) const
+    {
+        alignas(64) float values[16];
+        _mm512_store_ps(values, v);
+        return values[lane];
+    }
+
+    void Set(int lane, float value)
+    {
+        v = _mm512_mask_mov_ps(v, static_cast<__mmask16>(1u << lane), _mm512_set1_ps(value));
+    }
+
+    Wide Widen() const { return *this; }
+    static LaneVector Narrow(const Wide& wide) { return wide; }
+
+    //masked like Gather
+    static LaneVector Min(LaneVector a, LaneVector b) { return LaneVector(_mm512_mask_min_ps(a.v, 0xffff, a.v, b.v)); }
+    static LaneVector Max(LaneVector a, LaneVector b) { return LaneVector(_mm512_mask_max_ps(a.v, 0xffff, a.v, b.v)); }
+
+    friend LaneVector operator+(LaneVector a, LaneVector b) { return LaneVector(_mm512_add_ps(a.v, b.v)); }
+    friend LaneVector operator-(LaneVector a, LaneVector b) { return LaneVector(_mm512_sub_ps(a.v, b.v)); }
+    friend LaneVector operator*(LaneVector a, LaneVector b) { return LaneVector(_mm512_mul_ps(a.v, b.v)); }
+    friend LaneVector operator-(LaneVector a) { return a * -1.f; }
+
+    friend LaneVector operator+(LaneVector a, float b) { return a + LaneVector(b); }
+    friend LaneVector operator-(LaneVector a, float b) { return a - LaneVector(b); }
+    friend LaneVector operator*(LaneVector a, float b) { return a * LaneVector(b); }
+    template<typename S> friend LaneVector operator+(LaneVector, S) = delete;
+    template<typename S> friend LaneVector operator-(LaneVector, S) = delete;
+    template<typename S> friend LaneVector operator*(LaneVector, S) = delete;
+
+    LaneVector& operator+=(LaneVector b) { return *this = *this + b; }
+};
+
+#endif
+
+MVERB_NAMESPACE_END
+
+#endif
@@ -17,29 +17,1000 @@
 #ifndef EMVERB_H
 #define EMVERB_H
 
-//forward declaration
-template<typename T, int maxLength> class Allpass;
-template<typename T, int maxLength> class StaticAllpassFourTap;
-template<typename T, int maxLength> class StaticDelayLine;
-template<typename T, int maxLength> class StaticDelayLineFourTap;
-template<typename T, int maxLength> class StaticDelayLineEightTap;
-template<typename T, int OverSampleCount> class StateVariable;
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "DelayStorage.h"
+#include "IsaNamespace.h"
+#include "LaneVector.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+//with MVERB_COUNT_SUBNORMALS set to 1 the delay lines count the subnormal samples written to
+//them, see MVerb::getSubnormalCount. It is on in debug builds.
+#ifndef MVERB_COUNT_SUBNORMALS
+#ifdef NDEBUG
+#define MVERB_COUNT_SUBNORMALS 0
+#else
+#define MVERB_COUNT_SUBNORMALS 1
+#endif
+#endif
+
+MVERB_NAMESPACE_BEGIN
+
+//forward declaration, S is the sample format of the delay memory, see DelayStorage.h
+template<typename T, int NumLanes = 1, typename S = T> class Allpass;
+template<typename T, int NumLanes, int NumTaps, typename S = T> class StaticAllpassTaps;
+template<typename T, int NumLanes = 1, typename S = T> class StaticDelayLine;
+template<typename T, int NumLanes, int NumTaps, typename S = T> class StaticDelayLineTaps;
+template<typename T, int OverSampleCount, int NumLanes> class StateVariable;
+template<typename T, int NumLanes> class TptLowpass;
+template<template<typename, int> class Filter, typename T, int NumLanes> class WideLowpass;
+template<typename T, int NumLanes> class OnePoleLowpass;
+template<typename T, int NumLanes> class Decimator;
+template<typename T, int NumLanes> class Interpolator;
+
+//the tank and early reflection lines of the stereo engine
+template<typename T, int NumLanes, typename S = T> using StaticAllpassFourTap = StaticAllpassTaps<T, NumLanes, 4, S>;
+template<typename T, int NumLanes, typename S = T> using StaticDelayLineFourTap = StaticDelayLineTaps<T, NumLanes, 4, S>;
+template<typename T, int NumLanes, typename S = T> using StaticDelayLineEightTap = StaticDelayLineTaps<T, NumLanes, 8, S>;
+
+//the Chamberlin filter MVerb used originally, four times oversampled
+template<typename T, int NumLanes> using OversampledStateVariable = StateVariable<T, 4, NumLanes>;
+
+//the filters with their state in double, for a float engine fed with double buffers
+template<typename T, int NumLanes> using WideStateVariable = WideLowpass<OversampledStateVariable, T, NumLanes>;
+template<typename T, int NumLanes> using WideTptLowpass = WideLowpass<TptLowpass, T, NumLanes>;
+
+//default stage probe, compiles to nothing. A probe gets start() at the beginning of each
+//process call and mark(stage) whenever the work of that stage is done, see source/bench.
+struct MVerbNullProbe
+{
+    void start() {}
+    void mark(int) {}
+};
+
+static constexpr int CacheLineSize = 64;
 
+//asks for the cache line holding address ahead of a read, a no-op where there is no hint
+inline void PrefetchCacheLine(const void* address)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(address, 0, 3);
+#elif LANEVECTOR_SSE2
+    _mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#else
+    (void)address;
+#endif
+}
+
+//delay lines use a power of two sized ring buffer with a single write position. Reads are
+//the write position minus a delay through a bit mask, so neither the line nor its taps
+//need any compare or wrap around per sample.
+//Lines are processed in blocks of up to DelayLineMaxBlock samples and their taps are read
+//after the whole block was written, the extra capacity keeps those samples from being
+//overwritten before.
+static constexpr int DelayLineMaxBlock = 64;
+
+inline int DelayLineCapacity(int maxLength)
+{
+	int capacity = 1;
+	while(capacity < maxLength + DelayLineMaxBlock)
+		capacity <<= 1;
+	return capacity;
+}
+
+//one zeroed, cache line aligned block of memory holding all delay lines of an MVerb instance.
+//Optionally backed by transparent huge pages on Linux to save TLB entries.
+//Where mmap is available the block is mapped from fresh zero pages instead of being cleared
+//with memset. Allocate() faults every page in, so the first pass of process() over the lines
+//takes no page faults on the audio thread. The lines only clear what they wrote since.
 template<typename T>
+class DelayArena
+{
+private:
+    static constexpr size_t HugePageSize = 2 * 1024 * 1024;
+
+    T* memory;
+    size_t numBytes;
+    bool hugePages;
+    bool mapped;
+
+public:
+    DelayArena()
+    {
+        memory = nullptr;
+        numBytes = 0;
+        hugePages = false;
+        mapped = false;
+    }
+
+    ~DelayArena()
+    {
+        Release();
+    }
+
+    DelayArena(const DelayArena&) = delete;
+    DelayArena& operator=(const DelayArena&) = delete;
+
+    //not realtime safe
+    void Allocate(size_t numSamples, bool useHugePages)
+    {
+        Release();
+        numBytes = numSamples * sizeof(T);
+#if defined(__unix__) || defined(__APPLE__)
+        size_t alignment = sysconf(_SC_PAGESIZE);
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        if(useHugePages)
+            alignment = HugePageSize;
+#endif
+        numBytes = (numBytes + alignment - 1) / alignment * alignment;
+        //mappings are page aligned, a huge page aligned one is cut out of a larger mapping
+        size_t mappedBytes = numBytes + (alignment > (size_t)sysconf(_SC_PAGESIZE) ? alignment : 0);
+        void* ptr = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(ptr != MAP_FAILED){
+            char* begin = static_cast<char*>(ptr);
+            char* start = begin + (alignment - reinterpret_cast<uintptr_t>(begin) % alignment) % alignment;
+            if(start > begin)
+                munmap(begin, start - begin);
+            if(begin + mappedBytes > start + numBytes)
+                munmap(start + numBytes, begin + mappedBytes - (start + numBytes));
+            memory = reinterpret_cast<T*>(start);
+            mapped = true;
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+            if(useHugePages)
+                hugePages = madvise(start, numBytes, MADV_HUGEPAGE) == 0;
+#endif
+            //a write per page, after madvise so that huge pages are faulted in as such
+            const size_t pageSize = sysconf(_SC_PAGESIZE);
+            for(size_t i = 0; i < numBytes; i += pageSize)
+                static_cast<volatile char*>(start)[i] = 0;
+            return;
+        }
+#endif
+        (void)useHugePages;
+        numBytes = (numBytes + CacheLineSize - 1) / CacheLineSize * CacheLineSize;
+        memory = static_cast<T*>(::operator new(numBytes, std::align_val_t(CacheLineSize)));
+        memset(memory, 0, numBytes);
+    }
+
+    void Release()
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        if(mapped)
+            munmap(memory, numBytes);
+#endif
+        if(memory && !mapped)
+            ::operator delete(memory, std::align_val_t(CacheLineSize));
+        memory = nullptr;
+        numBytes = 0;
+        hugePages = false;
+        mapped = false;
+    }
+
+    T* GetData() const
+    {
+        return memory;
+    }
+
+    size_t GetSize() const
+    {
+        return numBytes;
+    }
+
+    bool UsesHugePages() const
+    {
+        return hugePages;
+    }
+};
+
+//line lengths and tap positions in seconds, shared by MVerb and MVerbBatch. Where the channels
+//differ the tables are [left, right], tank lines are scaled by Size.
+struct MVerbTopology
+{
+    static constexpr double AllpassTimes[4] = {0.0048, 0.0036, 0.0127, 0.0093};
+    static constexpr double AllpassFeedback[4] = {0.75, 0.75, 0.625, 0.625};
+    static constexpr double TankAllpassTimes[2][2] = {{0.020, 0.030}, {0.060, 0.089}};
+    static constexpr double TankDelayLineTimes[2][2] = {{0.15, 0.14}, {0.12, 0.11}};
+    static constexpr double EarlyReflectionsTimes[2] = {0.089, 0.069};
+    static constexpr double MaxPredelayTime = 0.2;
+    static constexpr double MaxSize = 1.;
+
+    static constexpr double TankAllpassTaps[2][2][4] = {{{0, 0, 0, 0}, {0, 0, 0, 0}},
+                                                        {{0, 0.006, 0.041, 0}, {0, 0.031, 0.011, 0}}};
+    static constexpr double TankDelayLineTaps[2][2][4] = {{{0, 0.067, 0.011, 0.121}, {0, 0.0089, 0.099, 0}},
+                                                          {{0, 0.036, 0.089, 0}, {0, 0.067, 0.0041, 0}}};
+    static constexpr double EarlyReflectionsTaps[2][8] = {{0, 0.0199, 0.0219, 0.0354, 0.0389, 0.0414, 0.0692, 0},
+                                                          {0, 0.0099, 0.011, 0.0182, 0.0189, 0.0213, 0.0431, 0}};
+
+    //the early reflections add these taps of their line to its output, in both lanes
+    struct EarlyTap
+    {
+        int tap;
+        double gain;
+    };
+    static constexpr EarlyTap EarlyReflectionsOutputTaps[6] = {{2, 0.6}, {3, 0.4}, {4, 0.3}, {5, 0.3}, {6, 0.1}, {7, 0.1}};
+
+    //the late output sums gain times a tap of one of the tank lines. The left output reads lane
+    //lanes[0] at taps[0], the right output mirrors it with lanes[1] and taps[1]. Each output
+    //subtracts the taps of its own half, those of the opposite half are mostly added.
+    enum { TANK_ALLPASS_0 = 0, TANK_DELAYLINE_0, TANK_ALLPASS_1, TANK_DELAYLINE_1, NUM_TANK_LINES };
+    struct LateTap
+    {
+        int line;
+        int lanes[2];
+        int taps[2];
+        double gain;
+    };
+    static constexpr LateTap LateOutputTaps[7] = {{TANK_DELAYLINE_0, {1, 0}, {1, 2}, 0.6},
+                                                  {TANK_DELAYLINE_0, {1, 0}, {2, 3}, 0.6},
+                                                  {TANK_ALLPASS_1, {1, 0}, {1, 2}, -0.6},
+                                                  {TANK_DELAYLINE_1, {1, 0}, {1, 2}, 0.6},
+                                                  {TANK_DELAYLINE_0, {0, 1}, {1, 3}, -0.6},
+                                                  {TANK_ALLPASS_1, {0, 1}, {1, 2}, -0.6},
+                                                  {TANK_DELAYLINE_1, {0, 1}, {1, 2}, -0.6}};
+
+    //the range of taps the outputs read from a tank line, first > last if they read none
+    static constexpr int FirstLateTap(int line){
+        int first = 1 << 30;
+        for(const auto& tap : LateOutputTaps)
+            if(tap.line == line)
+                first = std::min(first, std::min(tap.taps[0], tap.taps[1]));
+        return first;
+    }
+
+    static constexpr int LastLateTap(int line){
+        int last = -1;
+        for(const auto& tap : LateOutputTaps)
+            if(tap.line == line)
+                last = std::max(last, std::max(tap.taps[0], tap.taps[1]));
+        return last;
+    }
+
+    static constexpr int FirstEarlyTap(){
+        int first = 1 << 30;
+        for(const auto& tap : EarlyReflectionsOutputTaps)
+            first = std::min(first, tap.tap);
+        return first;
+    }
+
+    static constexpr int LastEarlyTap(){
+        int last = -1;
+        for(const auto& tap : EarlyReflectionsOutputTaps)
+            last = std::max(last, tap.tap);
+        return last;
+    }
+
+    //sets the taps of one lane of line to times * sampleRate * scale samples
+    template<typename Line, typename T, int NumTaps>
+    static void SetTaps(Line& line, int lane, const double (&times)[NumTaps], T sampleRate, T scale){
+        int indices[NumTaps];
+        for(int i=0;i<NumTaps;i++)
+            indices[i] = times[i] * sampleRate * scale;
+        line.SetIndex(lane, indices);
+    }
+};
+
+//the halfband stages of a rate change by 2 or 4. The stage at the low rate has the narrow
+//transition: flat up to 20kHz and more than 60dB down from 28kHz at a low rate of 48kHz, so
+//nothing folds back below 20kHz. The first stage of a change by 4 only has to keep the band
+//that the second one folds there.
+struct ResamplerStages
+{
+    enum { LowK = 12, HighK = 4 };
+    static constexpr double LowBeta = 6., HighBeta = 5.;
+
+    //high rate samples the filters span, at most
+    static int GetLength(int factor)
+    {
+        return factor == 4 ? 4 * HighK - 1 + 2 * (4 * LowK - 1) : 4 * LowK - 1;
+    }
+};
+
+//Lowpass is the filter of the input bandwidth and of the tank damping, OversampledStateVariable
+//(the original filter), WideStateVariable, TptLowpass, WideTptLowpass or OnePoleLowpass. The
+//TPT filters are cheaper but do not match the original response near Nyquist, a different
+//damping changes the sound, so they have to be chosen explicitly. Storage is the sample format of the delay lines, T or HalfSample (see
+//DelayStorage.h). Topology holds the line lengths and the taps, see MVerbTopology; the tap sums of
+//the outputs are generated from its tables at compile time.
+template<typename T, typename Probe = MVerbNullProbe, template<typename, int> class Lowpass = OversampledStateVariable, typename Storage = T,
+         typename Topology = MVerbTopology>
 class MVerb
 {
+public:
+    //parameters, rates, delay lengths, fades and filter coefficients are set up in the type the
+    //filters take their cutoff in, double with the Wide filters. A float engine fed with double
+    //buffers then gets the line lengths of a double engine, only the per sample state is in T.
+    using Control = typename Lowpass<T,2>::Control;
+
 private:
-    Allpass<T, 96000> allpass[4];
-    StaticAllpassFourTap<T, 96000> allpassFourTap[4];
-    StateVariable<T,4> bandwidthFilter[2];
-    StateVariable<T,4> damping[2];
-    StaticDelayLine<T, 96000> predelay;
-    StaticDelayLineFourTap<T, 96000> staticDelayLine[4];
-    StaticDelayLineEightTap<T, 96000> earlyReflectionsDelayLine[2];
-    T SampleRate, DampingFreq, Density1, Density2, BandwidthFreq, PreDelayTime, Decay, Gain, Mix, EarlyMix, Size;
-    T MixSmooth, EarlyLateSmooth, BandwidthSmooth, DampingSmooth, PredelaySmooth, SizeSmooth, DensitySmooth, DecaySmooth;
+    //left and right are processed as the two lanes of a vector, see LaneVector
+    using Stereo = LaneVector<T, 2>;
+    using StereoWide = typename Stereo::Wide;
+    using Mono = LaneVector<T, 1>;
+    enum { LEFT = 0, RIGHT };
+    enum { MaxBlockSize = DelayLineMaxBlock };
+
+    //line state in the order the per sample loop touches it, the buffers live in arena. The
+    //mirrored lines of both channels and of both tank halves share one object, tankAllpass[0]
+    //holds the first allpass of the left (lane 0) and the right (lane 1) half and so on.
+    Lowpass<T,2> bandwidthFilter;
+    Lowpass<T,1> monoBandwidthFilter;
+    StaticDelayLineEightTap<T,2,Storage> earlyReflectionsDelayLine;
+    StaticDelayLine<T,1,Storage> predelay;
+    Allpass<T,1,Storage> allpass[4];
+    StaticAllpassFourTap<T,2,Storage> tankAllpass[2];
+    StaticDelayLineFourTap<T,2,Storage> tankDelayLine[2];
+    Lowpass<T,2> damping;
+    //around the stages that run at TankRate, see processChunksReduced()
+    Decimator<T,2> decimator;
+    Interpolator<T,2> interpolator;
+
+    //state read or written every sample, kept on cache lines of its own
+    alignas(CacheLineSize) T MixSmooth;
+    T EarlyLateSmooth, DensitySmooth, DecaySmooth;
+    Control BandwidthSmooth, DampingSmooth, PredelaySmooth, SizeSmooth;
     T PreviousLeftTank, PreviousRightTank;
+    T Density1, Density2, Gain, EarlyMix;
     int ControlRate, ControlRateCounter;
+    int RatePhase;
+    bool MixSettled, DecaySettled;
+    //samples since the input and the tank last reached SleepThreshold, see process()
+    int QuietSamples;
+    unsigned SilentChannels;
+    bool Sleeping;
+
+    //per sample values of the parameters used every sample, see process()
+    alignas(CacheLineSize) T MixRamp[MaxBlockSize];
+    T DecayRamp[MaxBlockSize], Density2Ramp[MaxBlockSize];
+
+    alignas(CacheLineSize) Control SampleRate;
+    //rate of the diffusion and the tank, SampleRate / RateDivider
+    Control TankRate;
+    int RateDivider;
+    bool ReducedEarlyReflections;
+    Control DampingFreq, BandwidthFreq, PreDelayTime, Size;
+    T Decay, Mix;
+    Control TankSize;
+    T SleepThreshold;
+    int SleepSamples;
+    int NumInputs, NumOutputs;
+    bool TankCleared;
+    bool UseHugePages;
+    DelayArena<Storage> arena;
+    Probe probe;
+
+    enum { NUM_DELAYLINES = 10 };
+
+    static int maxLineLength(double time, Control sampleRate){
+        return (int)(time * sampleRate) + 1;
+    }
+
+    static int maxLineLength(const double (&times)[2], Control sampleRate){
+        return maxLineLength(std::max(times[0], times[1]), sampleRate);
+    }
+
+    //every line starts on a cache line of its own
+    static size_t paddedLength(int length, int numLanes){
+        const size_t samplesPerCacheLine = CacheLineSize / sizeof(Storage);
+        size_t capacity = DelayLineCapacity(length) * numLanes;
+        return (capacity + samplesPerCacheLine - 1) / samplesPerCacheLine * samplesPerCacheLine;
+    }
+
+    //maximum line lengths and lanes in arena order: early reflections, predelay, input
+    //allpasses and then each tank allpass next to the delay line it feeds. The early
+    //reflections run at earlyRate, all other lines at tankRate.
+    static void getMaxLineLengths(Control earlyRate, Control tankRate, int lengths[NUM_DELAYLINES], int lanes[NUM_DELAYLINES]){
+        lengths[0] = maxLineLength(Topology::EarlyReflectionsTimes, earlyRate);
+        lanes[0] = 2;
+        lengths[1] = maxLineLength(Topology::MaxPredelayTime, tankRate);
+        lanes[1] = 1;
+        for(int j=0;j<4;j++){
+            lengths[2+j] = maxLineLength(Topology::AllpassTimes[j], tankRate);
+            lanes[2+j] = 1;
+        }
+        for(int j=0;j<2;j++){
+            lengths[6+2*j] = maxLineLength(Topology::TankAllpassTimes[j], tankRate * Topology::MaxSize);
+            lengths[7+2*j] = maxLineLength(Topology::TankDelayLineTimes[j], tankRate * Topology::MaxSize);
+            lanes[6+2*j] = lanes[7+2*j] = 2;
+        }
+    }
+
+    static size_t getArenaSize(Control earlyRate, Control tankRate){
+        int lengths[NUM_DELAYLINES], lanes[NUM_DELAYLINES];
+        getMaxLineLengths(earlyRate, tankRate, lengths, lanes);
+        size_t size = 0;
+        for(int j=0;j<NUM_DELAYLINES;j++)
+            size += paddedLength(lengths[j], lanes[j]);
+        return size;
+    }
+
+    void allocateDelayLines(){
+        int lengths[NUM_DELAYLINES], lanes[NUM_DELAYLINES];
+        getMaxLineLengths(earlyRate(), TankRate, lengths, lanes);
+        //a signal passes every line at most once before it has gone round the whole tank, at
+        //a reduced rate also both resampling filters
+        SleepSamples = 0;
+        for(int j=0;j<NUM_DELAYLINES;j++)
+            SleepSamples += lengths[j] * lanes[j] * (j == 0 && !ReducedEarlyReflections ? 1 : RateDivider);
+        if (RateDivider > 1)
+            SleepSamples += 2 * ResamplerStages::GetLength(RateDivider);
+        arena.Allocate(getArenaSize(earlyRate(), TankRate), UseHugePages);
+        Storage* buffer = arena.GetData();
+        int line = 0;
+        auto assign = [&](auto& delayLine){
+            delayLine.SetBuffer(buffer, lengths[line]);
+            buffer += paddedLength(lengths[line], lanes[line]);
+            ++line;
+        };
+        assign(earlyReflectionsDelayLine);
+        assign(predelay);
+        for(int j=0;j<4;j++)
+            assign(allpass[j]);
+        for(int j=0;j<2;j++){
+            assign(tankAllpass[j]);
+            assign(tankDelayLine[j]);
+        }
+    }
+
+    void setTankLengths(Control size){
+        for(int j=0;j<2;j++){
+            for(int lane=LEFT;lane<=RIGHT;lane++){
+                tankAllpass[j].SetLength(lane, Topology::TankAllpassTimes[j][lane] * TankRate * size);
+                tankDelayLine[j].SetLength(lane, Topology::TankDelayLineTimes[j][lane] * TankRate * size);
+                Topology::SetTaps(tankAllpass[j], lane, Topology::TankAllpassTaps[j][lane], TankRate, size);
+                Topology::SetTaps(tankDelayLine[j], lane, Topology::TankDelayLineTaps[j][lane], TankRate, size);
+            }
+        }
+        TankSize = size;
+    }
+
+    //called at every control rate update. A new size crossfades the tank to the new lengths
+    //and taps until the next update, the lines keep their content. ControlRate counts samples
+    //at the full rate, the tank writes one in RateDivider of them.
+    void updateTankLengths(Control size){
+        for(int j=0;j<2;j++){
+            tankAllpass[j].EndFade();
+            tankDelayLine[j].EndFade();
+        }
+        if (size == TankSize)
+            return;
+        for(int j=0;j<2;j++){
+            tankAllpass[j].BeginFade(std::max(ControlRate / RateDivider, 1));
+            tankDelayLine[j].BeginFade(std::max(ControlRate / RateDivider, 1));
+        }
+        setTankLengths(size);
+    }
+
+    //all smoothers at their targets, as process() leaves them at the end of a block
+    void settleSmoothers(){
+        SizeSmooth = Size;
+        MixSmooth = Mix;
+        EarlyLateSmooth = EarlyMix;
+        BandwidthSmooth = (BandwidthFreq * 18400.) + 100.;
+        DampingSmooth = (DampingFreq * 18400.) + 100.;
+        PredelaySmooth = PreDelayTime * 200 * (TankRate / 1000);
+        DecaySmooth = (0.7995f * Decay) + 0.005;
+        DensitySmooth = (0.7995f * Density1) + 0.005;
+    }
+
+    //values of a parameter for n samples stride samples apart, position counts the samples of
+    //the block up to and including the first one
+    static void ramp(T* values, T start, T delta, int position, int n, int stride = 1){
+        for(int i=0;i<n;++i)
+            values[i] = start + T(position + i * stride) * delta;
+    }
+
+    //seconds until the response to a full scale impulse stays below level. Each input allpass
+    //rings until its feedback has decayed to level. The tank loop passes both halves and every
+    //tank line once and each half scales by decay, the allpasses and the damping lowpass have
+    //unity gain at low frequencies. The output sums seven taps of 0.6 at most. Rings in series
+    //decay with the slower one, the other only adds its delay.
+    static T tailTime(T decay, T size, T predelayTime, T gain, T level){
+        double peak = 7 * 0.6 * gain;
+        if (peak <= level)
+            return 0;
+        double delay = predelayTime * Topology::MaxPredelayTime;
+        double ring = 0;
+        for(int j=0;j<4;j++){
+            delay += Topology::AllpassTimes[j];
+            ring = std::max(ring, Topology::AllpassTimes[j] * std::ceil(std::log(double(level)) / std::log(Topology::AllpassFeedback[j])));
+        }
+        double loop = 0;
+        for(int j=0;j<2;j++)
+            for(int lane=LEFT;lane<=RIGHT;lane++)
+                loop += Topology::TankAllpassTimes[j][lane] + Topology::TankDelayLineTimes[j][lane];
+        loop *= size;
+        double loops = std::ceil(std::log(level / peak) / (2 * std::log(double(decay))));
+        ring = std::max(ring, loop * loops);
+        double early = std::max(Topology::EarlyReflectionsTimes[0], Topology::EarlyReflectionsTimes[1]);
+        return std::max(early, delay + loop + ring);
+    }
+
+    //a float engine also takes double buffers. The dry signal and the mix then keep the
+    //precision of the buffers, only the wet signal is computed in float and widened.
+    template<typename Sample> using StereoIO = LaneVector<Sample, 2>;
+
+    template<typename Sample>
+    static StereoIO<Sample> toIO(const Stereo& wet){
+        if constexpr (std::is_same_v<Sample, T>)
+            return wet;
+        else
+            return wet.Widen();
+    }
+
+    //the dry signal of a sample at the precision of the buffers, the engine rounded it to T
+    template<typename Sample>
+    static StereoIO<Sample> dryInput(Sample **inputs, int i, bool stereoInput, const Stereo& dry){
+        if constexpr (std::is_same_v<Sample, T>)
+            return dry;
+        else
+            return stereoInput ? StereoIO<Sample>(inputs[0][i], inputs[1][i]) : StereoIO<Sample>(inputs[0][i]);
+    }
+
+    unsigned allOutputs() const{
+        return (1u << NumOutputs) - 1;
+    }
+
+    //the tail has decayed, clear the lines it touched and stop processing
+    void sleep(){
+        reset();
+        settleSmoothers();
+        Sleeping = true;
+    }
+
+    //true once the input reaches SleepThreshold, the next chunk updates the filters
+    template<typename Sample>
+    bool wake(Sample **inputs, int sampleFrames){
+        int loud = 0;
+        for(int channel=0;channel<NumInputs;channel++)
+            for(int i=0;i<sampleFrames;i++)
+                loud |= std::abs(inputs[channel][i]) >= SleepThreshold;
+        if (!loud)
+            return false;
+        Sleeping = false;
+        ControlRateCounter = ControlRate;
+        return true;
+    }
+
+    //output of a sleeping engine, the late and early signals are zero. A mono input goes to
+    //both outputs.
+    template<typename Sample>
+    void processDry(Sample **inputs, Sample **outputs, int sampleFrames){
+        settleSmoothers();
+        Sample silenceCheckSum[2] = {0., 0.};
+        for(int channel=0;channel<NumOutputs;channel++){
+            const Sample* input = inputs[std::min(channel, NumInputs - 1)];
+            int signal = 0;
+            for(int i=0;i<sampleFrames;i++)
+                signal |= input[i] != 0;
+            if (!signal){
+                std::fill(outputs[channel], outputs[channel] + sampleFrames, Sample(0));
+                continue;
+            }
+            for(int i=0;i<sampleFrames;i++){
+                Sample dry = input[i];
+                Sample output = dry + ( 0 - dry ) * Mix;
+                silenceCheckSum[channel] += std::abs(output);
+                outputs[channel][i] = output * Gain;
+            }
+        }
+        SilentChannels = ((silenceCheckSum[LEFT] <= 1e-7) | (silenceCheckSum[RIGHT] <= 1e-7) << 1) & allOutputs();
+    }
+
+    //rate of the bandwidth filter and the early reflections
+    Control earlyRate() const{
+        return ReducedEarlyReflections ? TankRate : SampleRate;
+    }
+
+    using EarlyTapSequence = std::make_index_sequence<std::extent<decltype(Topology::EarlyReflectionsOutputTaps)>::value>;
+    using LateTapSequence = std::make_index_sequence<std::extent<decltype(Topology::LateOutputTaps)>::value>;
+
+    //the early reflections of a chunk of line outputs, taps are read once the whole chunk is
+    //written and age counts back from its last sample. The terms are summed in table order.
+    template<size_t... I>
+    Stereo earlyReflectionsTaps(const Stereo& line, const StereoWide& direct, int age, std::index_sequence<I...>) const{
+        StereoWide sum = line.Widen();
+        ((sum = sum + earlyReflectionsDelayLine.GetIndex(Topology::EarlyReflectionsOutputTaps[I].tap, age).Widen()
+                      * Topology::EarlyReflectionsOutputTaps[I].gain), ...);
+        return Stereo::Narrow(sum + direct);
+    }
+
+    Stereo earlyReflectionsTaps(const Stereo& line, const StereoWide& direct, int age) const{
+        return earlyReflectionsTaps(line, direct, age, EarlyTapSequence());
+    }
+
+    //the left lane of earlyReflectionsTaps(), for a mono output
+    template<size_t... I>
+    T earlyReflectionsLeft(T line, double direct, int age, std::index_sequence<I...>) const{
+        double sum = line;
+        ((sum = sum + earlyReflectionsDelayLine.GetIndex(LEFT, Topology::EarlyReflectionsOutputTaps[I].tap, age)
+                      * Topology::EarlyReflectionsOutputTaps[I].gain), ...);
+        return T(sum + direct);
+    }
+
+    //the cross mixes are computed in double like the scalar expressions were, lane 1 sums the
+    //same products in the opposite order which gives the same result
+    void processEarlyReflections(const Stereo* bandwidth, Stereo* earlyReflections, int n){
+        for(int i=0;i<n;++i){
+            StereoWide own = bandwidth[i].Widen(), other = bandwidth[i].Swap().Widen();
+            earlyReflections[i] = earlyReflectionsDelayLine(Stereo::Narrow(own * 0.5 + other * 0.3));
+        }
+        for(int i=0, age=n-1;i<n;++i, --age){
+            StereoWide own = bandwidth[i].Widen(), other = bandwidth[i].Swap().Widen();
+            earlyReflections[i] = earlyReflectionsTaps(earlyReflections[i], ( own * 0.4 + other * 0.2 ) * 0.5, age);
+        }
+    }
+
+    //predelay and input allpasses, the predelay of sample i follows the smoother at the block
+    //position position + i * stride
+    void diffuse(T* smearedInput, int n, int position, int stride, Control PredelayDelta){
+        if (PredelayDelta != 0){
+            for(int i=0;i<n;++i){
+                predelay.SetLength(PredelaySmooth + Control(position + i * stride) * PredelayDelta);
+                smearedInput[i] = predelay(smearedInput[i]);
+            }
+        }else{
+            predelay.SetLength(PredelaySmooth);
+            for(int i=0;i<n;++i)
+                smearedInput[i] = predelay(smearedInput[i]);
+        }
+        for(int j=0;j<4;j++)
+            allpass[j].Process(smearedInput, smearedInput, n);
+    }
+
+    //the outputs of the last delay line of each half are written before this chunk (n is at
+    //most their length), which breaks the loop between the two halves. Each half is fed by the
+    //other one, so the previous output enters with its lanes swapped. Decay and density use
+    //DecayRamp and Density2Ramp, which only change while decayMoving. The first allpass, delay
+    //line and damping of each half run in the loop that feeds them, which also writes all of tank.
+    void processTank(const T* smearedInput, int n, bool decayMoving, Stereo& peak){
+        Stereo tank[MaxBlockSize], tankOutput[MaxBlockSize];
+        tankDelayLine[1].ReadAhead(tankOutput, n);
+        Stereo previous(PreviousLeftTank, PreviousRightTank);
+        for(int i=0;i<n;++i){
+            Stereo input = Stereo(smearedInput[i]) + previous.Swap();
+            previous = tankOutput[i] * DecayRamp[i];
+            tank[i] = damping(tankDelayLine[0](tankAllpass[0](input)));
+        }
+        PreviousLeftTank = previous.Get(LEFT);
+        PreviousRightTank = previous.Get(RIGHT);
+        if (decayMoving){
+            for(int i=0;i<n;++i){
+                tankAllpass[1].SetFeedback(Density2Ramp[i]);
+                tank[i] = tankAllpass[1](tank[i]);
+            }
+        }else{
+            tankAllpass[1].SetFeedback(Density2);
+            tankAllpass[1].Process(tank, tank, n);
+        }
+        for(int i=0;i<n;++i)
+            peak = Stereo::Max(peak, Stereo::Max(tank[i], -tank[i]));
+        tankDelayLine[1].Write(tank, n);
+    }
+
+    //the tank line Topology::TANK_ALLPASS_0 and so on
+    template<int Line>
+    const auto& tankLine() const{
+        if constexpr (Line == Topology::TANK_ALLPASS_0)
+            return tankAllpass[0];
+        else if constexpr (Line == Topology::TANK_DELAYLINE_0)
+            return tankDelayLine[0];
+        else if constexpr (Line == Topology::TANK_ALLPASS_1)
+            return tankAllpass[1];
+        else
+            return tankDelayLine[1];
+    }
+
+    template<size_t... Line>
+    void prefetchLateTaps(int n, std::index_sequence<Line...>) const{
+        ((Topology::FirstLateTap(Line) <= Topology::LastLateTap(Line)
+              ? tankLine<Line>().PrefetchTaps(Topology::FirstLateTap(Line), Topology::LastLateTap(Line), n)
+              : void()), ...);
+    }
+
+    //the taps the early reflections and lateTaps() read for the next chunk, requested before
+    //the chunk is processed. They are scattered over the lines and miss the cache on large
+    //sizes, this way the misses overlap with each other and with the work of the stages.
+    void prefetchTaps(int earlyCount, int tankCount) const{
+        earlyReflectionsDelayLine.PrefetchTaps(Topology::FirstEarlyTap(), Topology::LastEarlyTap(), earlyCount);
+        prefetchLateTaps(tankCount, std::make_index_sequence<Topology::NUM_TANK_LINES>());
+    }
+
+    //term I of the late output in both lanes
+    template<size_t I>
+    StereoWide lateTap(int age) const{
+        constexpr auto tap = Topology::LateOutputTaps[I];
+        const auto& line = tankLine<tap.line>();
+        return Stereo(line.GetIndex(tap.lanes[LEFT], tap.taps[LEFT], age),
+                      line.GetIndex(tap.lanes[RIGHT], tap.taps[RIGHT], age)).Widen() * tap.gain;
+    }
+
+    //the late output, summed in table order
+    template<size_t... I>
+    Stereo lateTaps(int age, std::index_sequence<I...>) const{
+        return Stereo::Narrow((... + lateTap<I>(age)));
+    }
+
+    Stereo lateTaps(int age) const{
+        return lateTaps(age, LateTapSequence());
+    }
+
+    //the left lane of lateTaps(), for a mono output
+    template<size_t... I>
+    T lateLeft(int age, std::index_sequence<I...>) const{
+        return T((... + (tankLine<Topology::LateOutputTaps[I].line>().GetIndex(Topology::LateOutputTaps[I].lanes[LEFT],
+                                                                                   Topology::LateOutputTaps[I].taps[LEFT], age)
+                         * Topology::LateOutputTaps[I].gain)));
+    }
+
+    //the chunks of process() for a stereo input, a mono input or a mono input and output
+    template<bool MonoInput, bool MonoOutput, typename Sample>
+    void processChunks(Sample **inputs, Sample **outputs, int sampleFrames){
+        probe.start();
+        StereoIO<Sample> silenceCheckSum(Sample(0));
+        Sample monoCheckSum = 0;
+        //the smoothers hold the values at the start of the block and ramp linearly to their
+        //targets at its end. A parameter at its target has a delta of 0, its per sample values
+        //are computed once when it stops moving and no longer touched after that.
+        Control OneOverSampleFrames = 1. / sampleFrames;
+        T MixDelta	= (Mix - MixSmooth) * OneOverSampleFrames;
+        Control BandwidthDelta = (((BandwidthFreq * 18400.) + 100.) - BandwidthSmooth) * OneOverSampleFrames;
+        Control DampingDelta = (((DampingFreq * 18400.) + 100.) - DampingSmooth) * OneOverSampleFrames;
+        Control PredelayDelta = ((PreDelayTime * 200 * (TankRate / 1000)) - PredelaySmooth) * OneOverSampleFrames;
+        Control SizeDelta	= (Size - SizeSmooth) * OneOverSampleFrames;
+        T DecayDelta = (((0.7995f * Decay) + 0.005) - DecaySmooth) * OneOverSampleFrames;
+        TankCleared = false;
+        for(int offset=0;offset<sampleFrames;){
+            bool updateFilters = ControlRateCounter >= ControlRate;
+            if (updateFilters){
+                ControlRateCounter = 0;
+                //the size the smoother reaches with the first sample of the chunk
+                updateTankLengths(SizeSmooth + Control(offset + 1) * SizeDelta);
+                //the filters skip the coefficient update if the frequency did not change
+                bandwidthFilter.Frequency(BandwidthSmooth + Control(offset + 1) * BandwidthDelta);
+                monoBandwidthFilter.Frequency(BandwidthSmooth + Control(offset + 1) * BandwidthDelta);
+                damping.Frequency(DampingSmooth + Control(offset + 1) * DampingDelta);
+            }
+            int n = std::min(sampleFrames - offset, (int)MaxBlockSize);
+            n = std::min(n, std::max(ControlRate - ControlRateCounter, 1));
+            n = std::min(n, tankDelayLine[1].GetMinLength());
+            ControlRateCounter += n;
+
+            if (MixDelta != 0 || !MixSettled){
+                ramp(MixRamp, MixSmooth, MixDelta, offset + 1, MixDelta != 0 ? n : MaxBlockSize);
+                MixSettled = MixDelta == 0;
+            }
+            if (DecayDelta != 0 || !DecaySettled){
+                int count = DecayDelta != 0 ? n : MaxBlockSize;
+                ramp(DecayRamp, DecaySmooth, DecayDelta, offset + 1, count);
+                for(int i=0;i<count;++i)
+                    Density2Ramp[i] = std::min(std::max(T(DecayRamp[i] + 0.15), T(0.25)), T(0.5));
+                DecaySettled = DecayDelta == 0;
+            }
+            Density2 = Density2Ramp[n-1];
+            tankAllpass[0].SetFeedback(Density1);
+            prefetchTaps(n, n);
+            probe.mark(STAGE_CONTROL);
+
+            //a mono input is the same on both sides, one filter does for both
+            Stereo dry[MaxBlockSize], bandwidth[MaxBlockSize];
+            Mono monoBandwidth[MaxBlockSize];
+            Stereo peak(T(0));
+            for(int i=0;i<n;++i){
+                if constexpr (MonoInput){
+                    dry[i] = Stereo(inputs[0][offset+i]);
+                    monoBandwidth[i] = monoBandwidthFilter(Mono(inputs[0][offset+i]));
+                }else{
+                    dry[i] = Stereo(inputs[0][offset+i], inputs[1][offset+i]);
+                    bandwidth[i] = bandwidthFilter(dry[i]);
+                }
+                peak = Stereo::Max(peak, Stereo::Max(dry[i], -dry[i]));
+            }
+            probe.mark(STAGE_BANDWIDTH);
+
+            //with a mono input both cross mixes reduce to one factor, a mono output only needs
+            //the taps of the left lane
+            Stereo earlyReflections[MaxBlockSize];
+            T earlyLeft[MaxBlockSize];
+            if constexpr (MonoInput){
+                for(int i=0;i<n;++i)
+                    earlyReflections[i] = earlyReflectionsDelayLine(Stereo(T(monoBandwidth[i].Get(0) * 0.8)));
+                for(int i=0, age=n-1;i<n;++i, --age){
+                    if constexpr (MonoOutput){
+                        earlyLeft[i] = earlyReflectionsLeft(earlyReflections[i].Get(LEFT), monoBandwidth[i].Get(0) * 0.3,
+                                                            age, EarlyTapSequence());
+                    }else{
+                        earlyReflections[i] = earlyReflectionsTaps(earlyReflections[i], Stereo(monoBandwidth[i].Get(0)).Widen() * 0.3, age);
+                    }
+                }
+            }else{
+                processEarlyReflections(bandwidth, earlyReflections, n);
+            }
+            probe.mark(STAGE_EARLYREFLECTIONS);
+
+            T smearedInput[MaxBlockSize];
+            for(int i=0;i<n;++i){
+                if constexpr (MonoInput)
+                    smearedInput[i] = monoBandwidth[i].Get(0);
+                else
+                    smearedInput[i] = ( bandwidth[i].Get(RIGHT) + bandwidth[i].Get(LEFT) ) * 0.5f;
+            }
+            diffuse(smearedInput, n, offset + 1, 1, PredelayDelta);
+            probe.mark(STAGE_DIFFUSION);
+
+            processTank(smearedInput, n, DecayDelta != 0, peak);
+            if (std::max(peak.Get(LEFT), peak.Get(RIGHT)) < SleepThreshold)
+                QuietSamples += n;
+            else
+                QuietSamples = 0;
+            probe.mark(STAGE_TANK);
+
+            const T lateMix = 1 - EarlyMix;
+            if constexpr (MonoOutput){
+                for(int i=0, age=n-1;i<n;++i, --age){
+                    T late = lateLeft(age, LateTapSequence()) * EarlyMix + earlyLeft[i] * lateMix;
+                    Sample dryLeft = inputs[0][offset+i];
+                    Sample output = dryLeft + ( late - dryLeft ) * MixRamp[i];
+                    monoCheckSum += std::abs(output);
+                    outputs[0][offset+i] = output * Gain;
+                }
+            }else{
+                for(int i=0, age=n-1;i<n;++i, --age){
+                    StereoIO<Sample> late = toIO<Sample>(lateTaps(age) * EarlyMix + earlyReflections[i] * lateMix);
+                    StereoIO<Sample> dryIO = dryInput(inputs, offset + i, !MonoInput, dry[i]);
+                    StereoIO<Sample> output = dryIO + ( late - dryIO ) * Sample(MixRamp[i]);
+                    silenceCheckSum = silenceCheckSum + StereoIO<Sample>::Max(output, -output);
+                    output = output * Sample(Gain);
+                    outputs[0][offset+i] = output.Get(LEFT);
+                    outputs[1][offset+i] = output.Get(RIGHT);
+                }
+            }
+            probe.mark(STAGE_OUTPUT);
+            offset += n;
+        }
+        if constexpr (MonoOutput)
+            SilentChannels = monoCheckSum <= 1e-7;
+        else
+            SilentChannels = (silenceCheckSum.Get(LEFT) <= 1e-7) | (silenceCheckSum.Get(RIGHT) <= 1e-7) << 1;
+    }
+
+    //the chunks of process() with RateDivider > 1. The input is filtered and decimated to
+    //TankRate, the diffusion and the tank run there and their output is interpolated back.
+    //The early reflections run at the full rate unless ReducedEarlyReflections, then they are
+    //fed from the decimated input and added before the interpolation. The dry signal and the
+    //mix stay at the full rate. The low rate sample k of a chunk is due with the full rate
+    //sample first + k * RateDivider, its interpolated output follows from the next sample on.
+    template<typename Sample>
+    void processChunksReduced(Sample **inputs, Sample **outputs, int sampleFrames){
+        probe.start();
+        StereoIO<Sample> silenceCheckSum(Sample(0));
+        Control OneOverSampleFrames = 1. / sampleFrames;
+        T MixDelta	= (Mix - MixSmooth) * OneOverSampleFrames;
+        Control BandwidthDelta = (((BandwidthFreq * 18400.) + 100.) - BandwidthSmooth) * OneOverSampleFrames;
+        Control DampingDelta = (((DampingFreq * 18400.) + 100.) - DampingSmooth) * OneOverSampleFrames;
+        Control PredelayDelta = ((PreDelayTime * 200 * (TankRate / 1000)) - PredelaySmooth) * OneOverSampleFrames;
+        Control SizeDelta	= (Size - SizeSmooth) * OneOverSampleFrames;
+        T DecayDelta = (((0.7995f * Decay) + 0.005) - DecaySmooth) * OneOverSampleFrames;
+        //kept in locals, the vector stores of the stages could alias the members
+        const int divider = RateDivider;
+        const bool reducedEarly = ReducedEarlyReflections;
+        const bool stereoInput = NumInputs == 2;
+        const bool stereoOutput = NumOutputs == 2;
+        TankCleared = false;
+        for(int offset=0;offset<sampleFrames;){
+            bool updateFilters = ControlRateCounter >= ControlRate;
+            if (updateFilters){
+                ControlRateCounter = 0;
+                updateTankLengths(SizeSmooth + Control(offset + 1) * SizeDelta);
+                bandwidthFilter.Frequency(BandwidthSmooth + Control(offset + 1) * BandwidthDelta);
+                damping.Frequency(DampingSmooth + Control(offset + 1) * DampingDelta);
+            }
+            int n = std::min(sampleFrames - offset, (int)MaxBlockSize);
+            n = std::min(n, std::max(ControlRate - ControlRateCounter, 1));
+            n = std::min(n, tankDelayLine[1].GetMinLength() * divider);
+            ControlRateCounter += n;
+            int first = divider - 1 - RatePhase;
+            int m = first < n ? (n - 1 - first) / divider + 1 : 0;
+
+            if (MixDelta != 0 || !MixSettled){
+                ramp(MixRamp, MixSmooth, MixDelta, offset + 1, MixDelta != 0 ? n : MaxBlockSize);
+                MixSettled = MixDelta == 0;
+            }
+            if (DecayDelta != 0 || !DecaySettled){
+                int count = DecayDelta != 0 ? m : MaxBlockSize;
+                ramp(DecayRamp, DecaySmooth, DecayDelta, offset + first + 1, count, divider);
+                for(int i=0;i<count;++i)
+                    Density2Ramp[i] = std::min(std::max(T(DecayRamp[i] + 0.15), T(0.25)), T(0.5));
+                DecaySettled = DecayDelta == 0;
+            }
+            Density2 = Density2Ramp[std::max(m-1, 0)];
+            tankAllpass[0].SetFeedback(Density1);
+            prefetchTaps(reducedEarly ? m : n, m);
+            probe.mark(STAGE_CONTROL);
+
+            Stereo dry[MaxBlockSize], bandwidth[MaxBlockSize], decimated[MaxBlockSize];
+            Stereo peak(T(0));
+            for(int i=0;i<n;++i){
+                dry[i] = stereoInput ? Stereo(inputs[0][offset+i], inputs[1][offset+i]) : Stereo(inputs[0][offset+i]);
+                peak = Stereo::Max(peak, Stereo::Max(dry[i], -dry[i]));
+            }
+            if (!reducedEarly)
+                bandwidthFilter.Process(dry, bandwidth, n);
+            const Stereo* decimatorInput = reducedEarly ? dry : bandwidth;
+            int phase = RatePhase;
+            for(int i=0, k=0;i<n;++i){
+                decimator.Write(decimatorInput[i]);
+                if (++phase == divider){
+                    phase = 0;
+                    decimated[k++] = decimator.Read();
+                }
+            }
+            if (reducedEarly)
+                bandwidthFilter.Process(decimated, decimated, m);
+            probe.mark(STAGE_BANDWIDTH);
+
+            Stereo earlyReflections[MaxBlockSize];
+            if (reducedEarly)
+                processEarlyReflections(decimated, earlyReflections, m);
+            else
+                processEarlyReflections(bandwidth, earlyReflections, n);
+            probe.mark(STAGE_EARLYREFLECTIONS);
+
+            T smearedInput[MaxBlockSize];
+            for(int k=0;k<m;++k)
+                smearedInput[k] = ( decimated[k].Get(RIGHT) + decimated[k].Get(LEFT) ) * 0.5f;
+            diffuse(smearedInput, m, offset + first + 1, divider, PredelayDelta);
+            probe.mark(STAGE_DIFFUSION);
+
+            processTank(smearedInput, m, DecayDelta != 0, peak);
+            if (std::max(peak.Get(LEFT), peak.Get(RIGHT)) < SleepThreshold)
+                QuietSamples += n;
+            else
+                QuietSamples = 0;
+            probe.mark(STAGE_TANK);
+
+            const T lateMix = 1 - EarlyMix;
+            Stereo wet[MaxBlockSize];
+            for(int k=0, age=m-1;k<m;++k, --age){
+                wet[k] = lateTaps(age) * EarlyMix;
+                if (reducedEarly)
+                    wet[k] = wet[k] + earlyReflections[k] * lateMix;
+            }
+            phase = RatePhase;
+            for(int i=0, k=0;i<n;++i){
+                Stereo wetSample = interpolator.Get(phase);
+                if (++phase == divider){
+                    phase = 0;
+                    interpolator.Write(wet[k++]);
+                }
+                if (!reducedEarly)
+                    wetSample = wetSample + earlyReflections[i] * lateMix;
+                StereoIO<Sample> late = toIO<Sample>(wetSample);
+                StereoIO<Sample> dryIO = dryInput(inputs, offset + i, stereoInput, dry[i]);
+                StereoIO<Sample> output = dryIO + ( late - dryIO ) * Sample(MixRamp[i]);
+                silenceCheckSum = silenceCheckSum + StereoIO<Sample>::Max(output, -output);
+                output = output * Sample(Gain);
+                outputs[0][offset+i] = output.Get(LEFT);
+                if (stereoOutput)
+                    outputs[1][offset+i] = output.Get(RIGHT);
+            }
+            RatePhase = phase;
+            probe.mark(STAGE_OUTPUT);
+            offset += n;
+        }
+        SilentChannels = ((silenceCheckSum.Get(LEFT) <= 1e-7) | (silenceCheckSum.Get(RIGHT) <= 1e-7) << 1) & allOutputs();
+    }
 
 public:
     enum
@@ -56,6 +1027,19 @@ public:
             NUM_PARAMS
 		};
 
+    static constexpr T DefaultSleepThreshold = 1e-6;
+
+    enum
+        {
+            STAGE_CONTROL=0,
+            STAGE_BANDWIDTH,
+            STAGE_EARLYREFLECTIONS,
+            STAGE_DIFFUSION,
+            STAGE_TANK,
+            STAGE_OUTPUT,
+            NUM_STAGES
+        };
+
     MVerb(){
         DampingFreq = 0.9;
         BandwidthFreq = 0.9;
@@ -71,6 +1055,13 @@ public:
         MixSmooth = EarlyLateSmooth = BandwidthSmooth = DampingSmooth = PredelaySmooth = SizeSmooth = DecaySmooth = DensitySmooth = 0.;
         ControlRate = SampleRate / 1000;
         ControlRateCounter = 0;
+        RateDivider = 1;
+        ReducedEarlyReflections = false;
+        TankRate = SampleRate;
+        SleepThreshold = DefaultSleepThreshold;
+        NumInputs = NumOutputs = 2;
+        UseHugePages = false;
+        allocateDelayLines();
         reset();
     }
 
@@ -78,166 +1069,127 @@ public:
         //nowt to do here
     }
 
-    bool process(T **inputs, T **outputs, int sampleFrames){
-		T silenceCheckSum = 0.;
-        T OneOverSampleFrames = 1. / sampleFrames;
-        T MixDelta	= (Mix - MixSmooth) * OneOverSampleFrames;
-        T EarlyLateDelta = (EarlyMix - EarlyLateSmooth) * OneOverSampleFrames;
-        T BandwidthDelta = (((BandwidthFreq * 18400.) + 100.) - BandwidthSmooth) * OneOverSampleFrames;
-        T DampingDelta = (((DampingFreq * 18400.) + 100.) - DampingSmooth) * OneOverSampleFrames;
-        T PredelayDelta = ((PreDelayTime * 200 * (SampleRate / 1000)) - PredelaySmooth) * OneOverSampleFrames;
-        T SizeDelta	= (Size - SizeSmooth) * OneOverSampleFrames;
-        T DecayDelta = (((0.7995f * Decay) + 0.005) - DecaySmooth) * OneOverSampleFrames;
-        T DensityDelta = (((0.7995f * Density1) + 0.005) - DensitySmooth) * OneOverSampleFrames;
-        for(int i=0;i<sampleFrames;++i){
-            T left = inputs[0][i];
-            T right = inputs[1][i];
-            MixSmooth += MixDelta;
-            EarlyLateSmooth += EarlyLateDelta;
-            BandwidthSmooth += BandwidthDelta;
-            DampingSmooth += DampingDelta;
-            PredelaySmooth += PredelayDelta;
-            SizeSmooth += SizeDelta;
-            DecaySmooth += DecayDelta;
-            DensitySmooth += DensityDelta;
-            if (ControlRateCounter >= ControlRate){
-                ControlRateCounter = 0;
-                bandwidthFilter[0].Frequency(BandwidthSmooth);
-                bandwidthFilter[1].Frequency(BandwidthSmooth);
-                damping[0].Frequency(DampingSmooth);
-                damping[1].Frequency(DampingSmooth);
-            }
-            ++ControlRateCounter;
-            predelay.SetLength(PredelaySmooth);
-            Density2 = DecaySmooth + 0.15;
-            if (Density2 > 0.5)
-                Density2 = 0.5;
-            if (Density2 < 0.25)
-                Density2 = 0.25;
-            allpassFourTap[1].SetFeedback(Density2);
-            allpassFourTap[3].SetFeedback(Density2);
-            allpassFourTap[0].SetFeedback(Density1);
-            allpassFourTap[2].SetFeedback(Density1);
-            T bandwidthLeft = bandwidthFilter[0](left) ;
-            T bandwidthRight = bandwidthFilter[1](right) ;
-            T earlyReflectionsL = earlyReflectionsDelayLine[0] ( bandwidthLeft * 0.5 + bandwidthRight * 0.3 )
-                                + earlyReflectionsDelayLine[0].GetIndex(2) * 0.6
-                                + earlyReflectionsDelayLine[0].GetIndex(3) * 0.4
-                                + earlyReflectionsDelayLine[0].GetIndex(4) * 0.3
-                                + earlyReflectionsDelayLine[0].GetIndex(5) * 0.3
-                                + earlyReflectionsDelayLine[0].GetIndex(6) * 0.1
-                                + earlyReflectionsDelayLine[0].GetIndex(7) * 0.1
-                                + ( bandwidthLeft * 0.4 + bandwidthRight * 0.2 ) * 0.5 ;
-            T earlyReflectionsR = earlyReflectionsDelayLine[1] ( bandwidthLeft * 0.3 + bandwidthRight * 0.5 )
-                                + earlyReflectionsDelayLine[1].GetIndex(2) * 0.6
-                                + earlyReflectionsDelayLine[1].GetIndex(3) * 0.4
-                                + earlyReflectionsDelayLine[1].GetIndex(4) * 0.3
-                                + earlyReflectionsDelayLine[1].GetIndex(5) * 0.3
-                                + earlyReflectionsDelayLine[1].GetIndex(6) * 0.1
-                                + earlyReflectionsDelayLine[1].GetIndex(7) * 0.1
-                                + ( bandwidthLeft * 0.2 + bandwidthRight * 0.4 ) * 0.5 ;
-            T predelayMonoInput = predelay(( bandwidthRight + bandwidthLeft ) * 0.5f);
-            T smearedInput = predelayMonoInput;
-            for(int j=0;j<4;j++)
-                smearedInput = allpass[j] ( smearedInput );
-            T leftTank = allpassFourTap[0] ( smearedInput + PreviousRightTank ) ;
-            leftTank = staticDelayLine[0] (leftTank);
-            leftTank = damping[0](leftTank);
-            leftTank = allpassFourTap[1](leftTank);
-            leftTank = staticDelayLine[1](leftTank);
-            T rightTank = allpassFourTap[2] (smearedInput + PreviousLeftTank) ;
-            rightTank = staticDelayLine[2](rightTank);
-            rightTank = damping[1] (rightTank);
-            rightTank = allpassFourTap[3](rightTank);
-            rightTank = staticDelayLine[3](rightTank);
-            PreviousLeftTank = leftTank * DecaySmooth;
-            PreviousRightTank = rightTank * DecaySmooth;
-            T accumulatorL = (0.6*staticDelayLine[2].GetIndex(1))
-                            +(0.6*staticDelayLine[2].GetIndex(2))
-                            -(0.6*allpassFourTap[3].GetIndex(1))
-                            +(0.6*staticDelayLine[3].GetIndex(1))
-                            -(0.6*staticDelayLine[0].GetIndex(1))
-                            -(0.6*allpassFourTap[1].GetIndex(1))
-                            -(0.6*staticDelayLine[1].GetIndex(1));
-            T accumulatorR = (0.6*staticDelayLine[0].GetIndex(2))
-                            +(0.6*staticDelayLine[0].GetIndex(3))
-                            -(0.6*allpassFourTap[1].GetIndex(2))
-                            +(0.6*staticDelayLine[1].GetIndex(2))
-                            -(0.6*staticDelayLine[2].GetIndex(3))
-                            -(0.6*allpassFourTap[3].GetIndex(2))
-                            -(0.6*staticDelayLine[3].GetIndex(2));
-            accumulatorL = ((accumulatorL * EarlyMix) + ((1 - EarlyMix) * earlyReflectionsL));
-            accumulatorR = ((accumulatorR * EarlyMix) + ((1 - EarlyMix) * earlyReflectionsR));
-            left = ( left + MixSmooth * ( accumulatorL - left ) );
-            right = ( right + MixSmooth * ( accumulatorR - right ) );
-            silenceCheckSum += std::abs (left) + std::abs (right);
-            outputs[0][i] = left * Gain;
-            outputs[1][i] = right * Gain;
-        }
-        return silenceCheckSum <= 1e-7;
+    //the engine runs stage by stage over chunks of up to MaxBlockSize samples. A chunk ends
+    //before the next control rate update and is never longer than the delay lines closing the
+    //tank loop, so every stage can finish the whole chunk before the next one starts and the
+    //output is the same as running all stages sample by sample.
+    //
+    //once the input and the tank have stayed below SleepThreshold for SleepSamples the state is
+    //cleared and the engine sleeps, it then only mixes the dry signal until the input comes back.
+    //
+    //a float engine also processes double buffers: the delay lines and the arithmetic stay in
+    //float and only the dry signal and the mix are computed in double, see StereoIO.
+    template<typename Sample>
+    bool process(Sample **inputs, Sample **outputs, int sampleFrames){
+        static_assert(std::is_same_v<Sample, T> || std::is_same_v<StereoIO<Sample>, StereoWide>,
+                      "the buffers have the precision of the engine or a wider one");
+        if (Sleeping && !wake(inputs, sampleFrames)){
+            processDry(inputs, outputs, sampleFrames);
+            return SilentChannels == allOutputs();
+        }
+        if (RateDivider > 1)
+            processChunksReduced(inputs, outputs, sampleFrames);
+        else if (NumInputs == 2)
+            processChunks<false, false>(inputs, outputs, sampleFrames);
+        else if (NumOutputs == 2)
+            processChunks<true, false>(inputs, outputs, sampleFrames);
+        else
+            processChunks<true, true>(inputs, outputs, sampleFrames);
+        settleSmoothers();
+        if (QuietSamples >= SleepSamples)
+            sleep();
+        return SilentChannels == allOutputs();
+    }
+
+    //bit 0 is set if the left and bit 1 if the right output of the last process call was silent
+    unsigned getSilentChannels() const{
+        return SilentChannels;
+    }
+
+    //the channels process() reads and writes: stereo (2, 2), mono to stereo (1, 2) or mono
+    //(1, 1). A mono input feeds both sides through one bandwidth filter, a mono output is the
+    //left channel of the stereo output and only its taps are read. Clears the state.
+    bool setChannels(int numInputs, int numOutputs){
+        if (numInputs < 1 || numInputs > 2 || numOutputs < numInputs || numOutputs > 2)
+            return false;
+        NumInputs = numInputs;
+        NumOutputs = numOutputs;
+        reset();
+        return true;
+    }
+
+    int getNumInputs() const{
+        return NumInputs;
+    }
+
+    int getNumOutputs() const{
+        return NumOutputs;
+    }
+
+    bool isSleeping() const{
+        return Sleeping;
+    }
+
+    //peak level of the input and the tank below which the tail counts as decayed, 0 never sleeps
+    void setSleepThreshold(T threshold){
+        SleepThreshold = threshold;
+    }
+
+    //length of the tail in samples at the current settings, a size or decay that is still being
+    //smoothed counts with the longer of its current and its target value
+    int getTailSamples() const{
+        T decay = std::max(DecaySmooth, T((0.7995f * Decay) + 0.005));
+        Control size = std::max({Size, SizeSmooth, TankSize});
+        T level = SleepThreshold > 0 ? SleepThreshold : DefaultSleepThreshold;
+        return std::ceil(tailTime(decay, size, PreDelayTime, Gain, level) * SampleRate);
+    }
+
+    //tail in seconds for the parameter values as passed to setParameter
+    static T getTailTime(T decay, T size, T predelay, T gain){
+        return tailTime((0.7995f * decay) + 0.005, (0.95 * size) + 0.05, predelay, gain, DefaultSleepThreshold);
     }
 
     void reset(){
         ControlRateCounter = 0;
-        bandwidthFilter[0].SetSampleRate (SampleRate );
-        bandwidthFilter[1].SetSampleRate (SampleRate );
-        bandwidthFilter[0].Reset();
-        bandwidthFilter[1].Reset();
-        damping[0].SetSampleRate (SampleRate );
-        damping[1].SetSampleRate (SampleRate );
-        damping[0].Reset();
-        damping[1].Reset();
+        QuietSamples = 0;
+        MixSettled = DecaySettled = false;
+        SilentChannels = allOutputs();
+        Sleeping = false;
+        PreviousLeftTank = PreviousRightTank = 0.;
+        RatePhase = 0;
+        bandwidthFilter.SetSampleRate (earlyRate() );
+        bandwidthFilter.Reset();
+        monoBandwidthFilter.SetSampleRate (SampleRate );
+        monoBandwidthFilter.Reset();
+        damping.SetSampleRate (TankRate );
+        damping.Reset();
+        decimator.Reset();
+        interpolator.Reset();
         predelay.Clear();
         predelay.SetLength(PreDelayTime);
-        allpass[0].Clear();
-        allpass[1].Clear();
-        allpass[2].Clear();
-        allpass[3].Clear();
-        allpass[0].SetLength (0.0048 * SampleRate);
-        allpass[1].SetLength (0.0036 * SampleRate);
-        allpass[2].SetLength (0.0127 * SampleRate);
-        allpass[3].SetLength (0.0093 * SampleRate);
-        allpass[0].SetFeedback (0.75);
-        allpass[1].SetFeedback (0.75);
-        allpass[2].SetFeedback (0.625);
-        allpass[3].SetFeedback (0.625);
-        allpassFourTap[0].Clear();
-        allpassFourTap[1].Clear();
-        allpassFourTap[2].Clear();
-        allpassFourTap[3].Clear();
-        allpassFourTap[0].SetLength(0.020 * SampleRate * Size);
-        allpassFourTap[1].SetLength(0.060 * SampleRate * Size);
-        allpassFourTap[2].SetLength(0.030 * SampleRate * Size);
-        allpassFourTap[3].SetLength(0.089 * SampleRate * Size);
-        allpassFourTap[0].SetFeedback(Density1);
-        allpassFourTap[1].SetFeedback(Density2);
-        allpassFourTap[2].SetFeedback(Density1);
-        allpassFourTap[3].SetFeedback(Density2);
-        allpassFourTap[0].SetIndex(0,0,0,0);
-        allpassFourTap[1].SetIndex(0,0.006 * SampleRate * Size, 0.041 * SampleRate * Size, 0);
-        allpassFourTap[2].SetIndex(0,0,0,0);
-        allpassFourTap[3].SetIndex(0,0.031 * SampleRate * Size, 0.011 * SampleRate * Size, 0);
-        staticDelayLine[0].Clear();
-        staticDelayLine[1].Clear();
-        staticDelayLine[2].Clear();
-        staticDelayLine[3].Clear();
-        staticDelayLine[0].SetLength(0.15 * SampleRate * Size);
-        staticDelayLine[1].SetLength(0.12 * SampleRate * Size);
-        staticDelayLine[2].SetLength(0.14 * SampleRate * Size);
-        staticDelayLine[3].SetLength(0.11 * SampleRate * Size);
-        staticDelayLine[0].SetIndex(0, 0.067 * SampleRate * Size, 0.011 * SampleRate * Size , 0.121 * SampleRate * Size);
-        staticDelayLine[1].SetIndex(0, 0.036 * SampleRate * Size, 0.089 * SampleRate * Size , 0);
-        staticDelayLine[2].SetIndex(0, 0.0089 * SampleRate * Size, 0.099 * SampleRate * Size , 0);
-        staticDelayLine[3].SetIndex(0, 0.067 * SampleRate * Size, 0.0041 * SampleRate * Size , 0);
-        earlyReflectionsDelayLine[0].Clear();
-        earlyReflectionsDelayLine[1].Clear();
-        earlyReflectionsDelayLine[0].SetLength(0.089 * SampleRate);
-        earlyReflectionsDelayLine[0].SetIndex (0, 0.0199*SampleRate, 0.0219*SampleRate, 0.0354*SampleRate,0.0389*SampleRate, 0.0414*SampleRate, 0.0692*SampleRate, 0);
-        earlyReflectionsDelayLine[1].SetLength(0.069 * SampleRate);
-        earlyReflectionsDelayLine[1].SetIndex (0, 0.0099*SampleRate, 0.011*SampleRate, 0.0182*SampleRate,0.0189*SampleRate, 0.0213*SampleRate, 0.0431*SampleRate, 0);
-    }
-
-    void setParameter(int index, T value){
+        for(int j=0;j<4;j++){
+            allpass[j].Clear();
+            allpass[j].SetLength (Topology::AllpassTimes[j] * TankRate);
+        }
+        for(int j=0;j<4;j++)
+            allpass[j].SetFeedback (Topology::AllpassFeedback[j]);
+        for(int j=0;j<2;j++){
+            tankAllpass[j].Clear();
+            tankDelayLine[j].Clear();
+        }
+        SizeSmooth = Size;
+        setTankLengths(Size);
+        TankCleared = true;
+        tankAllpass[0].SetFeedback(Density1);
+        tankAllpass[1].SetFeedback(Density2);
+        earlyReflectionsDelayLine.Clear();
+        for(int lane=LEFT;lane<=RIGHT;lane++){
+            earlyReflectionsDelayLine.SetLength(lane, Topology::EarlyReflectionsTimes[lane] * earlyRate());
+            Topology::SetTaps(earlyReflectionsDelayLine, lane, Topology::EarlyReflectionsTaps[lane], earlyRate(), Control(1));
+        }
+    }
+
+    void setParameter(int index, Control value){
         switch(index){
             case DAMPINGFREQ:
                     DampingFreq =  1. - value;
@@ -252,29 +1204,12 @@ public:
                     PreDelayTime = value;
                     break;
             case SIZE:
+                    //process() fades to the new size, an empty tank takes it right away
                     Size = (0.95 * value) + 0.05;
-					allpassFourTap[0].Clear();
-					allpassFourTap[1].Clear();
-					allpassFourTap[2].Clear();
-					allpassFourTap[3].Clear();
-                    allpassFourTap[0].SetLength(0.020 * SampleRate * Size);
-                    allpassFourTap[1].SetLength(0.060 * SampleRate * Size);
-                    allpassFourTap[2].SetLength(0.030 * SampleRate * Size);
-                    allpassFourTap[3].SetLength(0.089 * SampleRate * Size);
-                    allpassFourTap[1].SetIndex(0,0.006 * SampleRate * Size, 0.041 * SampleRate * Size, 0);
-                    allpassFourTap[3].SetIndex(0,0.031 * SampleRate * Size, 0.011 * SampleRate * Size, 0);
-					staticDelayLine[0].Clear();
-					staticDelayLine[1].Clear();
-					staticDelayLine[2].Clear();
-					staticDelayLine[3].Clear();
-                    staticDelayLine[0].SetLength(0.15 * SampleRate * Size);
-                    staticDelayLine[1].SetLength(0.12 * SampleRate * Size);
-                    staticDelayLine[2].SetLength(0.14 * SampleRate * Size);
-                    staticDelayLine[3].SetLength(0.11 * SampleRate * Size);
-                    staticDelayLine[0].SetIndex(0, 0.067 * SampleRate * Size, 0.011 * SampleRate * Size , 0.121 * SampleRate * Size);
-                    staticDelayLine[1].SetIndex(0, 0.036 * SampleRate * Size, 0.089 * SampleRate * Size , 0);
-                    staticDelayLine[2].SetIndex(0, 0.0089 * SampleRate * Size, 0.099 * SampleRate * Size , 0);
-                    staticDelayLine[3].SetIndex(0, 0.067 * SampleRate * Size, 0.0041 * SampleRate * Size , 0);
+                    if (TankCleared){
+                        SizeSmooth = Size;
+                        setTankLengths(Size);
+                    }
                     break;
             case DECAY:
                     Decay = value;
@@ -326,425 +1261,637 @@ public:
         }
     }
 
-    void setSampleRate(T sr){
+    //reallocates the delay lines for the new rate, not realtime safe
+    void setSampleRate(Control sr){
+        setSampleRate(sr, RateDivider, ReducedEarlyReflections);
+    }
+
+    //the rate and the divider (see setRateDivider) at once, with a single reallocation
+    bool setSampleRate(Control sr, int divider, bool earlyReflections){
+        if (divider != 1 && divider != 2 && divider != 4)
+            return false;
         SampleRate = sr;
         ControlRate = SampleRate / 1000;
+        RateDivider = divider;
+        ReducedEarlyReflections = divider > 1 && earlyReflections;
+        TankRate = SampleRate / RateDivider;
+        decimator.SetFactor(divider);
+        interpolator.SetFactor(divider);
+        allocateDelayLines();
         reset();
+        return true;
+    }
+
+    //runs the diffusion and the tank, with earlyReflections also the bandwidth filter and the
+    //early reflections, at SampleRate / divider between polyphase resampling filters, see
+    //processChunksReduced(). The divider is 1, 2 or 4, the dry signal stays at the full rate.
+    //Reallocates the delay lines, not realtime safe.
+    bool setRateDivider(int divider, bool earlyReflections = false){
+        return setSampleRate(SampleRate, divider, earlyReflections);
+    }
+
+    int getRateDivider() const{
+        return RateDivider;
+    }
+
+    //the divider that keeps the tank at 44.1kHz or above, so that high rates cost about as
+    //much as 44.1 and 48kHz. The filters are not corrected for the lower rate, the tail comes
+    //out louder and longer than at the full rate (2.4dB and 4% at 96kHz without damping).
+    static int getDefaultRateDivider(T sampleRate){
+        return sampleRate >= 176400 ? 4 : sampleRate >= 88200 ? 2 : 1;
+    }
+
+    //back the delay lines with transparent huge pages (Linux only), applied by the next
+    //setSampleRate call. Each instance then occupies at least one 2MB page.
+    void setUseHugePages(bool state){
+        UseHugePages = state;
+    }
+
+    //subnormal samples that reached the delay lines and with them the feedback paths since the
+    //engine was created. Only counted with MVERB_COUNT_SUBNORMALS, stays 0 under DenormalGuard.
+    unsigned long getSubnormalCount() const{
+        unsigned long count = earlyReflectionsDelayLine.GetSubnormals() + predelay.GetSubnormals();
+        for(int j=0;j<4;j++)
+            count += allpass[j].GetSubnormals();
+        for(int j=0;j<2;j++)
+            count += tankAllpass[j].GetSubnormals() + tankDelayLine[j].GetSubnormals();
+        return count;
+    }
+
+    bool usesHugePages() const{
+        return arena.UsesHugePages();
+    }
+
+    //bytes needed by one instance running at sampleRate, delay lines included
+    static size_t getMemorySize(Control sampleRate, int rateDivider = 1, bool reducedEarlyReflections = false){
+        Control tankRate = sampleRate / rateDivider;
+        return sizeof(MVerb) + getArenaSize(reducedEarlyReflections ? tankRate : sampleRate, tankRate) * sizeof(Storage);
+    }
+
+    Probe& getProbe(){
+        return probe;
     }
 };
 
 
 
-template<typename T, int maxLength>
-class Allpass
+//base of all delay lines, see DelayLineCapacity. The memory holds samples of format S.
+template<typename T, typename S = T>
+class DelayLineBase
 {
-private:
-    T buffer[maxLength];
-	int index;
+protected:
+    using Format = DelayStorage<T, S>;
+
+    S* buffer;
+	unsigned mask;
+	unsigned writeIndex;
+	//samples written since the last clear, up to the capacity. Writing starts at the front of
+	//the buffer, so that is the part a clear has to zero.
+	unsigned Dirty;
+	int MaxLength;
 	int Length;
-	T Feedback;
+	unsigned long Subnormals;
 
-public:
-    Allpass()
-    {
-		SetLength ( maxLength - 1 );
-		Clear();
-		Feedback = 0.5;
-    }
+	DelayLineBase()
+	{
+		buffer = nullptr;
+		mask = 0;
+		writeIndex = 0;
+		Dirty = 0;
+		Subnormals = 0;
+		MaxLength = 0;
+		Length = 1;
+	}
 
-	T operator()(T input)
-    {
-		T output;
-		T bufout;
-		bufout = buffer[index];
-		T temp = input * -Feedback;
-		output = bufout + temp;
-		buffer[index] = input + ((bufout+temp)*Feedback);
-		if(++index>=Length) index = 0;
-		return output;
+	//the sample written delay samples ago, delay 0 is the next write position
+	T Read(unsigned delay) const
+	{
+		return Format::Load(buffer[(writeIndex - delay) & mask]);
+	}
 
-    }
+	void Write(T value)
+	{
+		buffer[writeIndex & mask] = Format::Store(value);
+		++writeIndex;
+		Dirty += Dirty <= mask;
+#if MVERB_COUNT_SUBNORMALS
+		Subnormals += std::fpclassify(value) == FP_SUBNORMAL;
+#endif
+	}
 
+public:
+	//a length of 0 behaves like 1, just like the old index based lines did
 	void SetLength (int inLength)
     {
-       if( inLength >= maxLength )
-			inLength = maxLength;
-	   if( inLength < 0 )
-			inLength = 0;
+       if( inLength >= MaxLength )
+			inLength = MaxLength;
+	   if( inLength < 1 )
+			inLength = 1;
 
         this->Length = inLength;
     }
 
-	void SetFeedback(T feedback)
-    {
-        Feedback = feedback;
-    }
-
     void Clear()
     {
-        memset(buffer, 0, sizeof(buffer));
-		index = 0;
+        std::fill(buffer, buffer + Dirty, S());
+		writeIndex = 0;
+		Dirty = 0;
     }
 
     int GetLength() const
     {
         return Length;
     }
-};
 
-template<typename T, int maxLength>
-class StaticAllpassFourTap
-{
-private:
-    T buffer[maxLength];
-	int index1, index2, index3, index4;
-	int Length;
-	T Feedback;
+    //the line works on DelayLineCapacity(maxLength) samples of external memory, see DelayArena.
+    //The memory has to be zeroed.
+    void SetBuffer(S* inBuffer, int maxLength)
+    {
+        buffer = inBuffer;
+        MaxLength = maxLength;
+        mask = DelayLineCapacity(maxLength) - 1;
+        SetLength(Length);
+        writeIndex = 0;
+        Dirty = 0;
+    }
 
-public:
-    StaticAllpassFourTap()
+    int GetMaxLength() const
     {
-		SetLength ( maxLength - 1 );
-		Clear();
-		Feedback = 0.5;
+        return MaxLength;
     }
 
-	T operator()(T input)
+    //subnormal samples written so far, always 0 without MVERB_COUNT_SUBNORMALS
+    unsigned long GetSubnormals() const
     {
-		T output;
-		T bufout;
+        return Subnormals;
+    }
+};
 
-		bufout = buffer[index1];
-		T temp = input * -Feedback;
-		output = bufout + temp;
-		buffer[index1] = input + ((bufout+temp)*Feedback);
-
-		if(++index1>=Length)
-			index1 = 0;
-		if(++index2 >= Length)
-			index2 = 0;
-		if(++index3 >= Length)
-			index3 = 0;
-		if(++index4 >= Length)
-			index4 = 0;
+//NumLanes delay lines running side by side, like the mirrored lines of the left and the right
+//tank half. The lanes share one write position and are stored interleaved, so one vector store
+//writes all of them. Every lane has a length and taps of its own.
+//
+//Lengths can also change with a crossfade: between BeginFade() and EndFade() the outputs blend
+//from the lengths the lines had at BeginFade() to the ones set since, which moves the read
+//positions without a jump and without touching the memory.
+template<typename T, int NumLanes, typename S = T>
+class DelayLineLanes
+{
+public:
+	using Vector = LaneVector<T, NumLanes>;
+
+protected:
+    using Format = DelayStorage<T, S>;
+
+    S* buffer;
+	unsigned mask;
+	unsigned writeIndex;
+	//see DelayLineBase
+	unsigned Dirty;
+	int MaxLength;
+	int Length[NumLanes];
+	int FromLength[NumLanes];
+	unsigned fadeStart;
+	T fadeScale;
+	bool Fading;
+	unsigned long Subnormals;
+
+	DelayLineLanes()
+	{
+		buffer = nullptr;
+		mask = 0;
+		writeIndex = 0;
+		Dirty = 0;
+		Subnormals = 0;
+		MaxLength = 0;
+		for(int k = 0; k < NumLanes; k++)
+			Length[k] = FromLength[k] = 1;
+		fadeStart = 0;
+		fadeScale = 1;
+		Fading = false;
+	}
 
-		return output;
+	//the weight of the new lengths for the sample written at position, it reaches 1 with the
+	//last sample of the fade
+	T FadeGain(unsigned position) const
+	{
+		return T(int(position - fadeStart) + 1) * fadeScale;
+	}
 
-    }
+	//Vector::Gather from memory of format S
+	Vector Gather(unsigned position, const int* delays) const
+	{
+		if constexpr (std::is_same<S, T>::value)
+			return Vector::Gather(buffer, position, delays, mask);
+		T lanes[NumLanes];
+		for(int k = 0; k < NumLanes; k++)
+			lanes[k] = Format::Load(buffer[((position - delays[k]) & mask) * NumLanes + k]);
+		return Vector::Load(lanes);
+	}
 
-	void SetIndex (int Index1, int Index2, int Index3, int Index4)
+	//prefetches what Gather reads for the n positions from position on. Lines start on a cache
+	//line and hold a power of two of samples, so the lines of a lane are found by rounding down.
+	void PrefetchReads(unsigned position, const int* delays, int n) const
 	{
-		index1 = Index1;
-		index2 = Index2;
-		index3 = Index3;
-		index4 = Index4;
+		const unsigned samplesPerLine = std::max<unsigned>(CacheLineSize / (sizeof(S) * NumLanes), 1);
+		for(int k = 0; k < NumLanes; k++){
+			unsigned first = position - delays[k];
+			for(unsigned i = first & ~(samplesPerLine - 1); int(i - first) < n; i += samplesPerLine)
+				PrefetchCacheLine(buffer + (i & mask) * NumLanes);
+		}
 	}
 
-	T GetIndex (int Index)
+	//the output for the sample written at position, Length samples back
+	Vector ReadOutput(unsigned position) const
 	{
-		switch (Index)
-		{
-			case 0:
-				return buffer[index1];
-				break;
-			case 1:
-				return buffer[index2];
-				break;
-			case 2:
-				return buffer[index3];
-				break;
-			case 3:
-				return buffer[index4];
-				break;
-			default:
-				return buffer[index1];
-				break;
+		Vector output = Gather(position, Length);
+		if(Fading){
+			Vector from = Gather(position, FromLength);
+			output = from + (output - from) * Vector(FadeGain(position));
 		}
+		return output;
 	}
 
-	void SetLength (int inLength)
+	void Write(const Vector& value)
+	{
+		if constexpr (std::is_same<S, T>::value)
+			value.Store(buffer + (writeIndex & mask) * NumLanes);
+		else{
+			T lanes[NumLanes];
+			value.Store(lanes);
+			for(int k = 0; k < NumLanes; k++)
+				buffer[(writeIndex & mask) * NumLanes + k] = Format::Store(lanes[k]);
+		}
+		++writeIndex;
+		Dirty += Dirty <= mask;
+#if MVERB_COUNT_SUBNORMALS
+		for(int k = 0; k < NumLanes; k++)
+			Subnormals += std::fpclassify(value.Get(k)) == FP_SUBNORMAL;
+#endif
+	}
+
+public:
+	void SetLength (int lane, int inLength)
     {
-       if( inLength >= maxLength )
-			inLength = maxLength;
-	   if( inLength < 0 )
-			inLength = 0;
+       if( inLength >= MaxLength )
+			inLength = MaxLength;
+	   if( inLength < 1 )
+			inLength = 1;
 
-        this->Length = inLength;
+        Length[lane] = inLength;
     }
 
-
     void Clear()
     {
-        memset(buffer, 0, sizeof(buffer));
-		index1 = index2  = index3 = index4 = 0;
+        std::fill(buffer, buffer + Dirty * NumLanes, S());
+		writeIndex = 0;
+		Dirty = 0;
+		Fading = false;
     }
 
-	void SetFeedback(T feedback)
+    //clears one lane and leaves the others running
+    void ClearLane(int lane)
     {
-        Feedback = feedback;
+        for(unsigned i = 0; i < Dirty; i++)
+            buffer[i * NumLanes + lane] = S();
     }
 
-
-    int GetLength() const
+    int GetLength(int lane) const
     {
-        return Length;
+        return Length[lane];
     }
-};
-
-template<typename T, int maxLength>
-class StaticDelayLine
-{
-private:
-    T buffer[maxLength];
-	int index;
-	int Length;
-	T Feedback;
 
-public:
-    StaticDelayLine()
+    //during a fade the shorter of both lengths
+    int GetMinLength() const
     {
-		SetLength ( maxLength - 1 );
-		Clear();
+        int length = *std::min_element(Length, Length + NumLanes);
+        if(Fading)
+            length = std::min(length, *std::min_element(FromLength, FromLength + NumLanes));
+        return length;
     }
 
-	T operator()(T input)
+    //the following SetLength calls fade in over fadeLength samples
+    void BeginFade(int fadeLength)
     {
-		T output = buffer[index];
-		buffer[index++] = input;
-		if(index >= Length)
-			index = 0;
-		return output;
+        std::copy(Length, Length + NumLanes, FromLength);
+        fadeStart = writeIndex;
+        fadeScale = T(1) / fadeLength;
+        Fading = true;
+    }
 
+    //call once fadeLength samples were written
+    void EndFade()
+    {
+        Fading = false;
     }
 
-	void SetLength (int inLength)
+    //the lane uses its current length right away, for lanes reset during a fade
+    void SkipFade(int lane)
     {
-       if( inLength >= maxLength )
-			inLength = maxLength;
-	   if( inLength < 0 )
-			inLength = 0;
+        FromLength[lane] = Length[lane];
+    }
 
-        this->Length = inLength;
+    //the lines work on DelayLineCapacity(maxLength) * NumLanes samples of zeroed external memory
+    void SetBuffer(S* inBuffer, int maxLength)
+    {
+        buffer = inBuffer;
+        MaxLength = maxLength;
+        mask = DelayLineCapacity(maxLength) - 1;
+        for(int k = 0; k < NumLanes; k++)
+            SetLength(k, Length[k]);
+        writeIndex = 0;
+        Dirty = 0;
+        Fading = false;
     }
 
-    void Clear()
+    int GetMaxLength() const
     {
-        memset(buffer, 0, sizeof(buffer));
-		index = 0;
+        return MaxLength;
     }
 
-    int GetLength() const
+    //see DelayLineBase
+    unsigned long GetSubnormals() const
     {
-        return Length;
+        return Subnormals;
     }
+
+	//the next n outputs of a plain delay, valid as long as n is not larger than GetMinLength()
+	void ReadAhead(Vector* output, int n) const
+	{
+		for(int i = 0; i < n; i++)
+			output[i] = ReadOutput(writeIndex + i);
+	}
+
+	void Write(const Vector* input, int n)
+	{
+		for(int i = 0; i < n; i++)
+			Write(input[i]);
+	}
 };
 
-template<typename T, int maxLength>
-class StaticDelayLineFourTap
+//taps are given as positions relative to the write position, like the read indices of the
+//original MVerb lines. A tap at position t reads the sample written Length - 1 - t samples ago.
+template<typename T, int NumLanes, int NumTaps, typename S = T>
+class DelayLineTaps : public DelayLineLanes<T, NumLanes, S>
 {
-private:
-    T buffer[maxLength];
-	int index1, index2, index3, index4;
-	int Length;
-	T Feedback;
+protected:
+	using Format = DelayStorage<T, S>;
+
+	int taps[NumLanes][NumTaps];
+	//Length - tap of every tap and lane, the delay a tap reads with
+	int tapDelays[NumTaps][NumLanes];
+	int fromTapDelays[NumTaps][NumLanes];
+
+	DelayLineTaps()
+	{
+		for(int k = 0; k < NumLanes; k++){
+			for(int i = 0; i < NumTaps; i++)
+				taps[k][i] = 0;
+			UpdateTapDelays(k);
+		}
+	}
+
+	void UpdateTapDelays(int lane)
+	{
+		for(int i = 0; i < NumTaps; i++)
+			tapDelays[i][lane] = this->Length[lane] - taps[lane][i];
+	}
 
 public:
-    StaticDelayLineFourTap()
-    {
-		SetLength ( maxLength - 1 );
-		Clear();
-    }
+	void SetIndex (int lane, const int* indices)
+	{
+		for(int i = 0; i < NumTaps; i++)
+			taps[lane][i] = indices[i] - indices[0];
+		UpdateTapDelays(lane);
+	}
 
-	//get ouput and iterate
-	T operator()(T input)
-    {
-		T output = buffer[index1];
-		buffer[index1++] = input;
-		if(index1 >= Length)
-			index1 = 0;
-		if(++index2 >= Length)
-			index2 = 0;
-		if(++index3 >= Length)
-			index3 = 0;
-		if(++index4 >= Length)
-			index4 = 0;
-		return output;
+	void SetLength (int lane, int inLength)
+	{
+		DelayLineLanes<T, NumLanes, S>::SetLength(lane, inLength);
+		UpdateTapDelays(lane);
+	}
 
-    }
+	void SetBuffer(S* inBuffer, int maxLength)
+	{
+		DelayLineLanes<T, NumLanes, S>::SetBuffer(inBuffer, maxLength);
+		for(int k = 0; k < NumLanes; k++)
+			UpdateTapDelays(k);
+	}
 
-	void SetIndex (int Index1, int Index2, int Index3, int Index4)
+	//the taps fade along with the lengths
+	void BeginFade(int fadeLength)
 	{
-		index1 = Index1;
-		index2 = Index2;
-		index3 = Index3;
-		index4 = Index4;
+		DelayLineLanes<T, NumLanes, S>::BeginFade(fadeLength);
+		std::copy(&tapDelays[0][0], &tapDelays[0][0] + NumTaps * NumLanes, &fromTapDelays[0][0]);
 	}
 
+	void SkipFade(int lane)
+	{
+		DelayLineLanes<T, NumLanes, S>::SkipFade(lane);
+		for(int i = 0; i < NumTaps; i++)
+			fromTapDelays[i][lane] = tapDelays[i][lane];
+	}
 
-	T GetIndex (int Index)
+	//the tap of one lane as it was age samples ago, age must be below DelayLineMaxBlock
+	T GetIndex (int lane, int Index, int age) const
 	{
-		switch (Index)
-		{
-			case 0:
-				return buffer[index1];
-				break;
-			case 1:
-				return buffer[index2];
-				break;
-			case 2:
-				return buffer[index3];
-				break;
-			case 3:
-				return buffer[index4];
-				break;
-			default:
-				return buffer[index1];
-				break;
+		unsigned position = this->writeIndex - age;
+		T value = Format::Load(this->buffer[((position - tapDelays[Index][lane]) & this->mask) * NumLanes + lane]);
+		if(this->Fading){
+			T from = Format::Load(this->buffer[((position - fromTapDelays[Index][lane]) & this->mask) * NumLanes + lane]);
+			value = from + (value - from) * this->FadeGain(position - 1);
 		}
+		return value;
 	}
 
+	//prefetches the taps first to last for the next n samples written, the reads of GetIndex
+	//with the ages n - 1 down to 0 once they are
+	void PrefetchTaps(int first, int last, int n) const
+	{
+		for(int i = first; i <= last; i++)
+			this->PrefetchReads(this->writeIndex + 1, tapDelays[i], n);
+	}
 
-	void SetLength (int inLength)
-    {
-       if( inLength >= maxLength )
-			inLength = maxLength;
-	   if( inLength < 0 )
-			inLength = 0;
+	//the tap Index of every lane
+	typename DelayLineLanes<T, NumLanes, S>::Vector GetIndex (int Index, int age) const
+	{
+		using Vector = typename DelayLineLanes<T, NumLanes, S>::Vector;
+		unsigned position = this->writeIndex - age;
+		Vector value = this->Gather(position, tapDelays[Index]);
+		if(this->Fading){
+			Vector from = this->Gather(position, fromTapDelays[Index]);
+			value = from + (value - from) * Vector(this->FadeGain(position - 1));
+		}
+		return value;
+	}
+};
 
-        this->Length = inLength;
-    }
+//Allpass<T> is a single line, Allpass<T, NumLanes> runs NumLanes of them side by side
+template<typename T, int NumLanes, typename S>
+class Allpass : public DelayLineLanes<T, NumLanes, S>
+{
+public:
+	using Vector = LaneVector<T, NumLanes>;
 
+private:
+	Vector Feedback;
 
-    void Clear()
+public:
+    Allpass()
+    {
+		Feedback = Vector(T(0.5));
+    }
+
+	Vector operator()(const Vector& input)
     {
-        memset(buffer, 0, sizeof(buffer));
-		index1 = index2  = index3 = index4 = 0;
+		Vector bufout = this->ReadOutput(this->writeIndex);
+		Vector temp = input * -Feedback;
+		Vector output = bufout + temp;
+		this->Write(input + (output*Feedback));
+		return output;
     }
 
+	void Process(const Vector* input, Vector* output, int n)
+	{
+		for(int i = 0; i < n; i++)
+			output[i] = (*this)(input[i]);
+	}
 
-    int GetLength() const
+	void SetFeedback(T feedback)
     {
-        return Length;
+        Feedback = Vector(feedback);
     }
 };
 
-template<typename T, int maxLength>
-class StaticDelayLineEightTap
+template<typename T, typename S>
+class Allpass<T, 1, S> : public DelayLineBase<T, S>
 {
 private:
-    T buffer[maxLength];
-	int index1, index2, index3, index4, index5, index6, index7, index8;
-	int Length;
 	T Feedback;
 
 public:
-    StaticDelayLineEightTap()
+    Allpass()
     {
-		SetLength ( maxLength - 1 );
-		Clear();
+		Feedback = 0.5;
     }
 
-	//get ouput and iterate
 	T operator()(T input)
     {
-		T output = buffer[index1];
-		buffer[index1++] = input;
-		if(index1 >= Length)
-			index1 = 0;
-		if(++index2 >= Length)
-			index2 = 0;
-		if(++index3 >= Length)
-			index3 = 0;
-		if(++index4 >= Length)
-			index4 = 0;
-		if(++index5 >= Length)
-			index5 = 0;
-		if(++index6 >= Length)
-			index6 = 0;
-		if(++index7 >= Length)
-			index7 = 0;
-		if(++index8 >= Length)
-			index8 = 0;
+		T bufout = this->Read(this->Length);
+		T temp = input * -Feedback;
+		T output = bufout + temp;
+		this->Write(input + (output*Feedback));
 		return output;
-
     }
 
-	void SetIndex (int Index1, int Index2, int Index3, int Index4, int Index5, int Index6, int Index7, int Index8)
+	void Process(const T* input, T* output, int n)
 	{
-		index1 = Index1;
-		index2 = Index2;
-		index3 = Index3;
-		index4 = Index4;
-		index5 = Index5;
-		index6 = Index6;
-		index7 = Index7;
-		index8 = Index8;
+		for(int i = 0; i < n; i++)
+			output[i] = (*this)(input[i]);
 	}
 
+	void SetFeedback(T feedback)
+    {
+        Feedback = feedback;
+    }
+};
 
-	T GetIndex (int Index)
+template<typename T, int NumLanes, int NumTaps, typename S>
+class StaticAllpassTaps : public DelayLineTaps<T, NumLanes, NumTaps, S>
+{
+public:
+	using Vector = LaneVector<T, NumLanes>;
+
+private:
+	Vector Feedback;
+
+public:
+    StaticAllpassTaps()
+    {
+		Feedback = Vector(T(0.5));
+    }
+
+	Vector operator()(const Vector& input)
+    {
+		Vector bufout = this->ReadOutput(this->writeIndex);
+		Vector temp = input * -Feedback;
+		Vector output = bufout + temp;
+		this->Write(input + (output*Feedback));
+		return output;
+    }
+
+	void Process(const Vector* input, Vector* output, int n)
 	{
-		switch (Index)
-		{
-			case 0:
-				return buffer[index1];
-				break;
-			case 1:
-				return buffer[index2];
-				break;
-			case 2:
-				return buffer[index3];
-				break;
-			case 3:
-				return buffer[index4];
-				break;
-            case 4:
-				return buffer[index5];
-				break;
-			case 5:
-				return buffer[index6];
-				break;
-			case 6:
-				return buffer[index7];
-				break;
-			case 7:
-				return buffer[index8];
-				break;
-			default:
-				return buffer[index1];
-				break;
-		}
+		for(int i = 0; i < n; i++)
+			output[i] = (*this)(input[i]);
 	}
 
-
-	void SetLength (int inLength)
+	void SetFeedback(T feedback)
     {
-       if( inLength >= maxLength )
-			inLength = maxLength;
-	   if( inLength < 0 )
-			inLength = 0;
+        Feedback = Vector(feedback);
+    }
 
-        this->Length = inLength;
+	void SetFeedback(const Vector& feedback)
+    {
+        Feedback = feedback;
     }
+};
 
+template<typename T, int NumLanes, typename S>
+class StaticDelayLine : public DelayLineLanes<T, NumLanes, S>
+{
+public:
+	using Vector = LaneVector<T, NumLanes>;
 
-    void Clear()
+	Vector operator()(const Vector& input)
+    {
+		Vector output = this->ReadOutput(this->writeIndex);
+		this->Write(input);
+		return output;
+    }
+};
+
+template<typename T, typename S>
+class StaticDelayLine<T, 1, S> : public DelayLineBase<T, S>
+{
+public:
+	T operator()(T input)
     {
-        memset(buffer, 0, sizeof(buffer));
-		index1 = index2  = index3 = index4 = index5 = index6 = index7 = index8 = 0;
+		T output = this->Read(this->Length);
+		this->Write(input);
+		return output;
     }
+};
 
+template<typename T, int NumLanes, int NumTaps, typename S>
+class StaticDelayLineTaps : public DelayLineTaps<T, NumLanes, NumTaps, S>
+{
+public:
+	using Vector = LaneVector<T, NumLanes>;
 
-    int GetLength() const
+	//get ouput and iterate
+	Vector operator()(const Vector& input)
     {
-        return Length;
+		Vector output = this->ReadOutput(this->writeIndex);
+		this->Write(input);
+		return output;
     }
+
+	void Process(const Vector* input, Vector* output, int n)
+	{
+		for(int i = 0; i < n; i++)
+			output[i] = (*this)(input[i]);
+	}
 };
 
-template<typename T, int OverSampleCount>
+//filters NumLanes signals, each lane can have a frequency of its own
+template<typename T, int OverSampleCount, int NumLanes = 1>
     class StateVariable
     {
     public:
+        using Vector = LaneVector<T, NumLanes>;
+        //the type of the rate and the cutoff, see MVerb::Control
+        using Control = T;
 
         enum FilterType
         {
@@ -758,22 +1905,25 @@ template<typename T, int OverSampleCount>
     private:
 
         T sampleRate;
-        T frequency;
+        T frequency[NumLanes];
         T q;
-        T f;
+        Vector f;
 
-        T low;
-        T high;
-        T band;
-        T notch;
+        Vector low;
+        Vector high;
+        Vector band;
+        Vector notch;
 
-        T &out = low;
+        //FilterType of the output. This used to be a reference to the state, Type() copied into
+        //it instead of rebinding and MVerbBatch came out wrong at -O3 with it.
+        int type;
 
     public:
         StateVariable()
         {
+            for(int k = 0; k < NumLanes; k++)
+                frequency[k] = 1000.;
             SetSampleRate(44100.);
-            Frequency(1000.);
             Resonance(0);
             Type(LOWPASS);
             Reset();
@@ -783,21 +1933,45 @@ template<typename T, int OverSampleCount>
 			return *this;
 		}
 
-        T operator()(T input)
+        Vector operator()(const Vector& input)
         {
             for(unsigned int i = 0; i < OverSampleCount; i++)
             {
-                low += f * band + 1e-25;
-                high = input - low - q * band;
-                band += f * high;
+                low = Vector::Narrow(low.Widen() + ((band * f).Widen() + typename Vector::Wide::Scalar(1e-25)));
+                high = input - low - band * q;
+                band += high * f;
                 notch = low + high;
             }
-			return out;
+            switch(type)
+            {
+            case HIGHPASS:
+                return high;
+            case BANDPASS:
+                return band;
+            case NOTCH:
+                return notch;
+            default:
+                return low;
+            }
+        }
+
+        void Process(const Vector* input, Vector* output, int n)
+        {
+            for(int i = 0; i < n; i++)
+                output[i] = (*this)(input[i]);
         }
 
         void Reset()
         {
-            low = high = band = notch = 0;
+            low = high = band = notch = Vector(T(0));
+        }
+
+        void ResetLane(int lane)
+        {
+            low.Set(lane, T(0));
+            high.Set(lane, T(0));
+            band.Set(lane, T(0));
+            notch.Set(lane, T(0));
         }
 
         void SetSampleRate(T inSampleRate)
@@ -806,10 +1980,27 @@ template<typename T, int OverSampleCount>
             UpdateCoefficient();
         }
 
+        //the coefficients are only recomputed for a new frequency
         void Frequency(T inFrequency)
         {
-            this->frequency = inFrequency;
-            UpdateCoefficient();
+            bool changed = false;
+            for(int k = 0; k < NumLanes; k++){
+                changed |= this->frequency[k] != inFrequency;
+                this->frequency[k] = inFrequency;
+            }
+            if (changed)
+                UpdateCoefficient();
+        }
+
+        void Frequency(const Vector& inFrequency)
+        {
+            bool changed = false;
+            for(int k = 0; k < NumLanes; k++){
+                changed |= this->frequency[k] != inFrequency.Get(k);
+                this->frequency[k] = inFrequency.Get(k);
+            }
+            if (changed)
+                UpdateCoefficient();
         }
 
         void Resonance(T resonance)
@@ -817,36 +2008,523 @@ template<typename T, int OverSampleCount>
             this->q = 2 - 2 * resonance;
         }
 
-        void Type(int type)
+        void Type(int inType)
         {
-            switch(type)
-            {
-            case LOWPASS:
-                out = low;
-                break;
+            type = inType;
+        }
 
-            case HIGHPASS:
-                out = high;
-                break;
+    private:
+        void UpdateCoefficient()
+        {
+            for(int k = 0; k < NumLanes; k++){
+                T coefficient = 2. * sinf(3.141592654 * frequency[k] / sampleRate);
+                f.Set(k, coefficient);
+            }
+        }
+	};
 
-            case BANDPASS:
-                out = band;
-                break;
+//tan(pi * frequency / sampleRate), the cutoff coefficient of the TPT filters. It is interpolated
+//from a table over the normalized frequency that all filters share, which is built on first use.
+template<typename T>
+struct CutoffTable
+{
+    enum { Size = 4096 };
+    static constexpr double MaxNormalized = 0.49;
 
-            case NOTCH:
-                out = notch;
-                break;
+    static T Get(T frequency, T sampleRate)
+    {
+        static const std::array<T, Size + 1> table = Build();
+        double position = std::min(std::max(double(frequency) / sampleRate, 0.), MaxNormalized) * (2 * Size);
+        int index = (int)position;
+        T fraction = position - index;
+        return table[index] + (table[index + 1] - table[index]) * fraction;
+    }
 
-            default:
-                out = low;
-                break;
+private:
+    static std::array<T, Size + 1> Build()
+    {
+        std::array<T, Size + 1> table;
+        for(int i = 0; i <= Size; i++)
+            table[i] = std::tan(3.14159265358979323846 * std::min(i / (2. * Size), MaxNormalized + 0.01));
+        return table;
+    }
+};
+
+//two pole lowpass with the response of the analog prototype of StateVariable (Q = 0.5) at the
+//cutoff, a topology preserving transform SVF that needs no oversampling. Each lane can have
+//a frequency of its own.
+template<typename T, int NumLanes = 1>
+class TptLowpass
+{
+public:
+    using Vector = LaneVector<T, NumLanes>;
+    using Control = T;
+
+private:
+    T sampleRate;
+    T frequency[NumLanes];
+    Vector a1, a2, a3;
+    Vector ic1eq, ic2eq;
+
+public:
+    TptLowpass()
+    {
+        for(int k = 0; k < NumLanes; k++)
+            frequency[k] = 1000.;
+        SetSampleRate(44100.);
+        Reset();
+    }
+
+    Vector operator()(const Vector& input)
+    {
+        Vector v3 = input - ic2eq;
+        Vector v1 = a1 * ic1eq + a2 * v3;
+        Vector v2 = ic2eq + a2 * ic1eq + a3 * v3;
+        ic1eq = v1 + v1 - ic1eq;
+        ic2eq = v2 + v2 - ic2eq + T(1e-25);
+        return v2;
+    }
+
+    void Process(const Vector* input, Vector* output, int n)
+    {
+        for(int i = 0; i < n; i++)
+            output[i] = (*this)(input[i]);
+    }
+
+    void Reset()
+    {
+        ic1eq = ic2eq = Vector(T(0));
+    }
+
+    void ResetLane(int lane)
+    {
+        ic1eq.Set(lane, T(0));
+        ic2eq.Set(lane, T(0));
+    }
+
+    void SetSampleRate(T inSampleRate)
+    {
+        sampleRate = inSampleRate;
+        for(int k = 0; k < NumLanes; k++)
+            UpdateCoefficients(k);
+    }
+
+    //the coefficients are only recomputed for a new frequency
+    void Frequency(T inFrequency)
+    {
+        for(int k = 0; k < NumLanes; k++){
+            if (frequency[k] != inFrequency){
+                frequency[k] = inFrequency;
+                UpdateCoefficients(k);
             }
         }
+    }
 
-    private:
-        void UpdateCoefficient()
-        {
-            f = 2. * sinf(3.141592654 * frequency / sampleRate);
+    void Frequency(const Vector& inFrequency)
+    {
+        for(int k = 0; k < NumLanes; k++){
+            if (frequency[k] != inFrequency.Get(k)){
+                frequency[k] = inFrequency.Get(k);
+                UpdateCoefficients(k);
+            }
         }
-	};
+    }
+
+private:
+    void UpdateCoefficients(int lane)
+    {
+        //k = 1 / Q = 2
+        T g = CutoffTable<T>::Get(frequency[lane], sampleRate);
+        T d = 1 / (1 + g * (g + 2));
+        a1.Set(lane, d);
+        a2.Set(lane, g * d);
+        a3.Set(lane, g * g * d);
+    }
+};
+
+//Filter with its state in double for a float engine fed with double buffers. At low cutoffs
+//float integrators lose the small steps they accumulate, which costs a float engine about
+//25 dB of accuracy against a double one. Input and output stay in T, the rate and the cutoff
+//are taken in double.
+template<template<typename, int> class Filter, typename T, int NumLanes>
+class WideLowpass
+{
+public:
+    using Vector = LaneVector<T, NumLanes>;
+
+private:
+    using Wide = typename Vector::Wide;
+    Filter<typename Wide::Scalar, NumLanes> filter;
+
+public:
+    using Control = typename Wide::Scalar;
+
+public:
+    Vector operator()(const Vector& input)
+    {
+        return Vector::Narrow(filter(input.Widen()));
+    }
+
+    void Process(const Vector* input, Vector* output, int n)
+    {
+        for(int i = 0; i < n; i++)
+            output[i] = (*this)(input[i]);
+    }
+
+    void Reset()
+    {
+        filter.Reset();
+    }
+
+    void ResetLane(int lane)
+    {
+        filter.ResetLane(lane);
+    }
+
+    void SetSampleRate(Control inSampleRate)
+    {
+        filter.SetSampleRate(inSampleRate);
+    }
+
+    void Frequency(Control inFrequency)
+    {
+        filter.Frequency(inFrequency);
+    }
+
+    void Frequency(const Vector& inFrequency)
+    {
+        filter.Frequency(inFrequency.Widen());
+    }
+};
+
+//one pole lowpass (TPT), half the work of TptLowpass with a 6dB instead of a 12dB slope
+template<typename T, int NumLanes = 1>
+class OnePoleLowpass
+{
+public:
+    using Vector = LaneVector<T, NumLanes>;
+    using Control = T;
+
+private:
+    T sampleRate;
+    T frequency[NumLanes];
+    Vector G;
+    Vector state;
+
+public:
+    OnePoleLowpass()
+    {
+        for(int k = 0; k < NumLanes; k++)
+            frequency[k] = 1000.;
+        SetSampleRate(44100.);
+        Reset();
+    }
+
+    Vector operator()(const Vector& input)
+    {
+        Vector v = (input - state) * G;
+        Vector output = v + state;
+        state = output + v + T(1e-25);
+        return output;
+    }
+
+    void Process(const Vector* input, Vector* output, int n)
+    {
+        for(int i = 0; i < n; i++)
+            output[i] = (*this)(input[i]);
+    }
+
+    void Reset()
+    {
+        state = Vector(T(0));
+    }
+
+    void ResetLane(int lane)
+    {
+        state.Set(lane, T(0));
+    }
+
+    void SetSampleRate(T inSampleRate)
+    {
+        sampleRate = inSampleRate;
+        for(int k = 0; k < NumLanes; k++)
+            UpdateCoefficients(k);
+    }
+
+    //the coefficients are only recomputed for a new frequency
+    void Frequency(T inFrequency)
+    {
+        for(int k = 0; k < NumLanes; k++){
+            if (frequency[k] != inFrequency){
+                frequency[k] = inFrequency;
+                UpdateCoefficients(k);
+            }
+        }
+    }
+
+    void Frequency(const Vector& inFrequency)
+    {
+        for(int k = 0; k < NumLanes; k++){
+            if (frequency[k] != inFrequency.Get(k)){
+                frequency[k] = inFrequency.Get(k);
+                UpdateCoefficients(k);
+            }
+        }
+    }
+
+private:
+    void UpdateCoefficients(int lane)
+    {
+        T g = CutoffTable<T>::Get(frequency[lane], sampleRate);
+        G.Set(lane, g / (1 + g));
+    }
+};
+
+
+//halfband lowpass (Kaiser windowed sinc) with 4 * K - 1 taps that halves or doubles the rate.
+//Every other tap is zero and the center tap is 1/2, so only K pairs of symmetric taps need a
+//multiply. Design() returns their coefficients, closest to the center first.
+template<typename T, int K>
+struct HalfbandLowpass
+{
+    static void Design(double beta, T* coefficients)
+    {
+        const double pi = 3.14159265358979323846;
+        auto bessel = [](double x){
+            double sum = 1, term = 1;
+            for(int k = 1; k < 32; k++){
+                term *= (x / (2 * k)) * (x / (2 * k));
+                sum += term;
+            }
+            return sum;
+        };
+        double taps[K], sum = 0;
+        for(int k = 0; k < K; k++){
+            int offset = 2 * k + 1;
+            double window = double(offset) / (2 * K);
+            taps[k] = std::sin(pi * offset / 2) / (pi * offset) * bessel(beta * std::sqrt(1 - window * window)) / bessel(beta);
+            sum += taps[k];
+        }
+        //both sides add up to 1/2 like the center, which keeps the gain at 0Hz at exactly 1
+        for(int k = 0; k < K; k++)
+            coefficients[k] = T(taps[k] * 0.25 / sum);
+    }
+};
+
+//2:1 halfband decimation. Read() returns the low rate sample that ends with the last input
+//written and is called after every second Write().
+template<typename T, int NumLanes, int K>
+class HalfbandDecimator
+{
+public:
+    using Vector = LaneVector<T, NumLanes>;
+    enum { Length = 4 * K - 1 };
+
+private:
+    //the last Length inputs, stored twice so that they can be read without a wrap around
+    Vector history[2 * Length];
+    T coefficients[K];
+    int position;
+
+public:
+    HalfbandDecimator(double beta)
+    {
+        HalfbandLowpass<T, K>::Design(beta, coefficients);
+        Reset();
+    }
+
+    void Reset()
+    {
+        std::fill(history, history + 2 * Length, Vector(T(0)));
+        position = 0;
+    }
+
+    void Write(const Vector& input)
+    {
+        history[position] = input;
+        history[position + Length] = input;
+        if(++position == Length)
+            position = 0;
+    }
+
+    //the two inputs that share a coefficient are added first, two sums keep the additions
+    //from waiting on each other
+    Vector Read() const
+    {
+        const Vector* center = history + position + 2 * K - 1;
+        Vector even = center[0] * T(0.5), odd(T(0));
+        for(int k = 0; k < K; k += 2){
+            even = even + (center[-2 * k - 1] + center[2 * k + 1]) * coefficients[k];
+            odd = odd + (center[-2 * k - 3] + center[2 * k + 3]) * coefficients[k + 1];
+        }
+        return even + odd;
+    }
+};
+
+//1:2 halfband interpolation. After each Write() at the low rate Even() and Odd() are the two
+//high rate samples that follow it. Odd() is the center tap alone, a delayed input.
+template<typename T, int NumLanes, int K>
+class HalfbandInterpolator
+{
+public:
+    using Vector = LaneVector<T, NumLanes>;
+    enum { Length = 2 * K };
+
+private:
+    Vector history[2 * Length];
+    //twice the filter coefficients for the zeros between the inputs
+    T coefficients[K];
+    int position;
+
+public:
+    HalfbandInterpolator(double beta)
+    {
+        HalfbandLowpass<T, K>::Design(beta, coefficients);
+        for(int k = 0; k < K; k++)
+            coefficients[k] *= 2;
+        Reset();
+    }
+
+    void Reset()
+    {
+        std::fill(history, history + 2 * Length, Vector(T(0)));
+        position = 0;
+    }
+
+    void Write(const Vector& input)
+    {
+        history[position] = input;
+        history[position + Length] = input;
+        if(++position == Length)
+            position = 0;
+    }
+
+    //see HalfbandDecimator::Read()
+    Vector Even() const
+    {
+        const Vector* newest = history + position + Length - 1;
+        Vector even(T(0)), odd(T(0));
+        for(int k = 0; k < K; k += 2){
+            even = even + (newest[-K - k] + newest[-K + 1 + k]) * coefficients[k];
+            odd = odd + (newest[-K - k - 1] + newest[-K + 2 + k]) * coefficients[k + 1];
+        }
+        return even + odd;
+    }
+
+    Vector Odd() const
+    {
+        return history[position + Length - K];
+    }
+};
+
+//keeps every factor-th sample of the lowpass filtered input. Write() takes a sample at the
+//high rate, Read() is called after every factor-th of them.
+template<typename T, int NumLanes = 1>
+class Decimator
+{
+public:
+    using Vector = LaneVector<T, NumLanes>;
+
+private:
+    HalfbandDecimator<T, NumLanes, ResamplerStages::HighK> high;
+    HalfbandDecimator<T, NumLanes, ResamplerStages::LowK> low;
+    int factor;
+    int phase;
+
+public:
+    Decimator() : high(ResamplerStages::HighBeta), low(ResamplerStages::LowBeta)
+    {
+        SetFactor(2);
+    }
+
+    void SetFactor(int inFactor)
+    {
+        factor = inFactor;
+        Reset();
+    }
+
+    void Reset()
+    {
+        high.Reset();
+        low.Reset();
+        phase = 0;
+    }
+
+    void Write(const Vector& input)
+    {
+        if(factor == 4){
+            high.Write(input);
+            phase ^= 1;
+            if(phase)
+                return;
+            low.Write(high.Read());
+        }else{
+            low.Write(input);
+        }
+    }
+
+    Vector Read() const
+    {
+        return low.Read();
+    }
+};
+
+//the lowpass filtered input with factor - 1 zeros after every sample. Write() takes a sample
+//at the low rate and computes the factor high rate samples that follow it, Get(phase) returns
+//them in order.
+template<typename T, int NumLanes = 1>
+class Interpolator
+{
+public:
+    using Vector = LaneVector<T, NumLanes>;
+
+private:
+    HalfbandInterpolator<T, NumLanes, ResamplerStages::LowK> low;
+    HalfbandInterpolator<T, NumLanes, ResamplerStages::HighK> high;
+    Vector outputs[4];
+    int factor;
+
+public:
+    Interpolator() : low(ResamplerStages::LowBeta), high(ResamplerStages::HighBeta)
+    {
+        SetFactor(2);
+    }
+
+    void SetFactor(int inFactor)
+    {
+        factor = inFactor;
+        Reset();
+    }
+
+    void Reset()
+    {
+        low.Reset();
+        high.Reset();
+        std::fill(outputs, outputs + 4, Vector(T(0)));
+    }
+
+    void Write(const Vector& input)
+    {
+        low.Write(input);
+        if(factor == 4){
+            high.Write(low.Even());
+            outputs[0] = high.Even();
+            outputs[1] = high.Odd();
+            high.Write(low.Odd());
+            outputs[2] = high.Even();
+            outputs[3] = high.Odd();
+        }else{
+            outputs[0] = low.Even();
+            outputs[1] = low.Odd();
+        }
+    }
+
+    Vector Get(int phase) const
+    {
+        return outputs[phase];
+    }
+};
+
+MVERB_NAMESPACE_END
+
 #endif
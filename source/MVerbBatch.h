@@ -0,0 +1,551 @@
+//  Copyright (c) 2022 Arne Scheffler
+//  This code is distributed under the terms of the GNU General Public License
+
+//  MVerb is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  at your option) any later version.
+//
+//  MVerb is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this MVerb.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef MVERBBATCH_H
+#define MVERBBATCH_H
+
+#include "MVerb.h"
+
+MVERB_NAMESPACE_BEGIN
+
+//N independent stereo reverbs, each one a lane of the vectors the engine runs on: four with SSE,
+//eight with AVX2 and sixteen with AVX-512 (other widths and targets use the portable
+//LaneVector). Every lane has its own parameters, state and delay memory, lanes can be added and
+//removed without touching the others. All lanes share the sample rate and the block size of a
+//process call.
+//
+//The structure is the one of MVerb with the lanes holding instances instead of channels. Where
+//MVerb<float> evaluates an expression in double the batch stays in T, so a lane follows
+//MVerb<T> closely but not bit for bit. Lowpass selects the filter kernel as for MVerb.
+template<typename T, int N, template<typename, int> class Lowpass = OversampledStateVariable>
+class MVerbBatch
+{
+public:
+    using Vector = LaneVector<T, N>;
+    enum { NUM_LANES = N };
+
+    //parameter indices are the ones of MVerb
+    enum
+        {
+            DAMPINGFREQ = MVerb<T>::DAMPINGFREQ,
+            DENSITY = MVerb<T>::DENSITY,
+            BANDWIDTHFREQ = MVerb<T>::BANDWIDTHFREQ,
+            DECAY = MVerb<T>::DECAY,
+            PREDELAY = MVerb<T>::PREDELAY,
+            SIZE = MVerb<T>::SIZE,
+            GAIN = MVerb<T>::GAIN,
+            MIX = MVerb<T>::MIX,
+            EARLYMIX = MVerb<T>::EARLYMIX,
+            NUM_PARAMS = MVerb<T>::NUM_PARAMS
+        };
+
+private:
+    typedef MVerbTopology Topology;
+    enum { LEFT = 0, RIGHT };
+    enum { NUM_DELAYLINES = 15 };
+    enum { MaxBlockSize = DelayLineMaxBlock };
+
+    //the lines of MVerb with the channels split again, each one holding all lanes
+    Lowpass<T,N> bandwidthFilter[2];
+    StaticDelayLineEightTap<T,N> earlyReflectionsDelayLine[2];
+    StaticDelayLine<T,N> predelay;
+    Allpass<T,N> allpass[4];
+    StaticAllpassFourTap<T,N> allpassFourTap[4];
+    StaticDelayLineFourTap<T,N> staticDelayLine[4];
+    Lowpass<T,N> damping[2];
+
+    Vector MixSmooth, EarlyLateSmooth, BandwidthSmooth, DampingSmooth, PredelaySmooth, SizeSmooth, DensitySmooth, DecaySmooth;
+    Vector PreviousLeftTank, PreviousRightTank;
+    Vector TankSize;
+    Vector DampingFreq, Density1, BandwidthFreq, PreDelayTime, Decay, Gain, Mix, EarlyMix, Size;
+    int ControlRate, ControlRateCounter;
+    T SampleRate;
+    bool active[N];
+    bool tankCleared[N];
+    DelayArena<T> arena;
+
+    //the original line index j of the tank maps to stage j % 2 of half j / 2
+    static double tankAllpassTime(int j){
+        return Topology::TankAllpassTimes[j % 2][j / 2];
+    }
+
+    static double tankDelayLineTime(int j){
+        return Topology::TankDelayLineTimes[j % 2][j / 2];
+    }
+
+    static int maxLineLength(double time, T sampleRate){
+        return (int)(time * sampleRate) + 1;
+    }
+
+    static size_t paddedLength(int length){
+        const size_t samplesPerCacheLine = CacheLineSize / sizeof(T);
+        size_t capacity = DelayLineCapacity(length) * N;
+        return (capacity + samplesPerCacheLine - 1) / samplesPerCacheLine * samplesPerCacheLine;
+    }
+
+    //in the arena order of MVerb
+    static void getMaxLineLengths(T sampleRate, int lengths[NUM_DELAYLINES]){
+        lengths[0] = maxLineLength(Topology::EarlyReflectionsTimes[LEFT], sampleRate);
+        lengths[1] = maxLineLength(Topology::EarlyReflectionsTimes[RIGHT], sampleRate);
+        lengths[2] = maxLineLength(Topology::MaxPredelayTime, sampleRate);
+        for(int j=0;j<4;j++)
+            lengths[3+j] = maxLineLength(Topology::AllpassTimes[j], sampleRate);
+        for(int j=0;j<4;j++){
+            lengths[7+2*j] = maxLineLength(tankAllpassTime(j) * Topology::MaxSize, sampleRate);
+            lengths[8+2*j] = maxLineLength(tankDelayLineTime(j) * Topology::MaxSize, sampleRate);
+        }
+    }
+
+    static size_t getArenaSize(T sampleRate){
+        int lengths[NUM_DELAYLINES];
+        getMaxLineLengths(sampleRate, lengths);
+        size_t size = 0;
+        for(int j=0;j<NUM_DELAYLINES;j++)
+            size += paddedLength(lengths[j]);
+        return size;
+    }
+
+    void allocateDelayLines(){
+        int lengths[NUM_DELAYLINES];
+        getMaxLineLengths(SampleRate, lengths);
+        arena.Allocate(getArenaSize(SampleRate), false);
+        T* buffer = arena.GetData();
+        int line = 0;
+        auto assign = [&](auto& delayLine){
+            delayLine.SetBuffer(buffer, lengths[line]);
+            buffer += paddedLength(lengths[line++]);
+        };
+        assign(earlyReflectionsDelayLine[LEFT]);
+        assign(earlyReflectionsDelayLine[RIGHT]);
+        assign(predelay);
+        for(int j=0;j<4;j++)
+            assign(allpass[j]);
+        for(int j=0;j<4;j++){
+            assign(allpassFourTap[j]);
+            assign(staticDelayLine[j]);
+        }
+    }
+
+    void setTankLengths(int lane, T size){
+        for(int j=0;j<4;j++){
+            allpassFourTap[j].SetLength(lane, tankAllpassTime(j) * SampleRate * size);
+            Topology::SetTaps(allpassFourTap[j], lane, Topology::TankAllpassTaps[j % 2][j / 2], SampleRate, size);
+            staticDelayLine[j].SetLength(lane, tankDelayLineTime(j) * SampleRate * size);
+            Topology::SetTaps(staticDelayLine[j], lane, Topology::TankDelayLineTaps[j % 2][j / 2], SampleRate, size);
+        }
+        TankSize.Set(lane, size);
+    }
+
+    //an empty tank takes a new size right away, even during a fade of the other lanes
+    void jumpTankLengths(int lane){
+        SizeSmooth.Set(lane, Size.Get(lane));
+        setTankLengths(lane, Size.Get(lane));
+        for(int j=0;j<4;j++){
+            allpassFourTap[j].SkipFade(lane);
+            staticDelayLine[j].SkipFade(lane);
+        }
+    }
+
+    //see MVerb::updateTankLengths, lanes keeping their size read the same with or without fade
+    void updateTankLengths(const Vector& size){
+        for(int j=0;j<4;j++){
+            allpassFourTap[j].EndFade();
+            staticDelayLine[j].EndFade();
+        }
+        alignas(CacheLineSize) T sizes[N], tankSizes[N];
+        size.Store(sizes);
+        TankSize.Store(tankSizes);
+        bool anyChanged = false;
+        for(int lane=0;lane<N;lane++)
+            anyChanged |= sizes[lane] != tankSizes[lane];
+        if(!anyChanged)
+            return;
+        for(int j=0;j<4;j++){
+            allpassFourTap[j].BeginFade(ControlRate);
+            staticDelayLine[j].BeginFade(ControlRate);
+        }
+        for(int lane=0;lane<N;lane++){
+            if(sizes[lane] != tankSizes[lane])
+                setTankLengths(lane, sizes[lane]);
+        }
+    }
+
+    //the parameters of a new MVerb instance
+    void setDefaults(int lane){
+        DampingFreq.Set(lane, 0.9);
+        BandwidthFreq.Set(lane, 0.9);
+        Decay.Set(lane, 0.5);
+        Density1.Set(lane, 0.5);
+        Gain.Set(lane, 1.);
+        Mix.Set(lane, 1.);
+        Size.Set(lane, 1.);
+        EarlyMix.Set(lane, 1.);
+        PreDelayTime.Set(lane, 100 * (SampleRate / 1000));
+    }
+
+    //the state of a new MVerb instance
+    void resetLane(int lane){
+        const T zero = 0;
+        for(Vector* smoother : {&MixSmooth, &EarlyLateSmooth, &BandwidthSmooth, &DampingSmooth, &PredelaySmooth, &DensitySmooth, &DecaySmooth})
+            smoother->Set(lane, zero);
+        PreviousLeftTank.Set(lane, zero);
+        PreviousRightTank.Set(lane, zero);
+        for(int channel=LEFT;channel<=RIGHT;channel++){
+            bandwidthFilter[channel].ResetLane(lane);
+            damping[channel].ResetLane(lane);
+            earlyReflectionsDelayLine[channel].ClearLane(lane);
+            earlyReflectionsDelayLine[channel].SetLength(lane, Topology::EarlyReflectionsTimes[channel] * SampleRate);
+            Topology::SetTaps(earlyReflectionsDelayLine[channel], lane, Topology::EarlyReflectionsTaps[channel], SampleRate, T(1));
+        }
+        predelay.ClearLane(lane);
+        predelay.SetLength(lane, PreDelayTime.Get(lane));
+        for(int j=0;j<4;j++){
+            allpass[j].ClearLane(lane);
+            allpass[j].SetLength(lane, Topology::AllpassTimes[j] * SampleRate);
+        }
+        for(int j=0;j<4;j++){
+            allpassFourTap[j].ClearLane(lane);
+            staticDelayLine[j].ClearLane(lane);
+        }
+        jumpTankLengths(lane);
+        tankCleared[lane] = true;
+    }
+
+    using EarlyTapSequence = std::make_index_sequence<std::extent<decltype(Topology::EarlyReflectionsOutputTaps)>::value>;
+    using LateTapSequence = std::make_index_sequence<std::extent<decltype(Topology::LateOutputTaps)>::value>;
+
+    //see MVerb::earlyReflectionsTaps, one channel of all lanes
+    template<size_t... I>
+    Vector earlyReflectionsTaps(int channel, const Vector& line, const Vector& direct, int age, std::index_sequence<I...>) const{
+        Vector sum = line;
+        ((sum = sum + earlyReflectionsDelayLine[channel].GetIndex(Topology::EarlyReflectionsOutputTaps[I].tap, age)
+                      * T(Topology::EarlyReflectionsOutputTaps[I].gain)), ...);
+        return sum + direct;
+    }
+
+    //the tank line Topology::TANK_ALLPASS_0 and so on of half, see tankAllpassTime
+    template<int Line>
+    const auto& tankLine(int half) const{
+        if constexpr (Line == Topology::TANK_ALLPASS_0 || Line == Topology::TANK_ALLPASS_1)
+            return allpassFourTap[Line / 2 + 2 * half];
+        else
+            return staticDelayLine[Line / 2 + 2 * half];
+    }
+
+    //see MVerb::lateTaps, one output channel of all lanes
+    template<size_t... I>
+    Vector lateTaps(int channel, int age, std::index_sequence<I...>) const{
+        return (... + (tankLine<Topology::LateOutputTaps[I].line>(Topology::LateOutputTaps[I].lanes[channel])
+                           .GetIndex(Topology::LateOutputTaps[I].taps[channel], age)
+                       * T(Topology::LateOutputTaps[I].gain)));
+    }
+
+public:
+    MVerbBatch(){
+        SampleRate = 44100.;
+        ControlRate = SampleRate / 1000;
+        ControlRateCounter = 0;
+        for(int lane=0;lane<N;lane++){
+            active[lane] = false;
+            setDefaults(lane);
+        }
+        allocateDelayLines();
+        reset();
+    }
+
+    //adds a lane with the defaults and cleared state of a new MVerb, returns -1 if all lanes
+    //are in use. Clears the lane's memory, so not realtime safe for large sample rates.
+    int addLane(){
+        for(int lane=0;lane<N;lane++){
+            if(!active[lane]){
+                active[lane] = true;
+                setDefaults(lane);
+                resetLane(lane);
+                return lane;
+            }
+        }
+        return -1;
+    }
+
+    //the lane is no longer processed, its outputs are not written anymore
+    void removeLane(int lane){
+        active[lane] = false;
+        setDefaults(lane);
+        resetLane(lane);
+    }
+
+    bool isLaneActive(int lane) const{
+        return active[lane];
+    }
+
+    int getNumActiveLanes() const{
+        int count = 0;
+        for(int lane=0;lane<N;lane++)
+            count += active[lane];
+        return count;
+    }
+
+    //inputs[lane] and outputs[lane] are the two channels of that lane like in MVerb::process,
+    //inactive lanes are neither read nor written and may be null. Returns a bit mask of the
+    //lanes whose output was silent.
+    unsigned process(T** const* inputs, T** const* outputs, int sampleFrames){
+        Vector silenceCheckSum(T(0));
+        Vector OneOverSampleFrames(T(1. / sampleFrames));
+        Vector MixDelta	= (Mix - MixSmooth) * OneOverSampleFrames;
+        Vector BandwidthDelta = (((BandwidthFreq * T(18400.)) + T(100.)) - BandwidthSmooth) * OneOverSampleFrames;
+        Vector DampingDelta = (((DampingFreq * T(18400.)) + T(100.)) - DampingSmooth) * OneOverSampleFrames;
+        Vector PredelayDelta = ((PreDelayTime * T(200) * T(SampleRate / 1000)) - PredelaySmooth) * OneOverSampleFrames;
+        Vector SizeDelta	= (Size - SizeSmooth) * OneOverSampleFrames;
+        Vector DecayDelta = (((Decay * T(0.7995f)) + T(0.005)) - DecaySmooth) * OneOverSampleFrames;
+        allpassFourTap[0].SetFeedback(Density1);
+        allpassFourTap[2].SetFeedback(Density1);
+        for(int lane=0;lane<N;lane++)
+            tankCleared[lane] = false;
+        for(int offset=0;offset<sampleFrames;){
+            bool updateFilters = ControlRateCounter >= ControlRate;
+            if (updateFilters){
+                ControlRateCounter = 0;
+                updateTankLengths(SizeSmooth + Vector(T(offset + 1)) * SizeDelta);
+            }
+            int n = std::min(sampleFrames - offset, (int)MaxBlockSize);
+            n = std::min(n, std::max(ControlRate - ControlRateCounter, 1));
+            n = std::min(n, std::min(staticDelayLine[1].GetMinLength(), staticDelayLine[3].GetMinLength()));
+            ControlRateCounter += n;
+
+            Vector mix[MaxBlockSize], decay[MaxBlockSize], density2[MaxBlockSize];
+            alignas(CacheLineSize) T predelayLength[MaxBlockSize][N];
+            //the smoothers ramp from their values at the start of the block, see MVerb::process
+            if (updateFilters){
+                Vector position(T(offset + 1));
+                bandwidthFilter[LEFT].Frequency(BandwidthSmooth + position * BandwidthDelta);
+                bandwidthFilter[RIGHT].Frequency(BandwidthSmooth + position * BandwidthDelta);
+                damping[LEFT].Frequency(DampingSmooth + position * DampingDelta);
+                damping[RIGHT].Frequency(DampingSmooth + position * DampingDelta);
+            }
+            for(int i=0;i<n;++i){
+                Vector position(T(offset + 1 + i));
+                (PredelaySmooth + position * PredelayDelta).Store(predelayLength[i]);
+                decay[i] = DecaySmooth + position * DecayDelta;
+                density2[i] = Vector::Max(Vector::Min(decay[i] + T(0.15), Vector(T(0.5))), Vector(T(0.25)));
+                mix[i] = MixSmooth + position * MixDelta;
+            }
+
+            //transpose the lanes' channels into vectors
+            alignas(CacheLineSize) T frame[2][MaxBlockSize][N];
+            for(int lane=0;lane<N;lane++){
+                for(int channel=LEFT;channel<=RIGHT;channel++){
+                    const T* input = active[lane] ? inputs[lane][channel] + offset : nullptr;
+                    for(int i=0;i<n;++i)
+                        frame[channel][i][lane] = input ? input[i] : T(0);
+                }
+            }
+            Vector left[MaxBlockSize], right[MaxBlockSize];
+            Vector bandwidthLeft[MaxBlockSize], bandwidthRight[MaxBlockSize];
+            for(int i=0;i<n;++i){
+                left[i] = Vector::Load(frame[LEFT][i]);
+                right[i] = Vector::Load(frame[RIGHT][i]);
+                bandwidthLeft[i] = bandwidthFilter[LEFT](left[i]);
+                bandwidthRight[i] = bandwidthFilter[RIGHT](right[i]);
+            }
+
+            Vector earlyReflectionsL[MaxBlockSize], earlyReflectionsR[MaxBlockSize];
+            for(int i=0;i<n;++i){
+                earlyReflectionsL[i] = earlyReflectionsDelayLine[LEFT](bandwidthLeft[i] * T(0.5) + bandwidthRight[i] * T(0.3));
+                earlyReflectionsR[i] = earlyReflectionsDelayLine[RIGHT](bandwidthLeft[i] * T(0.3) + bandwidthRight[i] * T(0.5));
+            }
+            for(int i=0, age=n-1;i<n;++i, --age){
+                earlyReflectionsL[i] = earlyReflectionsTaps(LEFT, earlyReflectionsL[i], ( bandwidthLeft[i] * T(0.4) + bandwidthRight[i] * T(0.2) ) * T(0.5),
+                                                            age, EarlyTapSequence());
+                earlyReflectionsR[i] = earlyReflectionsTaps(RIGHT, earlyReflectionsR[i], ( bandwidthLeft[i] * T(0.2) + bandwidthRight[i] * T(0.4) ) * T(0.5),
+                                                            age, EarlyTapSequence());
+            }
+
+            Vector smearedInput[MaxBlockSize];
+            for(int i=0;i<n;++i){
+                for(int lane=0;lane<N;lane++)
+                    predelay.SetLength(lane, predelayLength[i][lane]);
+                smearedInput[i] = predelay(( bandwidthRight[i] + bandwidthLeft[i] ) * T(0.5f));
+            }
+            for(int j=0;j<4;j++)
+                allpass[j].Process(smearedInput, smearedInput, n);
+
+            //see MVerb::process for why both halves can run a whole chunk
+            Vector leftTank[MaxBlockSize], rightTank[MaxBlockSize];
+            Vector leftTankOut[MaxBlockSize], rightTankOut[MaxBlockSize];
+            staticDelayLine[1].ReadAhead(leftTankOut, n);
+            staticDelayLine[3].ReadAhead(rightTankOut, n);
+            for(int i=0;i<n;++i){
+                leftTank[i] = smearedInput[i] + PreviousRightTank;
+                rightTank[i] = smearedInput[i] + PreviousLeftTank;
+                PreviousLeftTank = leftTankOut[i] * decay[i];
+                PreviousRightTank = rightTankOut[i] * decay[i];
+            }
+            allpassFourTap[0].Process(leftTank, leftTank, n);
+            allpassFourTap[2].Process(rightTank, rightTank, n);
+            staticDelayLine[0].Process(leftTank, leftTank, n);
+            staticDelayLine[2].Process(rightTank, rightTank, n);
+            for(int i=0;i<n;++i){
+                leftTank[i] = damping[LEFT](leftTank[i]);
+                rightTank[i] = damping[RIGHT](rightTank[i]);
+            }
+            for(int i=0;i<n;++i){
+                allpassFourTap[1].SetFeedback(density2[i]);
+                allpassFourTap[3].SetFeedback(density2[i]);
+                leftTank[i] = allpassFourTap[1](leftTank[i]);
+                rightTank[i] = allpassFourTap[3](rightTank[i]);
+            }
+            staticDelayLine[1].Write(leftTank, n);
+            staticDelayLine[3].Write(rightTank, n);
+
+            const Vector lateMix = Vector(T(1)) - EarlyMix;
+            for(int i=0, age=n-1;i<n;++i, --age){
+                Vector accumulatorL = lateTaps(LEFT, age, LateTapSequence());
+                Vector accumulatorR = lateTaps(RIGHT, age, LateTapSequence());
+                accumulatorL = accumulatorL * EarlyMix + earlyReflectionsL[i] * lateMix;
+                accumulatorR = accumulatorR * EarlyMix + earlyReflectionsR[i] * lateMix;
+                Vector outL = left[i] + ( accumulatorL - left[i] ) * mix[i];
+                Vector outR = right[i] + ( accumulatorR - right[i] ) * mix[i];
+                silenceCheckSum += Vector::Max(outL, -outL) + Vector::Max(outR, -outR);
+                (outL * Gain).Store(frame[LEFT][i]);
+                (outR * Gain).Store(frame[RIGHT][i]);
+            }
+            for(int lane=0;lane<N;lane++){
+                if(!active[lane])
+                    continue;
+                for(int channel=LEFT;channel<=RIGHT;channel++){
+                    T* output = outputs[lane][channel] + offset;
+                    for(int i=0;i<n;++i)
+                        output[i] = frame[channel][i][lane];
+                }
+            }
+            offset += n;
+        }
+        MixSmooth = Mix;
+        EarlyLateSmooth = EarlyMix;
+        BandwidthSmooth = (BandwidthFreq * T(18400.)) + T(100.);
+        DampingSmooth = (DampingFreq * T(18400.)) + T(100.);
+        PredelaySmooth = PreDelayTime * T(200) * T(SampleRate / 1000);
+        SizeSmooth = Size;
+        DecaySmooth = (Decay * T(0.7995f)) + T(0.005);
+        DensitySmooth = (Density1 * T(0.7995f)) + T(0.005);
+        unsigned silentLanes = 0;
+        for(int lane=0;lane<N;lane++){
+            if(silenceCheckSum.Get(lane) <= 1e-7)
+                silentLanes |= 1u << lane;
+        }
+        return silentLanes;
+    }
+
+    //clears all lanes, like MVerb::reset
+    void reset(){
+        ControlRateCounter = 0;
+        for(int channel=LEFT;channel<=RIGHT;channel++){
+            bandwidthFilter[channel].SetSampleRate(SampleRate);
+            damping[channel].SetSampleRate(SampleRate);
+        }
+        allpass[0].SetFeedback (0.75);
+        allpass[1].SetFeedback (0.75);
+        allpass[2].SetFeedback (0.625);
+        allpass[3].SetFeedback (0.625);
+        for(int lane=0;lane<N;lane++)
+            resetLane(lane);
+    }
+
+    void setParameter(int lane, int index, T value){
+        switch(index){
+            case DAMPINGFREQ:
+                    DampingFreq.Set(lane, 1. - value);
+                    break;
+            case DENSITY:
+                    Density1.Set(lane, value);
+                    break;
+            case BANDWIDTHFREQ:
+                    BandwidthFreq.Set(lane, value);
+                    break;
+            case PREDELAY:
+                    PreDelayTime.Set(lane, value);
+                    break;
+            case SIZE:
+                    Size.Set(lane, (0.95 * value) + 0.05);
+                    if(tankCleared[lane])
+                        jumpTankLengths(lane);
+                    break;
+            case DECAY:
+                    Decay.Set(lane, value);
+                    break;
+            case GAIN:
+                    Gain.Set(lane, value);
+                    break;
+            case MIX:
+                    Mix.Set(lane, value);
+                    break;
+            case EARLYMIX:
+                    EarlyMix.Set(lane, value);
+                    break;
+        }
+    }
+
+    float getParameter(int lane, int index) const{
+        switch(index){
+            case DAMPINGFREQ:
+                    return DampingFreq.Get(lane) * 100.;
+            case DENSITY:
+                    return Density1.Get(lane) * 100.f;
+            case BANDWIDTHFREQ:
+                    return BandwidthFreq.Get(lane) * 100.;
+            case PREDELAY:
+                    return PreDelayTime.Get(lane) * 100.;
+            case SIZE:
+                    return (((0.95 * Size.Get(lane)) + 0.05)*100.);
+            case DECAY:
+                    return Decay.Get(lane) * 100.f;
+            case GAIN:
+                    return Gain.Get(lane) * 100.f;
+            case MIX:
+                    return Mix.Get(lane) * 100.f;
+            case EARLYMIX:
+                    return EarlyMix.Get(lane) * 100.f;
+            default: return 0.f;
+        }
+    }
+
+    //reallocates the delay lines of all lanes, not realtime safe
+    void setSampleRate(T sr){
+        SampleRate = sr;
+        ControlRate = SampleRate / 1000;
+        allocateDelayLines();
+        reset();
+    }
+
+    //see MVerb::getSubnormalCount, summed over all lanes
+    unsigned long getSubnormalCount() const{
+        unsigned long count = predelay.GetSubnormals();
+        for(int channel=LEFT;channel<=RIGHT;channel++)
+            count += earlyReflectionsDelayLine[channel].GetSubnormals();
+        for(int j=0;j<4;j++)
+            count += allpass[j].GetSubnormals() + allpassFourTap[j].GetSubnormals() + staticDelayLine[j].GetSubnormals();
+        return count;
+    }
+
+    //bytes needed by a batch running at sampleRate, delay lines included
+    static size_t getMemorySize(T sampleRate){
+        return sizeof(MVerbBatch) + getArenaSize(sampleRate) * sizeof(T);
+    }
+};
+
+MVERB_NAMESPACE_END
+
+#endif
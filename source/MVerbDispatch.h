@@ -0,0 +1,100 @@
+//  Copyright (c) 2022 Arne Scheffler
+//  This code is distributed under the terms of the GNU General Public License
+
+//  MVerb is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  at your option) any later version.
+//
+//  MVerb is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this MVerb.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef MVERBDISPATCH_H
+#define MVERBDISPATCH_H
+
+#include <memory>
+
+//the instruction sets the engine is compiled for besides the baseline of the build. Each one is
+//a copy of MVerb and MVerbBatch in a namespace of its own (see IsaNamespace.h) built from
+//source/dispatch with the flags of that set, the best one the CPU runs is picked at run time.
+//MVerbSurround is not part of it, its vectors have four lanes at most and it runs no faster
+//with the wider sets.
+enum class MVerbIsa
+{
+    SSE2,   //the baseline of the build, also on other architectures
+    AVX2,   //AVX2 and FMA
+    AVX512  //AVX-512 F, VL, DQ and BW
+};
+
+//the part of the MVerb interface the plug-in and the tools use, implemented by the engine of
+//each instruction set. process() is one virtual call per block. T is the engine's type, Sample
+//the one of the buffers like in MVerb::process. Parameters and rates are passed as Sample, the
+//type the engine sets itself up in (MVerb::Control).
+template<typename T, typename Sample>
+class MVerbKernel
+{
+public:
+    virtual ~MVerbKernel() {}
+
+    virtual bool process(Sample **inputs, Sample **outputs, int sampleFrames) = 0;
+    virtual unsigned getSilentChannels() const = 0;
+    virtual bool setChannels(int numInputs, int numOutputs) = 0;
+    virtual bool isSleeping() const = 0;
+    virtual int getTailSamples() const = 0;
+    virtual void reset() = 0;
+    virtual void setParameter(int index, Sample value) = 0;
+    virtual float getParameter(int index) = 0;
+    virtual void setSampleRate(Sample sampleRate) = 0;
+    virtual bool setSampleRate(Sample sampleRate, int divider, bool earlyReflections) = 0;
+    virtual bool setRateDivider(int divider, bool earlyReflections = false) = 0;
+    virtual void setUseHugePages(bool state) = 0;
+    virtual MVerbIsa getIsa() const = 0;
+};
+
+//MVerb<float>
+using FloatMVerbKernel = MVerbKernel<float, float>;
+//MVerb<float, MVerbNullProbe, WideStateVariable> on double buffers, the plug-in's 64 bit engine
+using MixedMVerbKernel = MVerbKernel<float, double>;
+
+//the interface of MVerbBatch<float, N>, see MVerbKernel
+class MVerbBatchKernel
+{
+public:
+    virtual ~MVerbBatchKernel() {}
+
+    virtual int getNumLanes() const = 0;
+    virtual int addLane() = 0;
+    virtual void removeLane(int lane) = 0;
+    virtual bool isLaneActive(int lane) const = 0;
+    virtual int getNumActiveLanes() const = 0;
+    virtual unsigned process(float** const* inputs, float** const* outputs, int sampleFrames) = 0;
+    virtual void reset() = 0;
+    virtual void setParameter(int lane, int index, float value) = 0;
+    virtual float getParameter(int lane, int index) const = 0;
+    virtual void setSampleRate(float sampleRate) = 0;
+    virtual MVerbIsa getIsa() const = 0;
+};
+
+//the best instruction set that is compiled in and that the CPU and the OS support. The
+//environment variable MVERB_ISA (sse2, avx2 or avx512) lowers it for testing, a set the machine
+//can not run is never picked.
+MVerbIsa MVerbSelectIsa();
+
+//a set that is compiled in and supported by the machine
+bool MVerbIsaAvailable(MVerbIsa isa);
+
+const char* MVerbIsaName(MVerbIsa isa);
+
+//engines of instruction set isa, the baseline one if isa is not available. Not realtime safe.
+std::unique_ptr<FloatMVerbKernel> MVerbCreateFloatKernel(MVerbIsa isa);
+std::unique_ptr<MixedMVerbKernel> MVerbCreateMixedKernel(MVerbIsa isa);
+//numLanes is 4, 8 or 16, null for other counts. 8 lanes run in AVX2 registers and 16 lanes in
+//AVX-512 registers where the set has them, in narrower ones otherwise.
+std::unique_ptr<MVerbBatchKernel> MVerbCreateBatchKernel(MVerbIsa isa, int numLanes);
+
+#endif
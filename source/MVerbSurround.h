@@ -0,0 +1,763 @@
+//  Copyright (c) 2022 Arne Scheffler
+//  This code is distributed under the terms of the GNU General Public License
+
+//  MVerb is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  at your option) any later version.
+//
+//  MVerb is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this MVerb.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef MVERBSURROUND_H
+#define MVERBSURROUND_H
+
+#include "MVerb.h"
+
+//the tank layout of MVerbSurround. Its four lanes hold the halves of two figure of eight tanks,
+//lanes 0 and 3 are tank A and lanes 1 and 2 tank B, so reversing the lanes (LaneVector::Swap)
+//crosses the halves of each tank like left and right in MVerb. The output taps are the ones of
+//MVerbTopology, read per side.
+struct MVerbSurroundTopology
+{
+    enum { NUM_TANK_LANES = 4, NUM_TAP_GROUPS = 3 };
+    enum { NumLateTaps = std::extent<decltype(MVerbTopology::LateOutputTaps)>::value };
+
+    static constexpr int LaneTank[NUM_TANK_LANES] = {0, 1, 1, 0};
+    static constexpr int LaneSide[NUM_TANK_LANES] = {0, 0, 1, 1};
+    //tank B is shorter by a ratio far from any small fraction, its modes fall between those of A
+    static constexpr double TankScale[2] = {1., 0.887};
+    //every group of output taps reads the tank at its share of the tap times of MVerb plus an
+    //offset, which also moves the taps at the line input
+    static constexpr double TapGroupScale[NUM_TAP_GROUPS] = {1., 0.813, 0.641};
+    static constexpr double TapGroupOffset[NUM_TAP_GROUPS] = {0, 0.0031, 0.0053};
+
+    //a late output tap of MVerbTopology is either read by the half whose output it feeds (own)
+    //or by the other half of that tank, whose lanes are then swapped into place
+    static constexpr bool IsOwnTap(int i){
+        return MVerbTopology::LateOutputTaps[i].lanes[0] == 0;
+    }
+
+    static constexpr int NumLineTaps(int line){
+        int count = 0;
+        for(const auto& tap : MVerbTopology::LateOutputTaps)
+            count += tap.line == line;
+        return count;
+    }
+
+    //taps of every group on a tank line, after tap 0 at the line input
+    static constexpr int NumGroupedTaps(int line){
+        return 1 + NumLineTaps(line) * NUM_TAP_GROUPS;
+    }
+
+    //where late output tap i sits among the taps of its line in a group: first the own taps and
+    //then the other ones, each in table order
+    static constexpr int LineTapIndex(int i){
+        const int line = MVerbTopology::LateOutputTaps[i].line;
+        int index = 0;
+        for(int j=0;j<NumLateTaps;j++){
+            if(MVerbTopology::LateOutputTaps[j].line != line)
+                continue;
+            if(IsOwnTap(j) == IsOwnTap(i) ? j < i : IsOwnTap(j))
+                ++index;
+        }
+        return index;
+    }
+
+    //the tap time on line of a lane on side, see LineTapIndex. An own tap reads the time of its
+    //side in MVerbTopology, the other ones the time of the opposite side.
+    static constexpr double LineTapTime(int line, int side, int index){
+        for(int i=0;i<NumLateTaps;i++){
+            const auto& tap = MVerbTopology::LateOutputTaps[i];
+            if(tap.line != line || LineTapIndex(i) != index)
+                continue;
+            const int position = tap.taps[IsOwnTap(i) ? side : 1 - side];
+            return line == MVerbTopology::TANK_ALLPASS_0 || line == MVerbTopology::TANK_ALLPASS_1
+                   ? MVerbTopology::TankAllpassTaps[line / 2][side][position]
+                   : MVerbTopology::TankDelayLineTaps[line / 2][side][position];
+        }
+        return 0;
+    }
+
+    //tap 0 at the line input followed by the taps of every group
+    template<int Line>
+    static void GroupTaps(double (&taps)[NumGroupedTaps(Line)], int side){
+        taps[0] = 0;
+        for(int group=0;group<NUM_TAP_GROUPS;group++)
+            for(int i=0;i<NumLineTaps(Line);i++)
+                taps[1 + group * NumLineTaps(Line) + i] = LineTapTime(Line, side, i) * TapGroupScale[group] + TapGroupOffset[group];
+    }
+};
+
+//one reverb for all channels of a surround bed (5.1, 7.1, 7.1.4 or any layout of up to
+//MaxChannels speakers). The inputs are summed into a left and a right send, the bandwidth
+//filter, predelay and input diffusion then run once for all channels. The tank is widened to
+//two decorrelated figure of eight tanks in the lanes of one vector and every output channel
+//reads its own set of taps from it, see MVerbSurroundTopology. Only the output taps grow with
+//the channel count, each group of four channels costs about as much as the output stage of
+//MVerb.
+//
+//The parameters and the process() interface are the ones of MVerb, with inputs and outputs
+//holding one pointer per channel of the layout. Like MVerbBatch the engine computes in T where
+//MVerb<float> uses double.
+template<typename T, template<typename, int> class Lowpass = OversampledStateVariable>
+class MVerbSurround
+{
+public:
+    enum { MaxChannels = 16 };
+
+    //where a speaker sits in the layout, the centre feeds and gets fed by both sides and the
+    //LFE bypasses the reverb
+    enum Speaker
+        {
+            SPEAKER_LEFT=0,
+            SPEAKER_RIGHT,
+            SPEAKER_CENTER,
+            SPEAKER_LFE
+        };
+
+    //parameter indices are the ones of MVerb
+    enum
+        {
+            DAMPINGFREQ = MVerb<T>::DAMPINGFREQ,
+            DENSITY = MVerb<T>::DENSITY,
+            BANDWIDTHFREQ = MVerb<T>::BANDWIDTHFREQ,
+            DECAY = MVerb<T>::DECAY,
+            PREDELAY = MVerb<T>::PREDELAY,
+            SIZE = MVerb<T>::SIZE,
+            GAIN = MVerb<T>::GAIN,
+            MIX = MVerb<T>::MIX,
+            EARLYMIX = MVerb<T>::EARLYMIX,
+            NUM_PARAMS = MVerb<T>::NUM_PARAMS
+        };
+
+private:
+    typedef MVerbTopology Topology;
+    typedef MVerbSurroundTopology SurroundTopology;
+    using Stereo = LaneVector<T, 2>;
+    using Tank = LaneVector<T, SurroundTopology::NUM_TANK_LANES>;
+    enum { LEFT = 0, RIGHT };
+    enum { MaxBlockSize = DelayLineMaxBlock };
+    enum { NUM_LANES = SurroundTopology::NUM_TANK_LANES, NUM_TAP_GROUPS = SurroundTopology::NUM_TAP_GROUPS };
+    enum { NUM_DELAYLINES = 10 };
+
+    Lowpass<T,2> bandwidthFilter;
+    StaticDelayLineEightTap<T,NUM_LANES> earlyReflectionsDelayLine;
+    StaticDelayLine<T> predelay;
+    Allpass<T> allpass[4];
+    Allpass<T,NUM_LANES> tankAllpass0;
+    StaticDelayLineTaps<T,NUM_LANES,SurroundTopology::NumGroupedTaps(Topology::TANK_DELAYLINE_0)> tankDelayLine0;
+    Lowpass<T,NUM_LANES> damping;
+    StaticAllpassTaps<T,NUM_LANES,SurroundTopology::NumGroupedTaps(Topology::TANK_ALLPASS_1)> tankAllpass1;
+    StaticDelayLineTaps<T,NUM_LANES,SurroundTopology::NumGroupedTaps(Topology::TANK_DELAYLINE_1)> tankDelayLine1;
+
+    //the layout, see setLayout()
+    int NumChannels, NumTapGroups;
+    int Slot[MaxChannels];
+    T Send[MaxChannels][2];
+
+    T MixSmooth, EarlyLateSmooth, BandwidthSmooth, DampingSmooth, PredelaySmooth, SizeSmooth, DensitySmooth, DecaySmooth;
+    Tank PreviousTank;
+    T Density1, Density2, Gain, EarlyMix;
+    int ControlRate, ControlRateCounter;
+    bool MixSettled, DecaySettled;
+    int QuietSamples;
+    unsigned SilentChannels;
+    bool Sleeping;
+
+    alignas(CacheLineSize) T MixRamp[MaxBlockSize];
+    T DecayRamp[MaxBlockSize], Density2Ramp[MaxBlockSize];
+
+    T SampleRate;
+    T DampingFreq, BandwidthFreq, PreDelayTime, Decay, Mix, Size;
+    T TankSize;
+    T SleepThreshold;
+    int SleepSamples;
+    bool TankCleared;
+    bool UseHugePages;
+    DelayArena<T> arena;
+
+    static int maxLineLength(double time, T sampleRate){
+        return (int)(time * sampleRate) + 1;
+    }
+
+    static int maxLineLength(const double (&times)[2], T sampleRate){
+        return maxLineLength(std::max(times[0], times[1]), sampleRate);
+    }
+
+    static size_t paddedLength(int length, int numLanes){
+        const size_t samplesPerCacheLine = CacheLineSize / sizeof(T);
+        size_t capacity = DelayLineCapacity(length) * numLanes;
+        return (capacity + samplesPerCacheLine - 1) / samplesPerCacheLine * samplesPerCacheLine;
+    }
+
+    //in the arena order of MVerb, tank B is shorter than tank A
+    static void getMaxLineLengths(T sampleRate, int lengths[NUM_DELAYLINES], int lanes[NUM_DELAYLINES]){
+        lengths[0] = maxLineLength(Topology::EarlyReflectionsTimes, sampleRate);
+        lanes[0] = NUM_LANES;
+        lengths[1] = maxLineLength(Topology::MaxPredelayTime, sampleRate);
+        lanes[1] = 1;
+        for(int j=0;j<4;j++){
+            lengths[2+j] = maxLineLength(Topology::AllpassTimes[j], sampleRate);
+            lanes[2+j] = 1;
+        }
+        for(int j=0;j<2;j++){
+            lengths[6+2*j] = maxLineLength(Topology::TankAllpassTimes[j], sampleRate * Topology::MaxSize);
+            lengths[7+2*j] = maxLineLength(Topology::TankDelayLineTimes[j], sampleRate * Topology::MaxSize);
+            lanes[6+2*j] = lanes[7+2*j] = NUM_LANES;
+        }
+    }
+
+    static size_t getArenaSize(T sampleRate){
+        int lengths[NUM_DELAYLINES], lanes[NUM_DELAYLINES];
+        getMaxLineLengths(sampleRate, lengths, lanes);
+        size_t size = 0;
+        for(int j=0;j<NUM_DELAYLINES;j++)
+            size += paddedLength(lengths[j], lanes[j]);
+        return size;
+    }
+
+    void allocateDelayLines(){
+        int lengths[NUM_DELAYLINES], lanes[NUM_DELAYLINES];
+        getMaxLineLengths(SampleRate, lengths, lanes);
+        SleepSamples = 0;
+        for(int j=0;j<NUM_DELAYLINES;j++)
+            SleepSamples += lengths[j] * lanes[j];
+        arena.Allocate(getArenaSize(SampleRate), UseHugePages);
+        T* buffer = arena.GetData();
+        int line = 0;
+        auto assign = [&](auto& delayLine){
+            delayLine.SetBuffer(buffer, lengths[line]);
+            buffer += paddedLength(lengths[line], lanes[line]);
+            ++line;
+        };
+        assign(earlyReflectionsDelayLine);
+        assign(predelay);
+        for(int j=0;j<4;j++)
+            assign(allpass[j]);
+        assign(tankAllpass0);
+        assign(tankDelayLine0);
+        assign(tankAllpass1);
+        assign(tankDelayLine1);
+    }
+
+    void setTankLengths(T size){
+        double delayLineTaps[2][SurroundTopology::NumGroupedTaps(Topology::TANK_DELAYLINE_0)];
+        double allpassTaps[2][SurroundTopology::NumGroupedTaps(Topology::TANK_ALLPASS_1)];
+        double lastDelayLineTaps[2][SurroundTopology::NumGroupedTaps(Topology::TANK_DELAYLINE_1)];
+        for(int side=LEFT;side<=RIGHT;side++){
+            SurroundTopology::GroupTaps<Topology::TANK_DELAYLINE_0>(delayLineTaps[side], side);
+            SurroundTopology::GroupTaps<Topology::TANK_ALLPASS_1>(allpassTaps[side], side);
+            SurroundTopology::GroupTaps<Topology::TANK_DELAYLINE_1>(lastDelayLineTaps[side], side);
+        }
+        for(int lane=0;lane<NUM_LANES;lane++){
+            int side = SurroundTopology::LaneSide[lane];
+            T scale = size * T(SurroundTopology::TankScale[SurroundTopology::LaneTank[lane]]);
+            tankAllpass0.SetLength(lane, Topology::TankAllpassTimes[0][side] * SampleRate * scale);
+            tankDelayLine0.SetLength(lane, Topology::TankDelayLineTimes[0][side] * SampleRate * scale);
+            tankAllpass1.SetLength(lane, Topology::TankAllpassTimes[1][side] * SampleRate * scale);
+            tankDelayLine1.SetLength(lane, Topology::TankDelayLineTimes[1][side] * SampleRate * scale);
+            Topology::SetTaps(tankDelayLine0, lane, delayLineTaps[side], SampleRate, scale);
+            Topology::SetTaps(tankAllpass1, lane, allpassTaps[side], SampleRate, scale);
+            Topology::SetTaps(tankDelayLine1, lane, lastDelayLineTaps[side], SampleRate, scale);
+        }
+        TankSize = size;
+    }
+
+    //see MVerb::updateTankLengths
+    void updateTankLengths(T size){
+        tankAllpass0.EndFade();
+        tankDelayLine0.EndFade();
+        tankAllpass1.EndFade();
+        tankDelayLine1.EndFade();
+        if (size == TankSize)
+            return;
+        tankAllpass0.BeginFade(ControlRate);
+        tankDelayLine0.BeginFade(ControlRate);
+        tankAllpass1.BeginFade(ControlRate);
+        tankDelayLine1.BeginFade(ControlRate);
+        setTankLengths(size);
+    }
+
+    void settleSmoothers(){
+        SizeSmooth = Size;
+        MixSmooth = Mix;
+        EarlyLateSmooth = EarlyMix;
+        BandwidthSmooth = (BandwidthFreq * 18400.) + 100.;
+        DampingSmooth = (DampingFreq * 18400.) + 100.;
+        PredelaySmooth = PreDelayTime * 200 * (SampleRate / 1000);
+        DecaySmooth = (0.7995f * Decay) + 0.005;
+        DensitySmooth = (0.7995f * Density1) + 0.005;
+    }
+
+    static void ramp(T* values, T start, T delta, int position, int n){
+        for(int i=0;i<n;++i)
+            values[i] = start + T(position + i) * delta;
+    }
+
+    using EarlyTapSequence = std::make_index_sequence<std::extent<decltype(Topology::EarlyReflectionsOutputTaps)>::value>;
+    using LateTapSequence = std::make_index_sequence<SurroundTopology::NumLateTaps>;
+
+    //see MVerb::earlyReflectionsTaps
+    template<size_t... I>
+    Tank earlyReflectionsTaps(const Tank& line, const Tank& direct, int age, std::index_sequence<I...>) const{
+        Tank sum = line;
+        ((sum = sum + earlyReflectionsDelayLine.GetIndex(Topology::EarlyReflectionsOutputTaps[I].tap, age)
+                      * T(Topology::EarlyReflectionsOutputTaps[I].gain)), ...);
+        return sum + direct;
+    }
+
+    //the tank line Topology::TANK_ALLPASS_0 and so on
+    template<int Line>
+    const auto& tankLine() const{
+        if constexpr (Line == Topology::TANK_ALLPASS_0)
+            return tankAllpass0;
+        else if constexpr (Line == Topology::TANK_DELAYLINE_0)
+            return tankDelayLine0;
+        else if constexpr (Line == Topology::TANK_ALLPASS_1)
+            return tankAllpass1;
+        else
+            return tankDelayLine1;
+    }
+
+    //late output tap I of a group, see MVerbSurroundTopology::LineTapIndex
+    template<size_t I>
+    Tank lateTap(int group, int age) const{
+        constexpr auto tap = Topology::LateOutputTaps[I];
+        constexpr int index = SurroundTopology::LineTapIndex(I);
+        return tankLine<tap.line>().GetIndex(1 + group * SurroundTopology::NumLineTaps(tap.line) + index, age) * T(tap.gain);
+    }
+
+    //the own or the other late output taps of a group, summed in table order
+    template<bool Own, size_t... I>
+    Tank lateTaps(int group, int age, std::index_sequence<I...>) const{
+        Tank sum(T(0));
+        ((SurroundTopology::IsOwnTap(I) == Own ? void(sum = sum + lateTap<I>(group, age)) : void()), ...);
+        return sum;
+    }
+
+    //see setLayout
+    bool assignLayout(const int* speakers, int numChannels){
+        if (numChannels < 1 || numChannels > MaxChannels)
+            return false;
+        int sideCount[2] = {0, 0};
+        for(int channel=0;channel<numChannels;channel++)
+            if (speakers[channel] == SPEAKER_LEFT || speakers[channel] == SPEAKER_RIGHT)
+                ++sideCount[speakers[channel] == SPEAKER_LEFT ? LEFT : RIGHT];
+        //uncorrelated inputs keep their level in the sends
+        const T gain = 1 / std::sqrt(T(std::max({sideCount[LEFT], sideCount[RIGHT], 1})));
+
+        int slot[MaxChannels];
+        T send[MaxChannels][2];
+        int used[2] = {0, 0};
+        auto assign = [&](int channel, int side){
+            int group = used[side] / 2;
+            int lane = used[side] % 2;
+            slot[channel] = group * NUM_LANES + (side == LEFT ? lane : NUM_LANES - 1 - lane);
+            ++used[side];
+        };
+        for(int channel=0;channel<numChannels;channel++){
+            slot[channel] = -1;
+            send[channel][LEFT] = send[channel][RIGHT] = 0;
+            if (speakers[channel] == SPEAKER_LEFT || speakers[channel] == SPEAKER_RIGHT){
+                int side = speakers[channel] == SPEAKER_LEFT ? LEFT : RIGHT;
+                send[channel][side] = gain;
+                assign(channel, side);
+            }
+        }
+        for(int channel=0;channel<numChannels;channel++){
+            if (speakers[channel] == SPEAKER_CENTER){
+                send[channel][LEFT] = send[channel][RIGHT] = gain * T(0.70710678118654752);
+                assign(channel, used[LEFT] <= used[RIGHT] ? LEFT : RIGHT);
+            }
+        }
+        if (std::max(used[LEFT], used[RIGHT]) > 2 * NUM_TAP_GROUPS)
+            return false;
+        NumChannels = numChannels;
+        NumTapGroups = std::max((std::max(used[LEFT], used[RIGHT]) + 1) / 2, 1);
+        for(int channel=0;channel<numChannels;channel++){
+            Slot[channel] = slot[channel];
+            Send[channel][LEFT] = send[channel][LEFT];
+            Send[channel][RIGHT] = send[channel][RIGHT];
+        }
+        return true;
+    }
+
+    unsigned allChannels() const{
+        return (1u << NumChannels) - 1;
+    }
+
+    void sleep(){
+        reset();
+        settleSmoothers();
+        Sleeping = true;
+    }
+
+    bool wake(T **inputs, int sampleFrames){
+        int loud = 0;
+        for(int channel=0;channel<NumChannels;channel++)
+            for(int i=0;i<sampleFrames;i++)
+                loud |= std::abs(inputs[channel][i]) >= SleepThreshold;
+        if (!loud)
+            return false;
+        Sleeping = false;
+        ControlRateCounter = ControlRate;
+        return true;
+    }
+
+    //see MVerb::processDry
+    void processDry(T **inputs, T **outputs, int sampleFrames){
+        settleSmoothers();
+        SilentChannels = 0;
+        for(int channel=0;channel<NumChannels;channel++){
+            int signal = 0;
+            for(int i=0;i<sampleFrames;i++)
+                signal |= inputs[channel][i] != 0;
+            if (!signal){
+                std::fill(outputs[channel], outputs[channel] + sampleFrames, T(0));
+                SilentChannels |= 1u << channel;
+                continue;
+            }
+            T silenceCheckSum = 0;
+            for(int i=0;i<sampleFrames;i++){
+                T dry = inputs[channel][i];
+                T output = dry + ( 0 - dry ) * Mix;
+                silenceCheckSum += std::abs(output);
+                outputs[channel][i] = output * Gain;
+            }
+            if (silenceCheckSum <= 1e-7)
+                SilentChannels |= 1u << channel;
+        }
+    }
+
+public:
+    static constexpr T DefaultSleepThreshold = MVerb<T>::DefaultSleepThreshold;
+
+    MVerbSurround(){
+        DampingFreq = 0.9;
+        BandwidthFreq = 0.9;
+        SampleRate = 44100.;
+        Decay = 0.5;
+        Density1 = 0.5;
+        Density2 = 0.5;
+        Gain = 1.;
+        Mix = 1.;
+        Size = 1.;
+        EarlyMix = 1.;
+        PreDelayTime = 100 * (SampleRate / 1000);
+        MixSmooth = EarlyLateSmooth = BandwidthSmooth = DampingSmooth = PredelaySmooth = SizeSmooth = DecaySmooth = DensitySmooth = 0.;
+        ControlRate = SampleRate / 1000;
+        ControlRateCounter = 0;
+        SleepThreshold = DefaultSleepThreshold;
+        UseHugePages = false;
+        const int layout[] = {SPEAKER_LEFT, SPEAKER_RIGHT, SPEAKER_CENTER, SPEAKER_LFE, SPEAKER_LEFT, SPEAKER_RIGHT};
+        assignLayout(layout, 6);
+        allocateDelayLines();
+        reset();
+    }
+
+    //assigns the channels, speakers[channel] is one of Speaker. Every side gets the groups of
+    //taps in turn, first tank A and then tank B of a group, so the front pair hears the taps of
+    //MVerb and the surround pair the other tank. Centre channels are placed after the sides.
+    //Returns false if the layout has more than MaxChannels channels or more than
+    //2 * NUM_TAP_GROUPS speakers on one side, the engine keeps its layout then. Does not
+    //allocate, the state is cleared.
+    bool setLayout(const int* speakers, int numChannels){
+        if (!assignLayout(speakers, numChannels))
+            return false;
+        reset();
+        return true;
+    }
+
+    int getNumChannels() const{
+        return NumChannels;
+    }
+
+    //see MVerb::process
+    bool process(T **inputs, T **outputs, int sampleFrames){
+        if (Sleeping && !wake(inputs, sampleFrames)){
+            processDry(inputs, outputs, sampleFrames);
+            return SilentChannels == allChannels();
+        }
+        T silenceCheckSum[MaxChannels] = {};
+        T OneOverSampleFrames = 1. / sampleFrames;
+        T MixDelta	= (Mix - MixSmooth) * OneOverSampleFrames;
+        T BandwidthDelta = (((BandwidthFreq * 18400.) + 100.) - BandwidthSmooth) * OneOverSampleFrames;
+        T DampingDelta = (((DampingFreq * 18400.) + 100.) - DampingSmooth) * OneOverSampleFrames;
+        T PredelayDelta = ((PreDelayTime * 200 * (SampleRate / 1000)) - PredelaySmooth) * OneOverSampleFrames;
+        T SizeDelta	= (Size - SizeSmooth) * OneOverSampleFrames;
+        T DecayDelta = (((0.7995f * Decay) + 0.005) - DecaySmooth) * OneOverSampleFrames;
+        TankCleared = false;
+        for(int offset=0;offset<sampleFrames;){
+            bool updateFilters = ControlRateCounter >= ControlRate;
+            if (updateFilters){
+                ControlRateCounter = 0;
+                updateTankLengths(SizeSmooth + T(offset + 1) * SizeDelta);
+                bandwidthFilter.Frequency(BandwidthSmooth + T(offset + 1) * BandwidthDelta);
+                damping.Frequency(DampingSmooth + T(offset + 1) * DampingDelta);
+            }
+            int n = std::min(sampleFrames - offset, (int)MaxBlockSize);
+            n = std::min(n, std::max(ControlRate - ControlRateCounter, 1));
+            n = std::min(n, tankDelayLine1.GetMinLength());
+            ControlRateCounter += n;
+
+            if (MixDelta != 0 || !MixSettled){
+                ramp(MixRamp, MixSmooth, MixDelta, offset + 1, MixDelta != 0 ? n : MaxBlockSize);
+                MixSettled = MixDelta == 0;
+            }
+            if (DecayDelta != 0 || !DecaySettled){
+                int count = DecayDelta != 0 ? n : MaxBlockSize;
+                ramp(DecayRamp, DecaySmooth, DecayDelta, offset + 1, count);
+                for(int i=0;i<count;++i)
+                    Density2Ramp[i] = std::min(std::max(T(DecayRamp[i] + 0.15), T(0.25)), T(0.5));
+                DecaySettled = DecayDelta == 0;
+            }
+            Density2 = Density2Ramp[n-1];
+            tankAllpass0.SetFeedback(Density1);
+
+            //all channels summed into the two sides
+            T send[2][MaxBlockSize];
+            std::fill(send[LEFT], send[LEFT] + n, T(0));
+            std::fill(send[RIGHT], send[RIGHT] + n, T(0));
+            T peak = 0;
+            for(int channel=0;channel<NumChannels;channel++){
+                const T* input = inputs[channel] + offset;
+                for(int i=0;i<n;++i)
+                    peak = std::max(peak, std::abs(input[i]));
+                for(int side=LEFT;side<=RIGHT;side++){
+                    const T gain = Send[channel][side];
+                    if (gain != 0)
+                        for(int i=0;i<n;++i)
+                            send[side][i] += input[i] * gain;
+                }
+            }
+            Stereo bandwidth[MaxBlockSize];
+            for(int i=0;i<n;++i)
+                bandwidth[i] = bandwidthFilter(Stereo(send[LEFT][i], send[RIGHT][i]));
+
+            //each lane of the early reflections is fed by the side of its tank half
+            Tank sides[MaxBlockSize], earlyReflections[MaxBlockSize];
+            for(int i=0;i<n;++i){
+                alignas(CacheLineSize) T values[NUM_LANES];
+                for(int lane=0;lane<NUM_LANES;lane++)
+                    values[lane] = bandwidth[i].Get(SurroundTopology::LaneSide[lane]);
+                sides[i] = Tank::Load(values);
+                earlyReflections[i] = earlyReflectionsDelayLine(sides[i] * T(0.5) + sides[i].Swap() * T(0.3));
+            }
+            for(int i=0, age=n-1;i<n;++i, --age)
+                earlyReflections[i] = earlyReflectionsTaps(earlyReflections[i], ( sides[i] * T(0.4) + sides[i].Swap() * T(0.2) ) * T(0.5), age,
+                                                           EarlyTapSequence());
+
+            T smearedInput[MaxBlockSize];
+            if (PredelayDelta != 0){
+                for(int i=0;i<n;++i){
+                    predelay.SetLength(PredelaySmooth + T(offset + 1 + i) * PredelayDelta);
+                    smearedInput[i] = predelay(( bandwidth[i].Get(RIGHT) + bandwidth[i].Get(LEFT) ) * T(0.5f));
+                }
+            }else{
+                predelay.SetLength(PredelaySmooth);
+                for(int i=0;i<n;++i)
+                    smearedInput[i] = predelay(( bandwidth[i].Get(RIGHT) + bandwidth[i].Get(LEFT) ) * T(0.5f));
+            }
+            for(int j=0;j<4;j++)
+                allpass[j].Process(smearedInput, smearedInput, n);
+
+            //both tanks at once, see MVerb::process
+            Tank tank[MaxBlockSize], tankOutput[MaxBlockSize];
+            tankDelayLine1.ReadAhead(tankOutput, n);
+            Tank previous = PreviousTank;
+            for(int i=0;i<n;++i){
+                tank[i] = Tank(smearedInput[i]) + previous.Swap();
+                previous = tankOutput[i] * DecayRamp[i];
+            }
+            PreviousTank = previous;
+            tankAllpass0.Process(tank, tank, n);
+            tankDelayLine0.Process(tank, tank, n);
+            damping.Process(tank, tank, n);
+            if (DecayDelta != 0){
+                for(int i=0;i<n;++i){
+                    tankAllpass1.SetFeedback(Density2Ramp[i]);
+                    tank[i] = tankAllpass1(tank[i]);
+                }
+            }else{
+                tankAllpass1.SetFeedback(Density2);
+                tankAllpass1.Process(tank, tank, n);
+            }
+            Tank tankPeak(T(0));
+            for(int i=0;i<n;++i)
+                tankPeak = Tank::Max(tankPeak, Tank::Max(tank[i], -tank[i]));
+            tankDelayLine1.Write(tank, n);
+            for(int lane=0;lane<NUM_LANES;lane++)
+                peak = std::max(peak, tankPeak.Get(lane));
+            if (peak < SleepThreshold)
+                QuietSamples += n;
+            else
+                QuietSamples = 0;
+
+            //a group of taps gives four outputs, one per lane. Each reads its own taps of the late
+            //output of MVerb and gets the other ones from the half on the other side of its tank.
+            const T lateMix = 1 - EarlyMix;
+            alignas(CacheLineSize) T late[NUM_TAP_GROUPS][MaxBlockSize][NUM_LANES];
+            for(int group=0;group<NumTapGroups;group++){
+                for(int i=0, age=n-1;i<n;++i, --age){
+                    Tank accumulator = lateTaps<false>(group, age, LateTapSequence()).Swap()
+                                     + lateTaps<true>(group, age, LateTapSequence());
+                    (accumulator * EarlyMix + earlyReflections[i] * lateMix).Store(late[group][i]);
+                }
+            }
+            for(int channel=0;channel<NumChannels;channel++){
+                const T* input = inputs[channel] + offset;
+                T* output = outputs[channel] + offset;
+                const int slot = Slot[channel];
+                T sum = 0;
+                for(int i=0;i<n;++i){
+                    T dry = input[i];
+                    T wet = slot < 0 ? T(0) : late[slot / NUM_LANES][i][slot % NUM_LANES];
+                    T out = dry + ( wet - dry ) * MixRamp[i];
+                    sum += std::abs(out);
+                    output[i] = out * Gain;
+                }
+                silenceCheckSum[channel] += sum;
+            }
+            offset += n;
+        }
+        settleSmoothers();
+        SilentChannels = 0;
+        for(int channel=0;channel<NumChannels;channel++)
+            if (silenceCheckSum[channel] <= 1e-7)
+                SilentChannels |= 1u << channel;
+        if (QuietSamples >= SleepSamples)
+            sleep();
+        return SilentChannels == allChannels();
+    }
+
+    //bit n is set if channel n of the last process call was silent
+    unsigned getSilentChannels() const{
+        return SilentChannels;
+    }
+
+    bool isSleeping() const{
+        return Sleeping;
+    }
+
+    void setSleepThreshold(T threshold){
+        SleepThreshold = threshold;
+    }
+
+    //the tail of tank A, tank B is shorter
+    int getTailSamples() const{
+        T size = std::max({Size, SizeSmooth, TankSize});
+        return std::ceil(MVerb<T>::getTailTime(Decay, (size - T(0.05)) / T(0.95), PreDelayTime, Gain) * SampleRate);
+    }
+
+    void reset(){
+        ControlRateCounter = 0;
+        QuietSamples = 0;
+        MixSettled = DecaySettled = false;
+        SilentChannels = allChannels();
+        Sleeping = false;
+        PreviousTank = Tank(T(0));
+        bandwidthFilter.SetSampleRate(SampleRate);
+        bandwidthFilter.Reset();
+        damping.SetSampleRate(SampleRate);
+        damping.Reset();
+        predelay.Clear();
+        predelay.SetLength(PreDelayTime);
+        for(int j=0;j<4;j++){
+            allpass[j].Clear();
+            allpass[j].SetLength(Topology::AllpassTimes[j] * SampleRate);
+            allpass[j].SetFeedback(Topology::AllpassFeedback[j]);
+        }
+        tankAllpass0.Clear();
+        tankDelayLine0.Clear();
+        tankAllpass1.Clear();
+        tankDelayLine1.Clear();
+        SizeSmooth = Size;
+        setTankLengths(Size);
+        TankCleared = true;
+        tankAllpass0.SetFeedback(Density1);
+        tankAllpass1.SetFeedback(Density2);
+        earlyReflectionsDelayLine.Clear();
+        for(int lane=0;lane<NUM_LANES;lane++){
+            int side = SurroundTopology::LaneSide[lane];
+            T scale = SurroundTopology::TankScale[SurroundTopology::LaneTank[lane]];
+            earlyReflectionsDelayLine.SetLength(lane, Topology::EarlyReflectionsTimes[side] * SampleRate * scale);
+            Topology::SetTaps(earlyReflectionsDelayLine, lane, Topology::EarlyReflectionsTaps[side], SampleRate, scale);
+        }
+    }
+
+    void setParameter(int index, T value){
+        switch(index){
+            case DAMPINGFREQ:
+                    DampingFreq =  1. - value;
+                    break;
+            case DENSITY:
+                    Density1 = value;
+                    break;
+            case BANDWIDTHFREQ:
+                    BandwidthFreq = value;
+                    break;
+            case PREDELAY:
+                    PreDelayTime = value;
+                    break;
+            case SIZE:
+                    Size = (0.95 * value) + 0.05;
+                    if (TankCleared){
+                        SizeSmooth = Size;
+                        setTankLengths(Size);
+                    }
+                    break;
+            case DECAY:
+                    Decay = value;
+                    break;
+            case GAIN:
+                    Gain = value;
+                    break;
+            case MIX:
+                    Mix = value;
+                    break;
+            case EARLYMIX:
+                    EarlyMix = value;
+                    break;
+        }
+    }
+
+    //reallocates the delay lines for the new rate, not realtime safe
+    void setSampleRate(T sr){
+        SampleRate = sr;
+        ControlRate = SampleRate / 1000;
+        allocateDelayLines();
+        reset();
+    }
+
+    //see MVerb::setUseHugePages
+    void setUseHugePages(bool state){
+        UseHugePages = state;
+    }
+
+    bool usesHugePages() const{
+        return arena.UsesHugePages();
+    }
+
+    //see MVerb::getSubnormalCount
+    unsigned long getSubnormalCount() const{
+        unsigned long count = earlyReflectionsDelayLine.GetSubnormals() + predelay.GetSubnormals();
+        for(int j=0;j<4;j++)
+            count += allpass[j].GetSubnormals();
+        count += tankAllpass0.GetSubnormals() + tankDelayLine0.GetSubnormals();
+        count += tankAllpass1.GetSubnormals() + tankDelayLine1.GetSubnormals();
+        return count;
+    }
+
+    //bytes needed by one instance running at sampleRate, delay lines included
+    static size_t getMemorySize(T sampleRate){
+        return sizeof(MVerbSurround) + getArenaSize(sampleRate) * sizeof(T);
+    }
+};
+
+#endif
@@ -0,0 +1,924 @@
+//  Copyright (c) 2022 Arne Scheffler
+//  This code is distributed under the terms of the GNU General Public License
+
+//  MVerb is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  at your option) any later version.
+//
+//  MVerb is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this MVerb.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "DenormalGuard.h"
+#include "MVerb.h"
+#include "MVerbBatch.h"
+#include "MVerbDispatch.h"
+#include "MVerbSurround.h"
+#include "perfcounters.h"
+#include "results.h"
+#include "stageprobe.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace mverb {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int kNumStages = MVerb<float>::NUM_STAGES;
+const char* stageNames[kNumStages] = {"control",   "bandwidth", "early_reflections",
+                                      "diffusion", "tank",      "output"};
+
+//------------------------------------------------------------------------
+enum class Pattern
+{
+	Static,
+	Ramp,
+	SizeJumps,
+};
+
+//------------------------------------------------------------------------
+const char* getName (Pattern pattern)
+{
+	switch (pattern)
+	{
+		case Pattern::Static: return "static";
+		case Pattern::Ramp: return "ramp";
+		case Pattern::SizeJumps: return "size";
+	}
+	return "";
+}
+
+//------------------------------------------------------------------------
+struct Options
+{
+	std::vector<std::string> types {"float", "double"};
+	std::vector<double> sampleRates {44100., 48000., 96000., 192000.};
+	std::vector<int> blockSizes {1, 8, 32, 64, 256, 1024, 4096};
+	std::vector<Pattern> patterns {Pattern::Static, Pattern::Ramp, Pattern::SizeJumps};
+	double seconds {1.};
+	int repetitions {3};
+	bool stages {true};
+	bool lifecycle {true};
+	bool perf {false};
+	bool hugePages {false};
+	bool keepDenormals {false};
+	std::string savePath;
+	std::string baselinePath;
+	double tolerance {5.};
+};
+
+//------------------------------------------------------------------------
+struct Environment
+{
+	double ticksPerNanosecond {1.};
+	double markOverhead {0.};
+	PerfCounters counters;
+};
+
+//------------------------------------------------------------------------
+/** MVerbBatch with all lanes in use behind the interface of MVerb. Every lane processes the
+ *  same input with the same parameters, the results are per lane-sample. With Dispatch the
+ *  batch comes from mverb-dispatch for the instruction set MVerbSelectIsa picks. */
+template<int N, bool Dispatch = false>
+class BatchVerb
+{
+public:
+	using Batch = MVerbBatch<float, N>;
+	using Engine = std::conditional_t<Dispatch, MVerbBatchKernel, Batch>;
+	enum
+	{
+		DAMPINGFREQ = Batch::DAMPINGFREQ,
+		DENSITY = Batch::DENSITY,
+		BANDWIDTHFREQ = Batch::BANDWIDTHFREQ,
+		DECAY = Batch::DECAY,
+		PREDELAY = Batch::PREDELAY,
+		SIZE = Batch::SIZE,
+		GAIN = Batch::GAIN,
+		MIX = Batch::MIX,
+		EARLYMIX = Batch::EARLYMIX,
+		NUM_PARAMS = Batch::NUM_PARAMS
+	};
+	static constexpr int kNumInstances = N;
+
+	BatchVerb ()
+	{
+		if constexpr (Dispatch)
+			batch = MVerbCreateBatchKernel (MVerbSelectIsa (), N);
+		else
+			batch = std::make_unique<Batch> ();
+		while (batch->addLane () >= 0)
+			;
+	}
+
+	void setUseHugePages (bool) {}
+
+	void setParameter (int index, float value)
+	{
+		for (auto lane = 0; lane < N; ++lane)
+			batch->setParameter (lane, index, value);
+	}
+
+	void setSampleRate (float sampleRate) { batch->setSampleRate (sampleRate); }
+
+	void process (float** inputs, float** outputs, int sampleFrames)
+	{
+		if (static_cast<int> (laneOutputs[0].size ()) < sampleFrames)
+		{
+			for (auto& output : laneOutputs)
+				output.resize (sampleFrames);
+		}
+		for (auto lane = 0; lane < N; ++lane)
+		{
+			laneInputs[lane] = inputs;
+			outputPointers[lane][0] = lane == 0 ? outputs[0] : laneOutputs[lane * 2].data ();
+			outputPointers[lane][1] = lane == 0 ? outputs[1] : laneOutputs[lane * 2 + 1].data ();
+			laneOutputPointers[lane] = outputPointers[lane];
+		}
+		batch->process (laneInputs, laneOutputPointers, sampleFrames);
+	}
+
+	static size_t getMemorySize (float sampleRate) { return Batch::getMemorySize (sampleRate) / N; }
+
+private:
+	std::unique_ptr<Engine> batch;
+	std::vector<float> laneOutputs[N * 2];
+	float** laneInputs[N];
+	float* outputPointers[N][2];
+	float** laneOutputPointers[N];
+};
+
+//------------------------------------------------------------------------
+/** MVerbSurround on a 5.1, 7.1 or 7.1.4 bed with the stereo input on every pair of channels.
+ *  The results are per stereo pair, what the same bed costs with chained stereo instances. */
+template<int NumChannels>
+class SurroundVerb
+{
+public:
+	using Surround = MVerbSurround<float>;
+	enum
+	{
+		DAMPINGFREQ = Surround::DAMPINGFREQ,
+		DENSITY = Surround::DENSITY,
+		BANDWIDTHFREQ = Surround::BANDWIDTHFREQ,
+		DECAY = Surround::DECAY,
+		PREDELAY = Surround::PREDELAY,
+		SIZE = Surround::SIZE,
+		GAIN = Surround::GAIN,
+		MIX = Surround::MIX,
+		EARLYMIX = Surround::EARLYMIX,
+		NUM_PARAMS = Surround::NUM_PARAMS
+	};
+	static constexpr int kNumInstances = NumChannels / 2;
+
+	SurroundVerb ()
+	{
+		// L R C LFE Ls Rs, then side and top pairs
+		const int speakers[12] = {Surround::SPEAKER_LEFT,  Surround::SPEAKER_RIGHT,
+		                          Surround::SPEAKER_CENTER, Surround::SPEAKER_LFE,
+		                          Surround::SPEAKER_LEFT,  Surround::SPEAKER_RIGHT,
+		                          Surround::SPEAKER_LEFT,  Surround::SPEAKER_RIGHT,
+		                          Surround::SPEAKER_LEFT,  Surround::SPEAKER_RIGHT,
+		                          Surround::SPEAKER_LEFT,  Surround::SPEAKER_RIGHT};
+		surround.setLayout (speakers, NumChannels);
+	}
+
+	void setUseHugePages (bool state) { surround.setUseHugePages (state); }
+	void setParameter (int index, float value) { surround.setParameter (index, value); }
+	void setSampleRate (float sampleRate) { surround.setSampleRate (sampleRate); }
+
+	void process (float** inputs, float** outputs, int sampleFrames)
+	{
+		if (static_cast<int> (channelOutputs[0].size ()) < sampleFrames)
+		{
+			for (auto& output : channelOutputs)
+				output.resize (sampleFrames);
+		}
+		for (auto channel = 0; channel < NumChannels; ++channel)
+		{
+			inputPointers[channel] = inputs[channel % 2];
+			outputPointers[channel] = channel < 2 ? outputs[channel] : channelOutputs[channel].data ();
+		}
+		surround.process (inputPointers, outputPointers, sampleFrames);
+	}
+
+	static size_t getMemorySize (float sampleRate)
+	{
+		return Surround::getMemorySize (sampleRate) / kNumInstances;
+	}
+
+private:
+	Surround surround;
+	std::vector<float> channelOutputs[NumChannels];
+	float* inputPointers[NumChannels];
+	float* outputPointers[NumChannels];
+};
+
+//------------------------------------------------------------------------
+/** MVerb with the tank and the early reflections at the reduced rate of
+ *  MVerb::getDefaultRateDivider (the plug-in built with MVERB_REDUCED_RATE). Below 88.2 kHz it
+ *  is the plain engine. */
+template<typename T, typename Probe = MVerbNullProbe>
+class ReducedRateVerb : public MVerb<T, Probe>
+{
+public:
+	using Base = MVerb<T, Probe>;
+
+	void setSampleRate (T sampleRate)
+	{
+		Base::setSampleRate (sampleRate, Base::getDefaultRateDivider (sampleRate), true);
+	}
+
+	static size_t getMemorySize (T sampleRate)
+	{
+		return Base::getMemorySize (sampleRate, Base::getDefaultRateDivider (sampleRate), true);
+	}
+};
+
+//------------------------------------------------------------------------
+/** The engine the plug-in runs for 64 bit processing: double buffers, float delay lines and
+ *  arithmetic, the filter integrators in double. */
+template<typename Probe = MVerbNullProbe>
+using MixedVerb = MVerb<float, Probe, WideStateVariable>;
+
+//------------------------------------------------------------------------
+/** The float engine with 16 bit delay lines (see DelayStorage.h). */
+template<typename Probe = MVerbNullProbe>
+using HalfVerb = MVerb<float, Probe, OversampledStateVariable, HalfSample>;
+
+//------------------------------------------------------------------------
+/** The float engine with the TptLowpass filters instead of the oversampled state variable ones. */
+template<typename Probe = MVerbNullProbe>
+using TptVerb = MVerb<float, Probe, TptLowpass>;
+
+//------------------------------------------------------------------------
+/** The float engine built for the instruction set MVerbSelectIsa picks, see MVerbDispatch.h.
+ *  The environment variable MVERB_ISA forces a lower one. */
+class DispatchVerb
+{
+public:
+	using Base = MVerb<float>;
+	static constexpr int NUM_PARAMS = Base::NUM_PARAMS;
+	static constexpr int DAMPINGFREQ = Base::DAMPINGFREQ;
+	static constexpr int DENSITY = Base::DENSITY;
+	static constexpr int BANDWIDTHFREQ = Base::BANDWIDTHFREQ;
+	static constexpr int DECAY = Base::DECAY;
+	static constexpr int PREDELAY = Base::PREDELAY;
+	static constexpr int SIZE = Base::SIZE;
+	static constexpr int MIX = Base::MIX;
+	static constexpr int EARLYMIX = Base::EARLYMIX;
+
+	DispatchVerb () : kernel (MVerbCreateFloatKernel (MVerbSelectIsa ())) {}
+
+	void setUseHugePages (bool state) { kernel->setUseHugePages (state); }
+	void setParameter (int index, float value) { kernel->setParameter (index, value); }
+	void setSampleRate (float sampleRate) { kernel->setSampleRate (sampleRate); }
+	bool process (float** inputs, float** outputs, int numSamples)
+	{
+		return kernel->process (inputs, outputs, numSamples);
+	}
+
+	static size_t getMemorySize (float sampleRate) { return Base::getMemorySize (sampleRate); }
+
+private:
+	std::unique_ptr<FloatMVerbKernel> kernel;
+};
+
+//------------------------------------------------------------------------
+template<typename Verb>
+struct NumInstances : std::integral_constant<int, 1>
+{
+};
+
+template<int N, bool Dispatch>
+struct NumInstances<BatchVerb<N, Dispatch>> : std::integral_constant<int, N>
+{
+};
+
+template<int N>
+struct NumInstances<SurroundVerb<N>> : std::integral_constant<int, N / 2>
+{
+};
+
+// same defaults as the plug-in processor
+const double defaultParameters[MVerb<float>::NUM_PARAMS] = {0., 0.5, 1., 0.5, 0., 0.5, 1., 0.15, 0.75};
+
+//------------------------------------------------------------------------
+template<typename T, typename Verb>
+class Runner
+{
+public:
+	Runner (double sampleRate, int blockSize, Pattern pattern, bool hugePages)
+	: sampleRate (sampleRate), blockSize (blockSize), pattern (pattern), verb (std::make_unique<Verb> ())
+	{
+		verb->setUseHugePages (hugePages);
+		for (auto index = 0; index < Verb::NUM_PARAMS; ++index)
+			verb->setParameter (index, static_cast<T> (defaultParameters[index]));
+		verb->setSampleRate (static_cast<T> (sampleRate));
+
+		// one second of deterministic white noise, looped
+		noise.resize (static_cast<size_t> (sampleRate) * 2);
+		uint32_t seed = 0x12345678;
+		for (auto& sample : noise)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			sample = static_cast<T> (static_cast<int32_t> (seed) * (0.25 / 2147483648.));
+		}
+		for (auto channel = 0; channel < 2; ++channel)
+		{
+			inputs[channel].resize (blockSize);
+			outputs[channel].resize (blockSize);
+			inputPointers[channel] = inputs[channel].data ();
+			outputPointers[channel] = outputs[channel].data ();
+		}
+	}
+
+	void run (size_t numFrames)
+	{
+		for (size_t done = 0; done < numFrames; done += blockSize)
+		{
+			automate ();
+			auto noiseFrames = noise.size () / 2;
+			for (auto i = 0; i < blockSize; ++i)
+			{
+				auto index = ((position + i) % noiseFrames) * 2;
+				inputs[0][i] = noise[index];
+				inputs[1][i] = noise[index + 1];
+			}
+			verb->process (inputPointers, outputPointers, blockSize);
+			position += blockSize;
+		}
+	}
+
+	Verb& getVerb () { return *verb; }
+
+private:
+	void automate ()
+	{
+		switch (pattern)
+		{
+			case Pattern::Static: break;
+			case Pattern::Ramp:
+			{
+				// everything except SIZE follows a slow sine, set before every block like a host would
+				auto phase = static_cast<double> (position) / (2. * sampleRate);
+				auto value = static_cast<T> (0.5 + 0.4 * std::sin (2. * 3.14159265358979 * phase));
+				verb->setParameter (Verb::DAMPINGFREQ, value);
+				verb->setParameter (Verb::DENSITY, value);
+				verb->setParameter (Verb::BANDWIDTHFREQ, 1 - value * 0.5);
+				verb->setParameter (Verb::DECAY, value);
+				verb->setParameter (Verb::PREDELAY, value * 0.5);
+				verb->setParameter (Verb::MIX, value);
+				verb->setParameter (Verb::EARLYMIX, 1 - value);
+				break;
+			}
+			case Pattern::SizeJumps:
+			{
+				// SIZE jumps every 100ms
+				auto period = static_cast<size_t> (sampleRate / 10.);
+				auto segment = position / period;
+				if (segment != lastSegment)
+				{
+					lastSegment = segment;
+					verb->setParameter (Verb::SIZE, static_cast<T> (segment & 1 ? 0.75 : 0.25));
+				}
+				break;
+			}
+		}
+	}
+
+	double sampleRate;
+	int blockSize;
+	Pattern pattern;
+	std::unique_ptr<Verb> verb;
+	std::vector<T> noise;
+	std::vector<T> inputs[2];
+	std::vector<T> outputs[2];
+	T* inputPointers[2];
+	T* outputPointers[2];
+	size_t position {0};
+	size_t lastSegment {std::numeric_limits<size_t>::max ()};
+};
+
+//------------------------------------------------------------------------
+template<typename T, typename Verb = MVerb<T>>
+BenchResult measure (const std::string& type, double sampleRate, int blockSize, Pattern pattern,
+                     const Options& options, Environment& env)
+{
+	BenchResult result;
+	std::ostringstream name;
+	name << type << "/" << static_cast<int> (sampleRate) << "/" << blockSize << "/" << getName (pattern);
+	result.name = name.str ();
+
+	auto numFrames = static_cast<size_t> (options.seconds * sampleRate);
+	numFrames = std::max<size_t> (numFrames / blockSize, 1) * blockSize;
+	auto warmupFrames = static_cast<size_t> (0.2 * sampleRate);
+	// a batch processes numFrames for each of its reverbs
+	auto numSamples = static_cast<double> (numFrames) * NumInstances<Verb>::value;
+
+	// whole engine, uninstrumented: best of N
+	{
+		Runner<T, Verb> runner (sampleRate, blockSize, pattern, options.hugePages);
+		runner.run (warmupFrames);
+		double bestNanoseconds = std::numeric_limits<double>::max ();
+		uint64_t bestTicks = 0;
+		PerfCounters::Values bestCounters {};
+		for (auto repetition = 0; repetition < options.repetitions; ++repetition)
+		{
+			env.counters.start ();
+			auto startTicks = readTicks ();
+			auto startTime = Clock::now ();
+			runner.run (numFrames);
+			auto nanoseconds = std::chrono::duration<double, std::nano> (Clock::now () - startTime).count ();
+			auto ticks = readTicks () - startTicks;
+			auto counters = env.counters.stop ();
+			if (nanoseconds < bestNanoseconds)
+			{
+				bestNanoseconds = nanoseconds;
+				bestTicks = ticks;
+				bestCounters = counters;
+			}
+		}
+		result.add ("ns_per_sample", bestNanoseconds / numSamples);
+		result.add ("cycles_per_sample", static_cast<double> (bestTicks) / numSamples);
+		result.add ("realtime_factor", numSamples / sampleRate / (bestNanoseconds * 1e-9));
+		result.add ("bytes_per_instance", static_cast<double> (Verb::getMemorySize (static_cast<T> (sampleRate))));
+		for (auto event = 0; event < PerfCounters::kNumEvents; ++event)
+		{
+			auto e = static_cast<PerfCounters::Event> (event);
+			if (env.counters.isAvailable (e))
+				result.add (std::string (PerfCounters::getName (e)) + "_per_sample",
+				            static_cast<double> (bestCounters[event]) / numSamples);
+		}
+	}
+
+	// per stage breakdown with the probe compiled in, MVerbBatch has no probe
+	constexpr bool reducedRate = std::is_same<Verb, ReducedRateVerb<T>>::value;
+	constexpr bool mixed = std::is_same<Verb, MixedVerb<>>::value;
+	constexpr bool half = std::is_same<Verb, HalfVerb<>>::value;
+	if ((std::is_same<Verb, MVerb<T>>::value || reducedRate || mixed || half) && options.stages)
+	{
+		using ProbedVerb = std::conditional_t<
+		    reducedRate, ReducedRateVerb<T, StageProbe<kNumStages>>,
+		    std::conditional_t<mixed, MixedVerb<StageProbe<kNumStages>>,
+		                       std::conditional_t<half, HalfVerb<StageProbe<kNumStages>>,
+		                                          MVerb<T, StageProbe<kNumStages>>>>>;
+		Runner<T, ProbedVerb> runner (sampleRate, blockSize, pattern, options.hugePages);
+		runner.run (warmupFrames);
+		std::vector<double> best (kNumStages, std::numeric_limits<double>::max ());
+		for (auto repetition = 0; repetition < options.repetitions; ++repetition)
+		{
+			auto& probe = runner.getVerb ().getProbe ();
+			probe.clear ();
+			runner.run (numFrames);
+			for (auto stage = 0; stage < kNumStages; ++stage)
+			{
+				auto overhead = env.markOverhead * static_cast<double> (probe.getMarks (stage));
+				auto ticks = (static_cast<double> (probe.getTicks (stage)) - overhead) / numFrames;
+				best[stage] = std::min (best[stage], std::max (ticks, 0.));
+			}
+		}
+		for (auto stage = 0; stage < kNumStages; ++stage)
+		{
+			result.add (std::string (stageNames[stage]) + "_ns_per_sample",
+			            best[stage] / env.ticksPerNanosecond);
+			result.add (std::string (stageNames[stage]) + "_cycles_per_sample", best[stage]);
+		}
+	}
+	return result;
+}
+
+//------------------------------------------------------------------------
+/** What a host pays outside of process(): creating an instance and setting the sample rate
+ *  (plug-in scans, setupProcessing), and reset() on an instance that is idle or has just
+ *  played. Times are per instance, best of the repetitions. */
+template<typename T>
+BenchResult measureLifecycle (const std::string& type, double sampleRate, const Options& options)
+{
+	constexpr int kNumInstances = 32;
+	BenchResult result;
+	result.name = "lifecycle/" + type + "/" + std::to_string (static_cast<int> (sampleRate));
+
+	auto elapsedMicroseconds = [] (Clock::time_point start) {
+		return std::chrono::duration<double, std::micro> (Clock::now () - start).count () / kNumInstances;
+	};
+	double best[4] = {std::numeric_limits<double>::max (), std::numeric_limits<double>::max (),
+	                  std::numeric_limits<double>::max (), std::numeric_limits<double>::max ()};
+	// a quarter second is long enough for every line to wrap around
+	constexpr int kBlockSize = 256;
+	auto playFrames = static_cast<int> (0.25 * sampleRate);
+	std::vector<T> input (kBlockSize, static_cast<T> (0.1)), output[2];
+	output[0].resize (kBlockSize);
+	output[1].resize (kBlockSize);
+	T* inputPointers[2] = {input.data (), input.data ()};
+	T* outputPointers[2] = {output[0].data (), output[1].data ()};
+
+	for (auto repetition = 0; repetition < options.repetitions; ++repetition)
+	{
+		std::vector<std::unique_ptr<MVerb<T>>> verbs (kNumInstances);
+		auto start = Clock::now ();
+		for (auto& verb : verbs)
+		{
+			verb = std::make_unique<MVerb<T>> ();
+			verb->setUseHugePages (options.hugePages);
+			for (auto index = 0; index < MVerb<T>::NUM_PARAMS; ++index)
+				verb->setParameter (index, static_cast<T> (defaultParameters[index]));
+			verb->setSampleRate (static_cast<T> (sampleRate));
+		}
+		best[0] = std::min (best[0], elapsedMicroseconds (start));
+
+		start = Clock::now ();
+		for (auto& verb : verbs)
+			verb->reset ();
+		best[1] = std::min (best[1], elapsedMicroseconds (start));
+
+		for (auto& verb : verbs)
+		{
+			for (auto done = 0; done < playFrames; done += kBlockSize)
+				verb->process (inputPointers, outputPointers, kBlockSize);
+		}
+		start = Clock::now ();
+		for (auto& verb : verbs)
+			verb->reset ();
+		best[2] = std::min (best[2], elapsedMicroseconds (start));
+
+		start = Clock::now ();
+		verbs.clear ();
+		best[3] = std::min (best[3], elapsedMicroseconds (start));
+	}
+	result.add ("create_us", best[0]);
+	result.add ("reset_idle_us", best[1]);
+	result.add ("reset_played_us", best[2]);
+	result.add ("destroy_us", best[3]);
+	return result;
+}
+
+//------------------------------------------------------------------------
+void printLifecycleResult (const BenchResult& result)
+{
+	auto value = [&] (const char* key) {
+		auto ptr = result.find (key);
+		return ptr ? *ptr : 0.;
+	};
+	printf ("%-28s %9.2f %9.2f %9.2f %9.2f\n", result.name.data (), value ("create_us"),
+	        value ("reset_idle_us"), value ("reset_played_us"), value ("destroy_us"));
+	fflush (stdout);
+}
+
+//------------------------------------------------------------------------
+BenchResult measureType (const std::string& type, double sampleRate, int blockSize, Pattern pattern,
+                         const Options& options, Environment& env)
+{
+	if (type == "double")
+		return measure<double> (type, sampleRate, blockSize, pattern, options, env);
+	if (type == "mixed")
+		return measure<double, MixedVerb<>> (type, sampleRate, blockSize, pattern, options, env);
+	if (type == "float-dispatch")
+		return measure<float, DispatchVerb> (type, sampleRate, blockSize, pattern, options, env);
+	if (type == "float-half")
+		return measure<float, HalfVerb<>> (type, sampleRate, blockSize, pattern, options, env);
+	if (type == "float-tpt")
+		return measure<float, TptVerb<>> (type, sampleRate, blockSize, pattern, options, env);
+	if (type == "float-reduced")
+		return measure<float, ReducedRateVerb<float>> (type, sampleRate, blockSize, pattern, options, env);
+	if (type == "double-reduced")
+		return measure<double, ReducedRateVerb<double>> (type, sampleRate, blockSize, pattern, options,
+		                                                 env);
+	if (type == "batch4")
+		return measure<float, BatchVerb<4>> (type, sampleRate, blockSize, pattern, options, env);
+	if (type == "batch4-dispatch")
+		return measure<float, BatchVerb<4, true>> (type, sampleRate, blockSize, pattern, options, env);
+	if (type == "batch8")
+		return measure<float, BatchVerb<8>> (type, sampleRate, blockSize, pattern, options, env);
+	if (type == "batch8-dispatch")
+		return measure<float, BatchVerb<8, true>> (type, sampleRate, blockSize, pattern, options, env);
+	if (type == "batch16")
+		return measure<float, BatchVerb<16>> (type, sampleRate, blockSize, pattern, options, env);
+	if (type == "batch16-dispatch")
+		return measure<float, BatchVerb<16, true>> (type, sampleRate, blockSize, pattern, options, env);
+	if (type == "surround51")
+		return measure<float, SurroundVerb<6>> (type, sampleRate, blockSize, pattern, options, env);
+	if (type == "surround71")
+		return measure<float, SurroundVerb<8>> (type, sampleRate, blockSize, pattern, options, env);
+	if (type == "surround714")
+		return measure<float, SurroundVerb<12>> (type, sampleRate, blockSize, pattern, options, env);
+	return measure<float> (type, sampleRate, blockSize, pattern, options, env);
+}
+
+//------------------------------------------------------------------------
+void printResult (const BenchResult& result, const BenchResult* baseline)
+{
+	auto value = [&] (const char* key) {
+		auto ptr = result.find (key);
+		return ptr ? *ptr : 0.;
+	};
+	printf ("%-28s %9.2f %9.1f", result.name.data (), value ("ns_per_sample"),
+	        value ("cycles_per_sample"));
+	for (auto stage = 0; stage < kNumStages; ++stage)
+	{
+		auto key = std::string (stageNames[stage]) + "_cycles_per_sample";
+		if (auto ptr = result.find (key))
+			printf (" %8.1f", *ptr);
+	}
+	if (auto ptr = result.find ("llc_misses_per_sample"))
+		printf (" %8.3f", *ptr);
+	if (auto ptr = result.find ("branch_misses_per_sample"))
+		printf (" %8.3f", *ptr);
+	if (baseline)
+	{
+		auto base = baseline->find ("ns_per_sample");
+		if (base && *base > 0.)
+			printf ("  %+6.1f%%", (value ("ns_per_sample") / *base - 1.) * 100.);
+	}
+	printf ("\n");
+	fflush (stdout);
+}
+
+//------------------------------------------------------------------------
+void printHeader (const Options& options, const Environment& env)
+{
+	printf ("%-28s %9s %9s", "config", "ns/smp", "cyc/smp");
+	if (options.stages)
+		printf (" %8s %8s %8s %8s %8s %8s", "control", "bandw", "early", "diffuse", "tank", "output");
+	if (env.counters.isAvailable (PerfCounters::kLLCMisses))
+		printf (" %8s", "llc/smp");
+	if (env.counters.isAvailable (PerfCounters::kBranchMisses))
+		printf (" %8s", "br/smp");
+	if (!options.baselinePath.empty ())
+		printf ("  %7s", "vs base");
+	printf ("\n");
+}
+
+//------------------------------------------------------------------------
+template<typename T, typename Parse>
+bool parseList (const char* text, std::vector<T>& list, Parse parse)
+{
+	list.clear ();
+	std::stringstream stream (text);
+	std::string item;
+	while (std::getline (stream, item, ','))
+	{
+		T value;
+		if (!parse (item, value))
+			return false;
+		list.push_back (value);
+	}
+	return !list.empty ();
+}
+
+//------------------------------------------------------------------------
+bool parseDouble (const std::string& text, double& value)
+{
+	char* end = nullptr;
+	value = strtod (text.data (), &end);
+	return end != text.data () && *end == 0 && value > 0.;
+}
+
+//------------------------------------------------------------------------
+bool parseArguments (int argc, char* argv[], Options& options)
+{
+	for (auto index = 1; index < argc; ++index)
+	{
+		std::string arg = argv[index];
+		if (arg == "--no-stages")
+		{
+			options.stages = false;
+			continue;
+		}
+		if (arg == "--no-lifecycle")
+		{
+			options.lifecycle = false;
+			continue;
+		}
+		if (arg == "--perf")
+		{
+			options.perf = true;
+			continue;
+		}
+		if (arg == "--huge-pages")
+		{
+			options.hugePages = true;
+			continue;
+		}
+		if (arg == "--keep-denormals")
+		{
+			options.keepDenormals = true;
+			continue;
+		}
+		if (index + 1 >= argc)
+			return false;
+		const char* value = argv[++index];
+		double number = 0.;
+		bool ok = true;
+		if (arg == "--types")
+			ok = parseList (value, options.types, [] (const std::string& s, std::string& v) {
+				v = s;
+				return s == "float" || s == "double" || s == "mixed" || s == "float-half" || s == "float-dispatch" ||
+				       s == "float-tpt" || s == "float-reduced" ||
+				       s == "double-reduced" || s == "batch4" || s == "batch8" ||
+				       s == "batch16" || s == "surround51" || s == "surround71" ||
+				       s == "surround714" || s == "batch4-dispatch" || s == "batch8-dispatch" ||
+				       s == "batch16-dispatch";
+			});
+		else if (arg == "--sample-rates")
+			ok = parseList (value, options.sampleRates, parseDouble);
+		else if (arg == "--block-sizes")
+			ok = parseList (value, options.blockSizes, [] (const std::string& s, int& v) {
+				double d;
+				if (!parseDouble (s, d) || d > 65536.)
+					return false;
+				v = static_cast<int> (d);
+				return true;
+			});
+		else if (arg == "--patterns")
+			ok = parseList (value, options.patterns, [] (const std::string& s, Pattern& v) {
+				for (auto p : {Pattern::Static, Pattern::Ramp, Pattern::SizeJumps})
+				{
+					if (s == getName (p))
+					{
+						v = p;
+						return true;
+					}
+				}
+				return false;
+			});
+		else if (arg == "--seconds" && parseDouble (value, number))
+			options.seconds = number;
+		else if (arg == "--repetitions" && parseDouble (value, number))
+			options.repetitions = static_cast<int> (number);
+		else if (arg == "--save")
+			options.savePath = value;
+		else if (arg == "--baseline")
+			options.baselinePath = value;
+		else if (arg == "--tolerance" && parseDouble (value, number))
+			options.tolerance = number;
+		else
+			ok = false;
+		if (!ok)
+		{
+			fprintf (stderr, "invalid option: %s %s\n", arg.data (), value);
+			return false;
+		}
+	}
+	return true;
+}
+
+//------------------------------------------------------------------------
+void printUsage ()
+{
+	fprintf (stderr,
+	         "usage: mverb-bench [options]\n"
+	         "\n"
+	         "  --types LIST           float,double,mixed,float-half,float-tpt,float-dispatch,\n"
+	         "                         float-reduced,double-reduced,batch4,batch8,batch16,surround51,\n"
+	         "                         surround71,surround714,batch4-dispatch,batch8-dispatch,\n"
+	         "                         batch16-dispatch\n"
+	         "                         (default: float,double)\n"
+	         "  --sample-rates LIST    default: 44100,48000,96000,192000\n"
+	         "  --block-sizes LIST     default: 1,8,32,64,256,1024,4096\n"
+	         "  --patterns LIST        static,ramp,size (default: all)\n"
+	         "  --seconds S            audio processed per measurement (default: 1)\n"
+	         "  --repetitions N        best of N measurements (default: 3)\n"
+	         "  --no-stages            skip the per stage breakdown\n"
+	         "  --no-lifecycle         skip the instantiation and reset timings\n"
+	         "  --perf                 read hardware counters (Linux perf_event)\n"
+	         "  --huge-pages           back the delay lines with transparent huge pages (Linux)\n"
+	         "  --keep-denormals       run without flushing subnormals to zero (see DenormalGuard)\n"
+	         "  --save FILE            write the results as JSON\n"
+	         "  --baseline FILE        compare ns/sample against a saved JSON result\n"
+	         "  --tolerance PERCENT    slowdown vs. baseline that counts as regression (default: 5)\n"
+	         "\n"
+	         "Stage columns are TSC cycles per sample with the probe overhead subtracted.\n"
+	         "batchN runs N float reverbs in MVerbBatch, its numbers are per reverb and sample.\n"
+	         "surroundXY runs MVerbSurround on a float bed, its numbers are per stereo pair.\n"
+	         "mixed runs the float engine on double buffers, the plug-in's 64 bit engine.\n"
+	         "float-half runs the float engine with 16 bit delay lines.\n"
+	         "float-tpt runs the float engine with the TptLowpass filters.\n"
+	         "float-dispatch runs the float engine of mverb-dispatch for the best instruction set,\n"
+	         "MVERB_ISA=sse2|avx2|avx512 picks a lower one. batchN-dispatch runs MVerbBatch of\n"
+	         "mverb-dispatch the same way.\n"
+	         "X-reduced runs the tank and the early reflections at 1/2 of 88.2 and 96 kHz and at\n"
+	         "1/4 of 176.4 and 192 kHz, like the plug-in built with MVERB_REDUCED_RATE.\n"
+	         "Lifecycle: create is construction plus setSampleRate, reset2 a reset after playing.\n");
+}
+
+//------------------------------------------------------------------------
+int runBenchmarks (const Options& options)
+{
+	// like the plug-in does on the host's audio thread, unless the subnormals are to be measured
+	std::optional<DenormalGuard> denormalGuard;
+	if (!options.keepDenormals)
+		denormalGuard.emplace ();
+
+	Environment env;
+	env.ticksPerNanosecond = measureTicksPerNanosecond ();
+	env.markOverhead = StageProbe<kNumStages>::measureMarkOverhead ();
+	if (options.perf && !env.counters.open ())
+		fprintf (stderr, "hardware counters not available, see /proc/sys/kernel/perf_event_paranoid\n");
+
+	BenchResults baseline;
+	if (!options.baselinePath.empty ())
+	{
+		std::string error;
+		if (!readBenchResults (options.baselinePath, baseline, error))
+		{
+			fprintf (stderr, "%s\n", error.data ());
+			return 1;
+		}
+	}
+
+	printf ("TSC: %.3f ticks/ns, probe overhead: %.1f ticks/mark\n\n", env.ticksPerNanosecond,
+	        env.markOverhead);
+	printHeader (options, env);
+
+	BenchResults results;
+	auto regressions = 0;
+	for (const auto& type : options.types)
+	{
+		for (auto sampleRate : options.sampleRates)
+		{
+			for (auto blockSize : options.blockSizes)
+			{
+				for (auto pattern : options.patterns)
+				{
+					auto result = measureType (type, sampleRate, blockSize, pattern, options, env);
+					auto base = std::find_if (baseline.begin (), baseline.end (),
+					                          [&] (const auto& r) { return r.name == result.name; });
+					const BenchResult* baseResult = base != baseline.end () ? &*base : nullptr;
+					printResult (result, baseResult);
+					if (baseResult)
+					{
+						auto now = result.find ("ns_per_sample");
+						auto before = baseResult->find ("ns_per_sample");
+						if (now && before && *now > *before * (1. + options.tolerance / 100.))
+							++regressions;
+					}
+					results.push_back (std::move (result));
+				}
+			}
+		}
+	}
+
+	if (options.lifecycle)
+	{
+		printf ("\n%-28s %9s %9s %9s %9s\n", "lifecycle (us/instance)", "create", "reset", "reset2",
+		        "destroy");
+		for (const auto& type : options.types)
+		{
+			if (type != "float" && type != "double")
+				continue;
+			for (auto sampleRate : options.sampleRates)
+			{
+				auto result = type == "float" ? measureLifecycle<float> (type, sampleRate, options)
+				                              : measureLifecycle<double> (type, sampleRate, options);
+				printLifecycleResult (result);
+				results.push_back (std::move (result));
+			}
+		}
+	}
+
+	if (!options.savePath.empty () && !writeBenchResults (options.savePath, results))
+	{
+		fprintf (stderr, "could not write '%s'\n", options.savePath.data ());
+		return 1;
+	}
+	if (regressions > 0)
+	{
+		printf ("\n%d configuration(s) slower than the baseline by more than %.1f%%\n", regressions,
+		        options.tolerance);
+		return 2;
+	}
+	return 0;
+}
+
+//------------------------------------------------------------------------
+} // anonymous
+} // namespace mverb
+
+//------------------------------------------------------------------------
+int main (int argc, char* argv[])
+{
+	mverb::Options options;
+	if (!mverb::parseArguments (argc, argv, options))
+	{
+		mverb::printUsage ();
+		return 1;
+	}
+	return mverb::runBenchmarks (options);
+}
@@ -0,0 +1,132 @@
+//  Copyright (c) 2022 Arne Scheffler
+//  This code is distributed under the terms of the GNU General Public License
+
+//  MVerb is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  at your option) any later version.
+//
+//  MVerb is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this MVerb.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "perfcounters.h"
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+#endif
+
+namespace mverb {
+
+#if defined(__linux__)
+namespace {
+
+//------------------------------------------------------------------------
+int openEvent (uint32_t type, uint64_t config, int groupFd)
+{
+	perf_event_attr attr;
+	memset (&attr, 0, sizeof (attr));
+	attr.size = sizeof (attr);
+	attr.type = type;
+	attr.config = config;
+	attr.disabled = groupFd < 0 ? 1 : 0;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	return static_cast<int> (syscall (__NR_perf_event_open, &attr, 0, -1, groupFd, 0));
+}
+
+//------------------------------------------------------------------------
+constexpr uint64_t cacheEvent (uint64_t cache, uint64_t op, uint64_t result)
+{
+	return cache | (op << 8) | (result << 16);
+}
+
+//------------------------------------------------------------------------
+} // anonymous
+
+//------------------------------------------------------------------------
+PerfCounters::~PerfCounters ()
+{
+	for (auto fd : fds)
+	{
+		if (fd >= 0)
+			close (fd);
+	}
+}
+
+//------------------------------------------------------------------------
+bool PerfCounters::open ()
+{
+	fds[kCycles] = openEvent (PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1);
+	if (fds[kCycles] < 0)
+		return false;
+	auto group = fds[kCycles];
+	fds[kInstructions] = openEvent (PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, group);
+	fds[kLLCMisses] = openEvent (PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, group);
+	fds[kBranchMisses] = openEvent (PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, group);
+	fds[kDTLBMisses] = openEvent (
+	    PERF_TYPE_HW_CACHE,
+	    cacheEvent (PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS),
+	    group);
+	return true;
+}
+
+//------------------------------------------------------------------------
+void PerfCounters::start ()
+{
+	if (!isOpen ())
+		return;
+	ioctl (fds[kCycles], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl (fds[kCycles], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+//------------------------------------------------------------------------
+PerfCounters::Values PerfCounters::stop ()
+{
+	Values values {};
+	if (!isOpen ())
+		return values;
+	ioctl (fds[kCycles], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+	for (auto event = 0; event < kNumEvents; ++event)
+	{
+		if (fds[event] < 0 || read (fds[event], &values[event], sizeof (uint64_t)) != sizeof (uint64_t))
+			values[event] = 0;
+	}
+	return values;
+}
+
+#else
+
+//------------------------------------------------------------------------
+PerfCounters::~PerfCounters () {}
+bool PerfCounters::open () { return false; }
+void PerfCounters::start () {}
+PerfCounters::Values PerfCounters::stop () { return {}; }
+
+#endif
+
+//------------------------------------------------------------------------
+const char* PerfCounters::getName (Event event)
+{
+	switch (event)
+	{
+		case kCycles: return "cycles";
+		case kInstructions: return "instructions";
+		case kLLCMisses: return "llc_misses";
+		case kBranchMisses: return "branch_misses";
+		case kDTLBMisses: return "dtlb_misses";
+		case kNumEvents: break;
+	}
+	return "";
+}
+
+//------------------------------------------------------------------------
+} // namespace mverb
@@ -0,0 +1,64 @@
+//  Copyright (c) 2022 Arne Scheffler
+//  This code is distributed under the terms of the GNU General Public License
+
+//  MVerb is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  at your option) any later version.
+//
+//  MVerb is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this MVerb.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace mverb {
+
+//------------------------------------------------------------------------
+/** Hardware event counters of the calling thread via Linux perf_event.
+ *
+ *	open () fails on other platforms and when the kernel does not allow user space counters
+ *	(see /proc/sys/kernel/perf_event_paranoid), the benchmark then just reports timings.
+ */
+class PerfCounters
+{
+public:
+	enum Event
+	{
+		kCycles,
+		kInstructions,
+		kLLCMisses,
+		kBranchMisses,
+		kDTLBMisses,
+		kNumEvents
+	};
+	using Values = std::array<uint64_t, kNumEvents>;
+
+	PerfCounters () = default;
+	~PerfCounters ();
+	PerfCounters (const PerfCounters&) = delete;
+	PerfCounters& operator= (const PerfCounters&) = delete;
+
+	bool open ();
+	bool isOpen () const { return fds[kCycles] >= 0; }
+	bool isAvailable (Event event) const { return fds[event] >= 0; }
+
+	void start ();
+	/** stop counting and return the counts since start () */
+	Values stop ();
+
+	static const char* getName (Event event);
+
+private:
+	std::array<int, kNumEvents> fds {{-1, -1, -1, -1, -1}};
+};
+
+//------------------------------------------------------------------------
+} // namespace mverb
@@ -0,0 +1,240 @@
+//  Copyright (c) 2022 Arne Scheffler
+//  This code is distributed under the terms of the GNU General Public License
+
+//  MVerb is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  at your option) any later version.
+//
+//  MVerb is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this MVerb.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "results.h"
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+namespace mverb {
+namespace {
+
+//------------------------------------------------------------------------
+/** Just enough JSON to read back what writeBenchResults produces. */
+class Parser
+{
+public:
+	explicit Parser (const std::string& text) : text (text) {}
+
+	bool parseResults (BenchResults& results)
+	{
+		if (!expect ('{'))
+			return false;
+		while (true)
+		{
+			std::string key;
+			if (!parseString (key) || !expect (':'))
+				return false;
+			if (key == "results")
+			{
+				if (!parseResultArray (results))
+					return false;
+			}
+			else if (!skipValue ())
+				return false;
+			if (consume (','))
+				continue;
+			return expect ('}');
+		}
+	}
+
+private:
+	bool parseResultArray (BenchResults& results)
+	{
+		if (!expect ('['))
+			return false;
+		if (consume (']'))
+			return true;
+		do
+		{
+			BenchResult result;
+			if (!expect ('{'))
+				return false;
+			do
+			{
+				std::string key;
+				if (!parseString (key) || !expect (':'))
+					return false;
+				skipWhitespace ();
+				if (key == "name")
+				{
+					if (!parseString (result.name))
+						return false;
+				}
+				else
+				{
+					double value;
+					if (!parseNumber (value))
+						return false;
+					result.add (key, value);
+				}
+			} while (consume (','));
+			if (!expect ('}'))
+				return false;
+			results.push_back (std::move (result));
+		} while (consume (','));
+		return expect (']');
+	}
+
+	bool parseString (std::string& value)
+	{
+		if (!expect ('"'))
+			return false;
+		while (pos < text.size () && text[pos] != '"')
+		{
+			if (text[pos] == '\\' && pos + 1 < text.size ())
+				++pos;
+			value += text[pos++];
+		}
+		return consume ('"');
+	}
+
+	bool parseNumber (double& value)
+	{
+		skipWhitespace ();
+		auto start = text.data () + pos;
+		char* end = nullptr;
+		value = strtod (start, &end);
+		if (end == start)
+			return false;
+		pos += end - start;
+		return true;
+	}
+
+	bool skipValue ()
+	{
+		skipWhitespace ();
+		if (pos >= text.size ())
+			return false;
+		auto c = text[pos];
+		if (c == '"')
+		{
+			std::string ignored;
+			return parseString (ignored);
+		}
+		if (c == '{' || c == '[')
+		{
+			auto depth = 0;
+			bool inString = false;
+			for (; pos < text.size (); ++pos)
+			{
+				c = text[pos];
+				if (inString)
+				{
+					if (c == '\\')
+						++pos;
+					else if (c == '"')
+						inString = false;
+				}
+				else if (c == '"')
+					inString = true;
+				else if (c == '{' || c == '[')
+					++depth;
+				else if ((c == '}' || c == ']') && --depth == 0)
+				{
+					++pos;
+					return true;
+				}
+			}
+			return false;
+		}
+		while (pos < text.size () && text[pos] != ',' && text[pos] != '}' && text[pos] != ']')
+			++pos;
+		return true;
+	}
+
+	void skipWhitespace ()
+	{
+		while (pos < text.size () && isspace (static_cast<unsigned char> (text[pos])))
+			++pos;
+	}
+
+	bool consume (char c)
+	{
+		skipWhitespace ();
+		if (pos < text.size () && text[pos] == c)
+		{
+			++pos;
+			return true;
+		}
+		return false;
+	}
+
+	bool expect (char c) { return consume (c); }
+
+	const std::string& text;
+	size_t pos {0};
+};
+
+//------------------------------------------------------------------------
+} // anonymous
+
+//------------------------------------------------------------------------
+const double* BenchResult::find (const std::string& key) const
+{
+	for (const auto& metric : metrics)
+	{
+		if (metric.first == key)
+			return &metric.second;
+	}
+	return nullptr;
+}
+
+//------------------------------------------------------------------------
+bool writeBenchResults (const std::string& path, const BenchResults& results)
+{
+	auto file = fopen (path.data (), "w");
+	if (!file)
+		return false;
+	fprintf (file, "{\n\t\"results\": [\n");
+	for (auto index = 0u; index < results.size (); ++index)
+	{
+		const auto& result = results[index];
+		fprintf (file, "\t\t{\"name\": \"%s\"", result.name.data ());
+		for (const auto& metric : result.metrics)
+			fprintf (file, ", \"%s\": %.10g", metric.first.data (), metric.second);
+		fprintf (file, "}%s\n", index + 1 < results.size () ? "," : "");
+	}
+	fprintf (file, "\t]\n}\n");
+	return fclose (file) == 0;
+}
+
+//------------------------------------------------------------------------
+bool readBenchResults (const std::string& path, BenchResults& results, std::string& error)
+{
+	std::ifstream stream (path);
+	if (!stream)
+	{
+		error = "could not open '" + path + "'";
+		return false;
+	}
+	std::stringstream content;
+	content << stream.rdbuf ();
+	auto text = content.str ();
+	Parser parser (text);
+	if (!parser.parseResults (results))
+	{
+		error = "'" + path + "' is not a benchmark result file";
+		return false;
+	}
+	return true;
+}
+
+//------------------------------------------------------------------------
+} // namespace mverb
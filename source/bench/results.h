@@ -0,0 +1,44 @@
+//  Copyright (c) 2022 Arne Scheffler
+//  This code is distributed under the terms of the GNU General Public License
+
+//  MVerb is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  at your option) any later version.
+//
+//  MVerb is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this MVerb.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mverb {
+
+//------------------------------------------------------------------------
+/** One benchmark configuration and its measured metrics, in the order they were added. */
+struct BenchResult
+{
+	std::string name;
+	std::vector<std::pair<std::string, double>> metrics;
+
+	void add (const std::string& key, double value) { metrics.emplace_back (key, value); }
+	const double* find (const std::string& key) const;
+};
+
+using BenchResults = std::vector<BenchResult>;
+
+//------------------------------------------------------------------------
+/** Baseline files are plain JSON: {"results": [{"name": "...", "metric": number, ...}, ...]} */
+bool writeBenchResults (const std::string& path, const BenchResults& results);
+bool readBenchResults (const std::string& path, BenchResults& results, std::string& error);
+
+//------------------------------------------------------------------------
+} // namespace mverb
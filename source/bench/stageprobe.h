@@ -0,0 +1,114 @@
+//  Copyright (c) 2022 Arne Scheffler
+//  This code is distributed under the terms of the GNU General Public License
+
+//  MVerb is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  at your option) any later version.
+//
+//  MVerb is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this MVerb.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#define MVERB_BENCH_HAS_TSC 1
+#else
+#define MVERB_BENCH_HAS_TSC 0
+#endif
+
+namespace mverb {
+
+//------------------------------------------------------------------------
+/** Cheapest available timestamp: the TSC on x86, nanoseconds elsewhere. */
+inline uint64_t readTicks ()
+{
+#if MVERB_BENCH_HAS_TSC
+	return __rdtsc ();
+#else
+	return static_cast<uint64_t> (std::chrono::duration_cast<std::chrono::nanoseconds> (
+	                                  std::chrono::steady_clock::now ().time_since_epoch ())
+	                                  .count ());
+#endif
+}
+
+//------------------------------------------------------------------------
+/** Ticks per nanosecond of readTicks (), measured against the steady clock. */
+inline double measureTicksPerNanosecond ()
+{
+#if MVERB_BENCH_HAS_TSC
+	using Clock = std::chrono::steady_clock;
+	auto startTime = Clock::now ();
+	auto startTicks = readTicks ();
+	std::this_thread::sleep_for (std::chrono::milliseconds (100));
+	auto ticks = readTicks () - startTicks;
+	auto nanoseconds = std::chrono::duration<double, std::nano> (Clock::now () - startTime).count ();
+	return static_cast<double> (ticks) / nanoseconds;
+#else
+	return 1.;
+#endif
+}
+
+//------------------------------------------------------------------------
+/** MVerb probe which attributes the ticks between two marks to the stage of the second mark.
+ *
+ *	Every mark costs one timestamp read. measureMarkOverhead () reports how many ticks that adds
+ *	per mark so it can be subtracted from the stage totals using getMarks ().
+ */
+template<int NumStages>
+class StageProbe
+{
+public:
+	void start () { last = readTicks (); }
+
+	void mark (int stage)
+	{
+		auto now = readTicks ();
+		ticks[stage] += now - last;
+		++marks[stage];
+		last = now;
+	}
+
+	void clear ()
+	{
+		ticks.fill (0);
+		marks.fill (0);
+	}
+
+	uint64_t getTicks (int stage) const { return ticks[stage]; }
+	/** number of marks of stage since clear (), one per processed chunk */
+	uint64_t getMarks (int stage) const { return marks[stage]; }
+
+	static double measureMarkOverhead ()
+	{
+		constexpr int kIterations = 1 << 20;
+		StageProbe probe;
+		probe.start ();
+		for (auto i = 0; i < kIterations; ++i)
+			probe.mark (0);
+		return static_cast<double> (probe.ticks[0]) / kIterations;
+	}
+
+private:
+	std::array<uint64_t, NumStages> ticks {};
+	std::array<uint64_t, NumStages> marks {};
+	uint64_t last {0};
+};
+
+//------------------------------------------------------------------------
+} // namespace mverb
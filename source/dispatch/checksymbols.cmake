@@ -0,0 +1,49 @@
+#  Copyright (c) 2022 Arne Scheffler
+#  This code is distributed under the terms of the GNU General Public License
+#
+#  MVerb is free software: you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation, either version 3 of the License, or
+#  at your option) any later version.
+#
+#  MVerb is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this MVerb.  If not, see <http://www.gnu.org/licenses/>.
+
+# cmake -DNM=nm -DOBJECT=kernel.o -DNAMESPACE=mverb_avx2 -P checksymbols.cmake
+# Fails if the kernel object defines a global or weak symbol outside its namespace, the linker
+# could then hand that copy to the rest of the program, see CMakeLists.txt.
+
+execute_process(
+    COMMAND ${NM} -g --defined-only ${OBJECT}
+    OUTPUT_VARIABLE symbols
+    RESULT_VARIABLE result
+)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "${NM} failed on ${OBJECT}")
+endif()
+
+string(REPLACE "\n" ";" symbols "${symbols}")
+set(count 0)
+set(leaked 0)
+foreach(line IN LISTS symbols)
+    if(line STREQUAL "")
+        continue()
+    endif()
+    math(EXPR count "${count} + 1")
+    if(NOT line MATCHES "${NAMESPACE}")
+        message("outside ${NAMESPACE}: ${line}")
+        math(EXPR leaked "${leaked} + 1")
+    endif()
+endforeach()
+if(count EQUAL 0)
+    message(FATAL_ERROR "${OBJECT} defines no symbols")
+endif()
+if(leaked GREATER 0)
+    message(FATAL_ERROR "${leaked} of ${count} symbols of ${OBJECT} are not local to ${NAMESPACE}")
+endif()
+message("${count} symbols, all in ${NAMESPACE}")
@@ -0,0 +1,161 @@
+//  Copyright (c) 2022 Arne Scheffler
+//  This code is distributed under the terms of the GNU General Public License
+
+//  MVerb is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  at your option) any later version.
+//
+//  MVerb is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this MVerb.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "../MVerbDispatch.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+#ifndef MVERB_DISPATCH_AVX2
+#define MVERB_DISPATCH_AVX2 0
+#endif
+#ifndef MVERB_DISPATCH_AVX512
+#define MVERB_DISPATCH_AVX512 0
+#endif
+
+//the engines built from kernel.cpp, the baseline one always and the others where CMake could
+//compile them (MVERB_DISPATCH_AVX2, MVERB_DISPATCH_AVX512)
+#define MVERB_DECLARE_KERNELS(name) \
+    namespace name { \
+        FloatMVerbKernel* CreateFloatKernel(); \
+        MixedMVerbKernel* CreateMixedKernel(); \
+        MVerbBatchKernel* CreateBatchKernel(int numLanes); \
+    }
+
+MVERB_DECLARE_KERNELS(mverb_sse2)
+#if MVERB_DISPATCH_AVX2
+MVERB_DECLARE_KERNELS(mverb_avx2)
+#define MVERB_AVX2_FACTORY(function) mverb_avx2::function
+#else
+#define MVERB_AVX2_FACTORY(function) nullptr
+#endif
+#if MVERB_DISPATCH_AVX512
+MVERB_DECLARE_KERNELS(mverb_avx512)
+#define MVERB_AVX512_FACTORY(function) mverb_avx512::function
+#else
+#define MVERB_AVX512_FACTORY(function) nullptr
+#endif
+
+//a factory of every set in the order of MVerbIsa, null where the set is not compiled in
+#define MVERB_FACTORIES(function) {mverb_sse2::function, MVERB_AVX2_FACTORY(function), MVERB_AVX512_FACTORY(function)}
+
+namespace {
+
+//what the CPU and the OS support, the OS has to save the wider registers on a context switch
+bool CpuSupports(MVerbIsa isa){
+    switch(isa){
+        case MVerbIsa::SSE2:
+            return true;
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+        //checks the OS support (XGETBV) along with CPUID
+        case MVerbIsa::AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        case MVerbIsa::AVX512:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl") &&
+                   __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512bw");
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+        case MVerbIsa::AVX2:
+        case MVerbIsa::AVX512:{
+            int info[4];
+            __cpuid(info, 1);
+            const bool osxsave = (info[2] & (1 << 27)) != 0;
+            const bool fma = (info[2] & (1 << 12)) != 0;
+            if(!osxsave)
+                return false;
+            const unsigned long long xcr0 = _xgetbv(0);
+            __cpuidex(info, 7, 0);
+            if(isa == MVerbIsa::AVX2)
+                return fma && (info[1] & (1 << 5)) != 0 && (xcr0 & 0x6) == 0x6;
+            const int avx512 = (1 << 16) | (1 << 17) | (1 << 30) | (1 << 31); //F, DQ, BW, VL
+            return (info[1] & avx512) == avx512 && (xcr0 & 0xe6) == 0xe6;
+        }
+#endif
+        default:
+            return false;
+    }
+}
+
+//the factory of isa, the baseline one if isa is not available
+template<typename Factory>
+Factory Select(const Factory (&factories)[3], MVerbIsa isa){
+    return MVerbIsaAvailable(isa) ? factories[static_cast<int>(isa)] : factories[0];
+}
+
+bool Compiled(MVerbIsa isa){
+    switch(isa){
+        case MVerbIsa::SSE2:
+            return true;
+        case MVerbIsa::AVX2:
+            return MVERB_DISPATCH_AVX2 != 0;
+        case MVerbIsa::AVX512:
+            return MVERB_DISPATCH_AVX512 != 0;
+    }
+    return false;
+}
+
+}
+
+bool MVerbIsaAvailable(MVerbIsa isa){
+    return Compiled(isa) && CpuSupports(isa);
+}
+
+const char* MVerbIsaName(MVerbIsa isa){
+    switch(isa){
+        case MVerbIsa::SSE2:
+            return "sse2";
+        case MVerbIsa::AVX2:
+            return "avx2";
+        case MVerbIsa::AVX512:
+            return "avx512";
+    }
+    return "";
+}
+
+MVerbIsa MVerbSelectIsa(){
+    MVerbIsa limit = MVerbIsa::AVX512;
+    if(const char* forced = getenv("MVERB_ISA")){
+        for(auto isa : {MVerbIsa::SSE2, MVerbIsa::AVX2, MVerbIsa::AVX512})
+            if(strcmp(forced, MVerbIsaName(isa)) == 0)
+                limit = isa;
+    }
+    for(auto isa : {MVerbIsa::AVX512, MVerbIsa::AVX2})
+        if(isa <= limit && MVerbIsaAvailable(isa))
+            return isa;
+    return MVerbIsa::SSE2;
+}
+
+std::unique_ptr<FloatMVerbKernel> MVerbCreateFloatKernel(MVerbIsa isa){
+    static FloatMVerbKernel* (*const factories[])() = MVERB_FACTORIES(CreateFloatKernel);
+    return std::unique_ptr<FloatMVerbKernel>(Select(factories, isa)());
+}
+
+std::unique_ptr<MixedMVerbKernel> MVerbCreateMixedKernel(MVerbIsa isa){
+    static MixedMVerbKernel* (*const factories[])() = MVERB_FACTORIES(CreateMixedKernel);
+    return std::unique_ptr<MixedMVerbKernel>(Select(factories, isa)());
+}
+
+std::unique_ptr<MVerbBatchKernel> MVerbCreateBatchKernel(MVerbIsa isa, int numLanes){
+    static MVerbBatchKernel* (*const factories[])(int) = MVERB_FACTORIES(CreateBatchKernel);
+    return std::unique_ptr<MVerbBatchKernel>(Select(factories, isa)(numLanes));
+}
@@ -0,0 +1,189 @@
+//  Copyright (c) 2022 Arne Scheffler
+//  This code is distributed under the terms of the GNU General Public License
+
+//  MVerb is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  at your option) any later version.
+//
+//  MVerb is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this MVerb.  If not, see <http://www.gnu.org/licenses/>.
+
+//the engine for one instruction set. This file is compiled once per set with MVERB_ISA_NAMESPACE
+//naming the namespace of that copy of the engine and MVERB_ISA_ID its MVerbIsa, see
+//MVerbDispatch.h and CMakeLists.txt.
+
+#include "../MVerbDispatch.h"
+
+#include "../MVerb.h"
+#include "../MVerbBatch.h"
+
+#if !defined(MVERB_ISA_NAMESPACE) || !defined(MVERB_ISA_ID)
+#error "compile with MVERB_ISA_NAMESPACE and MVERB_ISA_ID defined"
+#endif
+
+namespace MVERB_ISA_NAMESPACE {
+
+template<typename Verb, typename T, typename Sample>
+class Kernel : public MVerbKernel<T, Sample>
+{
+private:
+    static_assert(std::is_same_v<typename Verb::Control, Sample>, "the engine is set up in the type of its buffers");
+    Verb verb;
+
+public:
+    bool process(Sample **inputs, Sample **outputs, int sampleFrames) override{
+        return verb.process(inputs, outputs, sampleFrames);
+    }
+
+    unsigned getSilentChannels() const override{
+        return verb.getSilentChannels();
+    }
+
+    bool setChannels(int numInputs, int numOutputs) override{
+        return verb.setChannels(numInputs, numOutputs);
+    }
+
+    bool isSleeping() const override{
+        return verb.isSleeping();
+    }
+
+    int getTailSamples() const override{
+        return verb.getTailSamples();
+    }
+
+    void reset() override{
+        verb.reset();
+    }
+
+    void setParameter(int index, Sample value) override{
+        verb.setParameter(index, value);
+    }
+
+    float getParameter(int index) override{
+        return verb.getParameter(index);
+    }
+
+    void setSampleRate(Sample sampleRate) override{
+        verb.setSampleRate(sampleRate);
+    }
+
+    bool setSampleRate(Sample sampleRate, int divider, bool earlyReflections) override{
+        return verb.setSampleRate(sampleRate, divider, earlyReflections);
+    }
+
+    bool setRateDivider(int divider, bool earlyReflections) override{
+        return verb.setRateDivider(divider, earlyReflections);
+    }
+
+    void setUseHugePages(bool state) override{
+        verb.setUseHugePages(state);
+    }
+
+    MVerbIsa getIsa() const override{
+        return MVERB_ISA_ID;
+    }
+};
+
+//N lanes as Parts batches of N / Parts lanes each, lane l is lane l % (N / Parts) of batch
+//l / (N / Parts)
+template<int N, int Parts>
+class BatchKernel : public MVerbBatchKernel
+{
+private:
+    enum { M = N / Parts };
+    MVerbBatch<float, M> batches[Parts];
+
+public:
+    int getNumLanes() const override{
+        return N;
+    }
+
+    int addLane() override{
+        for(int part=0;part<Parts;part++){
+            int lane = batches[part].addLane();
+            if(lane >= 0)
+                return part * M + lane;
+        }
+        return -1;
+    }
+
+    void removeLane(int lane) override{
+        batches[lane / M].removeLane(lane % M);
+    }
+
+    bool isLaneActive(int lane) const override{
+        return batches[lane / M].isLaneActive(lane % M);
+    }
+
+    int getNumActiveLanes() const override{
+        int count = 0;
+        for(const auto& batch : batches)
+            count += batch.getNumActiveLanes();
+        return count;
+    }
+
+    unsigned process(float** const* inputs, float** const* outputs, int sampleFrames) override{
+        unsigned silent = 0;
+        for(int part=0;part<Parts;part++)
+            silent |= batches[part].process(inputs + part * M, outputs + part * M, sampleFrames) << (part * M);
+        return silent;
+    }
+
+    void reset() override{
+        for(auto& batch : batches)
+            batch.reset();
+    }
+
+    void setParameter(int lane, int index, float value) override{
+        batches[lane / M].setParameter(lane % M, index, value);
+    }
+
+    float getParameter(int lane, int index) const override{
+        return batches[lane / M].getParameter(lane % M, index);
+    }
+
+    void setSampleRate(float sampleRate) override{
+        for(auto& batch : batches)
+            batch.setSampleRate(sampleRate);
+    }
+
+    MVerbIsa getIsa() const override{
+        return MVERB_ISA_ID;
+    }
+};
+
+FloatMVerbKernel* CreateFloatKernel(){
+    return new Kernel<MVerb<float>, float, float>;
+}
+
+MixedMVerbKernel* CreateMixedKernel(){
+    return new Kernel<MVerb<float, MVerbNullProbe, WideStateVariable>, float, double>;
+}
+
+//with AVX2 but not AVX-512 the portable LaneVector<float, 16> is about four times slower than
+//two batches in AVX2 registers, without AVX2 it is as fast as smaller batches
+#if defined(__AVX2__) && !defined(__AVX512F__)
+constexpr int Batch16Parts = 2;
+#else
+constexpr int Batch16Parts = 1;
+#endif
+
+MVerbBatchKernel* CreateBatchKernel(int numLanes){
+    switch(numLanes){
+        case 4:
+            return new BatchKernel<4, 1>;
+        case 8:
+            return new BatchKernel<8, 1>;
+        case 16:
+            return new BatchKernel<16, Batch16Parts>;
+    }
+    return nullptr;
+}
+
+}
@@ -0,0 +1,72 @@
+//  Copyright (c) 2022 Arne Scheffler
+//  This code is distributed under the terms of the GNU General Public License
+
+//  MVerb is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  at your option) any later version.
+//
+//  MVerb is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this MVerb.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+
+namespace mverb {
+
+//------------------------------------------------------------------------
+/** Blocking FIFO used to hand audio blocks between the reader, DSP and writer threads.
+ *
+ *	A fixed ring of Capacity values, it never allocates: the renderer owns a pool of kNumBlocks
+ *	blocks and only pointers to them travel through the pipeline, so no queue ever holds more
+ *	than the pool. The size of the pool is what lets the stages run ahead of each other.
+ */
+template<typename T, size_t Capacity>
+class BlockQueue
+{
+public:
+	/** waits while the queue is full */
+	void push (T value)
+	{
+		{
+			std::unique_lock<std::mutex> lock (mutex);
+			condition.wait (lock, [this] () { return count < Capacity; });
+			values[(first + count) % Capacity] = value;
+			++count;
+		}
+		condition.notify_all ();
+	}
+
+	T pop ()
+	{
+		T value;
+		{
+			std::unique_lock<std::mutex> lock (mutex);
+			condition.wait (lock, [this] () { return count > 0; });
+			value = values[first];
+			first = (first + 1) % Capacity;
+			--count;
+		}
+		condition.notify_all ();
+		return value;
+	}
+
+private:
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::array<T, Capacity> values {};
+	size_t first {0};
+	size_t count {0};
+};
+
+//------------------------------------------------------------------------
+} // namespace mverb
@@ -0,0 +1,367 @@
+//  Copyright (c) 2022 Arne Scheffler
+//  This code is distributed under the terms of the GNU General Public License
+
+//  MVerb is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  at your option) any later version.
+//
+//  MVerb is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this MVerb.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "DenormalGuard.h"
+#include "MVerb.h"
+#include "blockqueue.h"
+#include "vstpreset.h"
+#include "wavfile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mverb {
+namespace {
+
+using Verb = MVerb<float>;
+
+constexpr size_t kNumBlocks = 4;
+
+//------------------------------------------------------------------------
+struct ParameterInfo
+{
+	const char* name;
+	double defaultValue;
+};
+
+// same defaults as the plug-in processor
+const std::array<ParameterInfo, Verb::NUM_PARAMS> parameterInfos = {{
+    {"damping", 0.},
+    {"density", 0.5},
+    {"bandwidth", 1.},
+    {"decay", 0.5},
+    {"predelay", 0.},
+    {"size", 0.5},
+    {"gain", 1.},
+    {"mix", 0.15},
+    {"earlymix", 0.75},
+}};
+
+//------------------------------------------------------------------------
+struct Options
+{
+	std::string inputPath;
+	std::string outputPath;
+	std::string presetPath;
+	std::array<std::optional<double>, Verb::NUM_PARAMS> overrides;
+	std::optional<SampleFormat> outputFormat;
+	size_t blockSize {4096};
+	double tailThresholdDB {-96.};
+	double tailHoldSeconds {0.1};
+	double maxTailSeconds {60.};
+	int rateDivider {1};
+};
+
+//------------------------------------------------------------------------
+struct Block
+{
+	std::array<std::vector<float>, 2> channels;
+	std::array<float*, 2> pointers;
+	size_t numFrames {0};
+
+	explicit Block (size_t blockSize)
+	{
+		for (auto channel = 0u; channel < channels.size (); ++channel)
+		{
+			channels[channel].resize (blockSize);
+			pointers[channel] = channels[channel].data ();
+		}
+	}
+};
+
+//------------------------------------------------------------------------
+void printUsage ()
+{
+	fprintf (stderr,
+	         "usage: mverb-render [options] input.wav output.wav\n"
+	         "\n"
+	         "  --preset FILE          load the parameters from an MVerb .vstpreset\n"
+	         "  --damping|--density|--bandwidth|--decay|--predelay|--size|--gain|--mix|--earlymix "
+	         "PERCENT\n"
+	         "                         set a parameter (0-100, overrides the preset)\n"
+	         "  --format FORMAT        output sample format: int16, int24, int32, float32, float64\n"
+	         "                         (default: same as input)\n"
+	         "  --block-size FRAMES    processing block size (default: 4096)\n"
+	         "  --tail-threshold DB    level the tail has to fall below (default: -96)\n"
+	         "  --tail-hold SECONDS    time the tail has to stay below the threshold (default: 0.1)\n"
+	         "  --max-tail SECONDS     upper limit for the rendered tail (default: 60)\n"
+	         "  --rate-divider N       run the reverb at 1/2 or 1/4 of the file rate, 0 picks it\n"
+	         "                         from the rate (default: 1)\n");
+}
+
+//------------------------------------------------------------------------
+bool parseNumber (const char* text, double& value)
+{
+	char* end = nullptr;
+	value = strtod (text, &end);
+	return end != text && *end == 0 && std::isfinite (value);
+}
+
+//------------------------------------------------------------------------
+std::optional<SampleFormat> parseSampleFormat (const std::string& text)
+{
+	if (text == "int16")
+		return SampleFormat::Int16;
+	if (text == "int24")
+		return SampleFormat::Int24;
+	if (text == "int32")
+		return SampleFormat::Int32;
+	if (text == "float32")
+		return SampleFormat::Float32;
+	if (text == "float64")
+		return SampleFormat::Float64;
+	return {};
+}
+
+//------------------------------------------------------------------------
+bool parseArguments (int argc, char* argv[], Options& options)
+{
+	std::vector<std::string> positional;
+	for (auto index = 1; index < argc; ++index)
+	{
+		std::string arg = argv[index];
+		if (arg.size () < 3 || arg.compare (0, 2, "--") != 0)
+		{
+			positional.push_back (arg);
+			continue;
+		}
+		if (index + 1 >= argc)
+		{
+			fprintf (stderr, "missing value for %s\n", arg.data ());
+			return false;
+		}
+		auto name = arg.substr (2);
+		const char* value = argv[++index];
+		double number = 0.;
+		if (name == "preset")
+			options.presetPath = value;
+		else if (name == "format")
+		{
+			options.outputFormat = parseSampleFormat (value);
+			if (!options.outputFormat)
+			{
+				fprintf (stderr, "unknown sample format '%s'\n", value);
+				return false;
+			}
+		}
+		else if (!parseNumber (value, number))
+		{
+			fprintf (stderr, "invalid value '%s' for %s\n", value, arg.data ());
+			return false;
+		}
+		else if (name == "block-size" && number >= 1.)
+			options.blockSize = static_cast<size_t> (number);
+		else if (name == "tail-threshold")
+			options.tailThresholdDB = number;
+		else if (name == "tail-hold" && number >= 0.)
+			options.tailHoldSeconds = number;
+		else if (name == "max-tail" && number >= 0.)
+			options.maxTailSeconds = number;
+		else if (name == "rate-divider" && (number == 0. || number == 1. || number == 2. || number == 4.))
+			options.rateDivider = static_cast<int> (number);
+		else
+		{
+			auto it = std::find_if (parameterInfos.begin (), parameterInfos.end (),
+			                        [&] (const auto& info) { return name == info.name; });
+			if (it == parameterInfos.end () || number < 0. || number > 100.)
+			{
+				fprintf (stderr, "unknown option or value out of range: %s %s\n", arg.data (), value);
+				return false;
+			}
+			options.overrides[std::distance (parameterInfos.begin (), it)] = number / 100.;
+		}
+	}
+	if (positional.size () != 2)
+		return false;
+	options.inputPath = positional[0];
+	options.outputPath = positional[1];
+	return true;
+}
+
+//------------------------------------------------------------------------
+int render (const Options& options)
+{
+	std::string error;
+
+	ParameterValues values;
+	for (auto index = 0u; index < values.size (); ++index)
+		values[index] = parameterInfos[index].defaultValue;
+	if (!options.presetPath.empty () && !loadVstPreset (options.presetPath, values, error))
+	{
+		fprintf (stderr, "%s\n", error.data ());
+		return 1;
+	}
+	for (auto index = 0u; index < values.size (); ++index)
+	{
+		if (options.overrides[index])
+			values[index] = *options.overrides[index];
+	}
+
+	auto reader = WavReader::open (options.inputPath, error);
+	if (!reader)
+	{
+		fprintf (stderr, "%s\n", error.data ());
+		return 1;
+	}
+	auto inputFormat = reader->getFormat ();
+	if (inputFormat.numChannels > 2)
+	{
+		fprintf (stderr, "only mono and stereo input files are supported\n");
+		return 1;
+	}
+
+	WavFormat outputFormat = inputFormat;
+	outputFormat.numChannels = 2;
+	if (options.outputFormat)
+		outputFormat.sampleFormat = *options.outputFormat;
+	auto writer = WavWriter::create (options.outputPath, outputFormat, error);
+	if (!writer)
+	{
+		fprintf (stderr, "%s\n", error.data ());
+		return 1;
+	}
+
+	DenormalGuard denormalGuard;
+	auto verb = std::make_unique<Verb> ();
+	// a mono file runs the mono to stereo kernel, the reader only fills the first channel
+	verb->setChannels (static_cast<int> (inputFormat.numChannels), 2);
+	auto sampleRate = static_cast<float> (inputFormat.sampleRate);
+	for (auto index = 0u; index < values.size (); ++index)
+		verb->setParameter (index, static_cast<float> (values[index]));
+	verb->setSampleRate (sampleRate,
+	                     options.rateDivider ? options.rateDivider : Verb::getDefaultRateDivider (sampleRate), true);
+	{
+		// the smoothers start from zero and ramp over the first process call, run them to their
+		// targets on one silent frame so the whole file is rendered with the final settings
+		float silence[2] = {};
+		float* channels[2] = {&silence[0], &silence[1]};
+		verb->process (channels, channels, 1);
+	}
+
+	std::vector<Block> blocks;
+	blocks.reserve (kNumBlocks);
+	BlockQueue<Block*, kNumBlocks> freeBlocks, toProcess, toWrite;
+	for (auto index = 0u; index < kNumBlocks; ++index)
+	{
+		blocks.emplace_back (options.blockSize);
+		freeBlocks.push (&blocks.back ());
+	}
+
+	auto startTime = std::chrono::steady_clock::now ();
+
+	std::thread readerThread ([&] () {
+		while (true)
+		{
+			auto block = freeBlocks.pop ();
+			block->numFrames = reader->read (block->pointers.data (), options.blockSize);
+			if (block->numFrames == 0)
+			{
+				freeBlocks.push (block);
+				toProcess.push (nullptr);
+				break;
+			}
+			toProcess.push (block);
+		}
+	});
+
+	bool writeFailed = false;
+	std::thread writerThread ([&] () {
+		while (auto block = toWrite.pop ())
+		{
+			if (!writeFailed && !writer->write (block->pointers.data (), block->numFrames))
+				writeFailed = true;
+			freeBlocks.push (block);
+		}
+	});
+
+	while (auto block = toProcess.pop ())
+	{
+		verb->process (block->pointers.data (), block->pointers.data (),
+		               static_cast<int> (block->numFrames));
+		toWrite.push (block);
+	}
+
+	// keep feeding silence until the tail stayed below the threshold for the hold time
+	auto threshold = static_cast<float> (std::pow (10., options.tailThresholdDB / 20.));
+	auto holdFrames = static_cast<size_t> (options.tailHoldSeconds * inputFormat.sampleRate);
+	auto maxTailFrames = static_cast<size_t> (options.maxTailSeconds * inputFormat.sampleRate);
+	size_t tailFrames = 0;
+	size_t silentFrames = 0;
+	while (tailFrames < maxTailFrames && silentFrames < holdFrames)
+	{
+		auto block = freeBlocks.pop ();
+		block->numFrames = std::min (options.blockSize, maxTailFrames - tailFrames);
+		for (auto& channel : block->channels)
+			std::fill_n (channel.begin (), block->numFrames, 0.f);
+		verb->process (block->pointers.data (), block->pointers.data (),
+		               static_cast<int> (block->numFrames));
+		for (auto i = 0u; i < block->numFrames && silentFrames < holdFrames; ++i)
+		{
+			if (std::abs (block->channels[0][i]) < threshold && std::abs (block->channels[1][i]) < threshold)
+				++silentFrames;
+			else
+				silentFrames = 0;
+			if (silentFrames == holdFrames)
+				block->numFrames = i + 1;
+		}
+		tailFrames += block->numFrames;
+		toWrite.push (block);
+	}
+	toWrite.push (nullptr);
+
+	readerThread.join ();
+	writerThread.join ();
+
+	if (writeFailed || !writer->close ())
+	{
+		fprintf (stderr, "could not write '%s'\n", options.outputPath.data ());
+		return 1;
+	}
+
+	auto elapsed = std::chrono::duration<double> (std::chrono::steady_clock::now () - startTime).count ();
+	auto inputSeconds = static_cast<double> (reader->getNumFrames ()) / inputFormat.sampleRate;
+	auto tailSeconds = static_cast<double> (tailFrames) / inputFormat.sampleRate;
+	printf ("%s: %.2f s input + %.2f s tail rendered in %.3f s (%.1fx realtime)\n",
+	        options.outputPath.data (), inputSeconds, tailSeconds, elapsed,
+	        elapsed > 0. ? (inputSeconds + tailSeconds) / elapsed : 0.);
+#if MVERB_COUNT_SUBNORMALS
+	printf ("%lu subnormal samples reached the delay lines\n", verb->getSubnormalCount ());
+#endif
+	return 0;
+}
+
+//------------------------------------------------------------------------
+} // anonymous
+} // namespace mverb
+
+//------------------------------------------------------------------------
+int main (int argc, char* argv[])
+{
+	mverb::Options options;
+	if (!mverb::parseArguments (argc, argv, options))
+	{
+		mverb::printUsage ();
+		return 1;
+	}
+	return mverb::render (options);
+}
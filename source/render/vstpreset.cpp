@@ -0,0 +1,167 @@
+//  Copyright (c) 2022 Arne Scheffler
+//  This code is distributed under the terms of the GNU General Public License
+
+//  MVerb is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  at your option) any later version.
+//
+//  MVerb is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this MVerb.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "vstpreset.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace mverb {
+namespace {
+
+// must match kMVerbProcessorUID in vst3/cids.h
+constexpr const char* kProcessorClassID = "B2D18CA401105C1AB7F76B14FEE77D9C";
+
+constexpr size_t kPresetHeaderSize = 48;
+constexpr size_t kChunkListEntrySize = 20;
+constexpr size_t kFxBankHeaderSize = 156;
+constexpr size_t kFxProgramHeaderSize = 56;
+
+//------------------------------------------------------------------------
+inline uint32_t readBE32 (const uint8_t* p)
+{
+	return (static_cast<uint32_t> (p[0]) << 24) | (static_cast<uint32_t> (p[1]) << 16) |
+	       (static_cast<uint32_t> (p[2]) << 8) | static_cast<uint32_t> (p[3]);
+}
+
+//------------------------------------------------------------------------
+inline int64_t readLE64 (const uint8_t* p)
+{
+	uint64_t value = 0;
+	for (auto i = 7; i >= 0; --i)
+		value = (value << 8) | p[i];
+	return static_cast<int64_t> (value);
+}
+
+//------------------------------------------------------------------------
+inline uint32_t readLE32 (const uint8_t* p)
+{
+	return static_cast<uint32_t> (p[0]) | (static_cast<uint32_t> (p[1]) << 8) |
+	       (static_cast<uint32_t> (p[2]) << 16) | (static_cast<uint32_t> (p[3]) << 24);
+}
+
+//------------------------------------------------------------------------
+bool readFile (const std::string& path, std::vector<uint8_t>& content)
+{
+	auto file = fopen (path.data (), "rb");
+	if (!file)
+		return false;
+	uint8_t buffer[4096];
+	size_t count;
+	while ((count = fread (buffer, 1, sizeof (buffer), file)) > 0)
+		content.insert (content.end (), buffer, buffer + count);
+	fclose (file);
+	return true;
+}
+
+//------------------------------------------------------------------------
+bool parseVst2State (const uint8_t* data, size_t size, ParameterValues& values)
+{
+	// optional VST3 wrapper header with the bypass state
+	if (size >= 8 && memcmp (data, "VstW", 4) == 0)
+	{
+		auto headerSize = 8 + static_cast<size_t> (readBE32 (data + 4));
+		if (headerSize > size)
+			return false;
+		data += headerSize;
+		size -= headerSize;
+	}
+	if (size < 12 || memcmp (data, "CcnK", 4) != 0)
+		return false;
+	if (memcmp (data + 8, "FxBk", 4) == 0)
+	{
+		// regular bank, use the first program
+		if (size < kFxBankHeaderSize)
+			return false;
+		data += kFxBankHeaderSize;
+		size -= kFxBankHeaderSize;
+		if (size < 12 || memcmp (data, "CcnK", 4) != 0)
+			return false;
+	}
+	if (memcmp (data + 8, "FxCk", 4) != 0 || size < kFxProgramHeaderSize)
+		return false;
+	if (memcmp (data + 16, "emVB", 4) != 0)
+		return false;
+	auto numParams = static_cast<size_t> (readBE32 (data + 24));
+	if (numParams < values.size () || size < kFxProgramHeaderSize + numParams * 4)
+		return false;
+	auto params = data + kFxProgramHeaderSize;
+	for (auto index = 0u; index < values.size (); ++index)
+	{
+		auto bits = readBE32 (params + index * 4);
+		float value;
+		memcpy (&value, &bits, sizeof (value));
+		values[index] = value;
+	}
+	return true;
+}
+
+//------------------------------------------------------------------------
+} // anonymous
+
+//------------------------------------------------------------------------
+bool loadVstPreset (const std::string& path, ParameterValues& values, std::string& error)
+{
+	std::vector<uint8_t> content;
+	if (!readFile (path, content))
+	{
+		error = "could not open '" + path + "'";
+		return false;
+	}
+	auto data = content.data ();
+	auto size = content.size ();
+	if (size < kPresetHeaderSize || memcmp (data, "VST3", 4) != 0)
+	{
+		error = "'" + path + "' is not a VST3 preset";
+		return false;
+	}
+	if (memcmp (data + 8, kProcessorClassID, 32) != 0)
+	{
+		error = "'" + path + "' is not an MVerb preset";
+		return false;
+	}
+
+	auto listOffset = static_cast<size_t> (readLE64 (data + 40));
+	if (listOffset + 8 > size || memcmp (data + listOffset, "List", 4) != 0)
+	{
+		error = "corrupt chunk list in '" + path + "'";
+		return false;
+	}
+	auto numEntries = static_cast<size_t> (readLE32 (data + listOffset + 4));
+	for (auto entry = 0u; entry < numEntries; ++entry)
+	{
+		auto entryData = data + listOffset + 8 + entry * kChunkListEntrySize;
+		if (entryData + kChunkListEntrySize > data + size)
+			break;
+		if (memcmp (entryData, "Comp", 4) != 0)
+			continue;
+		auto offset = static_cast<size_t> (readLE64 (entryData + 4));
+		auto chunkSize = static_cast<size_t> (readLE64 (entryData + 12));
+		if (offset + chunkSize > size || !parseVst2State (data + offset, chunkSize, values))
+		{
+			error = "unsupported component state in '" + path + "'";
+			return false;
+		}
+		return true;
+	}
+	error = "no component state in '" + path + "'";
+	return false;
+}
+
+//------------------------------------------------------------------------
+} // namespace mverb
@@ -0,0 +1,38 @@
+//  Copyright (c) 2022 Arne Scheffler
+//  This code is distributed under the terms of the GNU General Public License
+
+//  MVerb is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  at your option) any later version.
+//
+//  MVerb is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this MVerb.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include "MVerb.h"
+
+#include <array>
+#include <string>
+
+namespace mverb {
+
+/** normalized parameter values in the order of MVerb's parameter enum */
+using ParameterValues = std::array<double, MVerb<float>::NUM_PARAMS>;
+
+//------------------------------------------------------------------------
+/** Load the parameter values from a .vstpreset file written by the MVerb plug-in.
+ *
+ *	Only the component state is read. It is the VST2 compatible fxBank/fxProgram chunk the
+ *	processor writes in getState (), values are stored normalized just like the plug-in sees them.
+ */
+bool loadVstPreset (const std::string& path, ParameterValues& values, std::string& error);
+
+//------------------------------------------------------------------------
+} // namespace mverb
@@ -0,0 +1,463 @@
+//  Copyright (c) 2022 Arne Scheffler
+//  This code is distributed under the terms of the GNU General Public License
+
+//  MVerb is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  at your option) any later version.
+//
+//  MVerb is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this MVerb.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "wavfile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace mverb {
+namespace {
+
+constexpr uint16_t kWaveFormatPCM = 1;
+constexpr uint16_t kWaveFormatIEEEFloat = 3;
+constexpr uint16_t kWaveFormatExtensible = 0xFFFE;
+
+//------------------------------------------------------------------------
+inline uint16_t readLE16 (const uint8_t* p)
+{
+	return static_cast<uint16_t> (p[0] | (p[1] << 8));
+}
+
+//------------------------------------------------------------------------
+inline uint32_t readLE32 (const uint8_t* p)
+{
+	return static_cast<uint32_t> (p[0]) | (static_cast<uint32_t> (p[1]) << 8) |
+	       (static_cast<uint32_t> (p[2]) << 16) | (static_cast<uint32_t> (p[3]) << 24);
+}
+
+//------------------------------------------------------------------------
+inline void writeLE16 (uint8_t* p, uint16_t value)
+{
+	p[0] = static_cast<uint8_t> (value);
+	p[1] = static_cast<uint8_t> (value >> 8);
+}
+
+//------------------------------------------------------------------------
+inline void writeLE32 (uint8_t* p, uint32_t value)
+{
+	p[0] = static_cast<uint8_t> (value);
+	p[1] = static_cast<uint8_t> (value >> 8);
+	p[2] = static_cast<uint8_t> (value >> 16);
+	p[3] = static_cast<uint8_t> (value >> 24);
+}
+
+//------------------------------------------------------------------------
+inline float decodeSample (const uint8_t* p, SampleFormat format)
+{
+	switch (format)
+	{
+		case SampleFormat::Int16:
+			return static_cast<int16_t> (readLE16 (p)) * (1.f / 32768.f);
+		case SampleFormat::Int24:
+		{
+			auto bits = (static_cast<uint32_t> (p[0]) << 8) | (static_cast<uint32_t> (p[1]) << 16) |
+			            (static_cast<uint32_t> (p[2]) << 24);
+			auto value = static_cast<int32_t> (bits) >> 8;
+			return value * (1.f / 8388608.f);
+		}
+		case SampleFormat::Int32:
+			return static_cast<float> (static_cast<int32_t> (readLE32 (p)) * (1. / 2147483648.));
+		case SampleFormat::Float32:
+		{
+			float value;
+			auto bits = readLE32 (p);
+			memcpy (&value, &bits, sizeof (value));
+			return value;
+		}
+		case SampleFormat::Float64:
+		{
+			double value;
+			uint64_t bits = readLE32 (p) | (static_cast<uint64_t> (readLE32 (p + 4)) << 32);
+			memcpy (&value, &bits, sizeof (value));
+			return static_cast<float> (value);
+		}
+	}
+	return 0.f;
+}
+
+//------------------------------------------------------------------------
+inline int32_t quantize (float value, double scale, double maxValue)
+{
+	auto scaled = std::round (static_cast<double> (value) * scale);
+	return static_cast<int32_t> (std::clamp (scaled, -scale, maxValue));
+}
+
+//------------------------------------------------------------------------
+inline void encodeSample (uint8_t* p, float value, SampleFormat format)
+{
+	switch (format)
+	{
+		case SampleFormat::Int16:
+			writeLE16 (p, static_cast<uint16_t> (quantize (value, 32768., 32767.)));
+			break;
+		case SampleFormat::Int24:
+		{
+			auto bits = static_cast<uint32_t> (quantize (value, 8388608., 8388607.));
+			p[0] = static_cast<uint8_t> (bits);
+			p[1] = static_cast<uint8_t> (bits >> 8);
+			p[2] = static_cast<uint8_t> (bits >> 16);
+			break;
+		}
+		case SampleFormat::Int32:
+			writeLE32 (p, static_cast<uint32_t> (quantize (value, 2147483648., 2147483647.)));
+			break;
+		case SampleFormat::Float32:
+		{
+			uint32_t bits;
+			memcpy (&bits, &value, sizeof (bits));
+			writeLE32 (p, bits);
+			break;
+		}
+		case SampleFormat::Float64:
+		{
+			double wide = value;
+			uint64_t bits;
+			memcpy (&bits, &wide, sizeof (bits));
+			writeLE32 (p, static_cast<uint32_t> (bits));
+			writeLE32 (p + 4, static_cast<uint32_t> (bits >> 32));
+			break;
+		}
+	}
+}
+
+//------------------------------------------------------------------------
+template<SampleFormat Format>
+void deinterleave (const uint8_t* src, float* const* channels, size_t numChannels, size_t numFrames,
+                   size_t bytesPerSample)
+{
+	for (size_t frame = 0; frame < numFrames; ++frame)
+	{
+		for (size_t channel = 0; channel < numChannels; ++channel)
+		{
+			channels[channel][frame] = decodeSample (src, Format);
+			src += bytesPerSample;
+		}
+	}
+}
+
+//------------------------------------------------------------------------
+template<SampleFormat Format>
+void interleave (const float* const* channels, uint8_t* dst, size_t numChannels, size_t numFrames,
+                 size_t bytesPerSample)
+{
+	for (size_t frame = 0; frame < numFrames; ++frame)
+	{
+		for (size_t channel = 0; channel < numChannels; ++channel)
+		{
+			encodeSample (dst, channels[channel][frame], Format);
+			dst += bytesPerSample;
+		}
+	}
+}
+
+//------------------------------------------------------------------------
+} // anonymous
+
+//------------------------------------------------------------------------
+uint32_t WavFormat::bytesPerSample () const
+{
+	switch (sampleFormat)
+	{
+		case SampleFormat::Int16: return 2;
+		case SampleFormat::Int24: return 3;
+		case SampleFormat::Int32: return 4;
+		case SampleFormat::Float32: return 4;
+		case SampleFormat::Float64: return 8;
+	}
+	return 0;
+}
+
+//------------------------------------------------------------------------
+// MappedFile
+//------------------------------------------------------------------------
+MappedFile::~MappedFile ()
+{
+#if defined(_WIN32)
+	if (bytes)
+		UnmapViewOfFile (bytes);
+	if (mappingHandle)
+		CloseHandle (mappingHandle);
+	if (fileHandle)
+		CloseHandle (fileHandle);
+#else
+	if (bytes)
+		munmap (const_cast<uint8_t*> (bytes), numBytes);
+#endif
+}
+
+//------------------------------------------------------------------------
+bool MappedFile::open (const std::string& path)
+{
+#if defined(_WIN32)
+	fileHandle = CreateFileA (path.data (), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+	                          FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+	{
+		fileHandle = nullptr;
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx (fileHandle, &fileSize) || fileSize.QuadPart == 0)
+		return false;
+	mappingHandle = CreateFileMappingA (fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mappingHandle)
+		return false;
+	bytes = static_cast<const uint8_t*> (MapViewOfFile (mappingHandle, FILE_MAP_READ, 0, 0, 0));
+	numBytes = static_cast<uint64_t> (fileSize.QuadPart);
+	return bytes != nullptr;
+#else
+	auto fd = ::open (path.data (), O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat info;
+	if (fstat (fd, &info) != 0 || info.st_size == 0)
+	{
+		::close (fd);
+		return false;
+	}
+	auto address = mmap (nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close (fd);
+	if (address == MAP_FAILED)
+		return false;
+	// the file is consumed front to back exactly once, let the kernel read ahead aggressively
+	madvise (address, info.st_size, MADV_SEQUENTIAL);
+	bytes = static_cast<const uint8_t*> (address);
+	numBytes = static_cast<uint64_t> (info.st_size);
+	return true;
+#endif
+}
+
+//------------------------------------------------------------------------
+// WavReader
+//------------------------------------------------------------------------
+std::unique_ptr<WavReader> WavReader::open (const std::string& path, std::string& error)
+{
+	std::unique_ptr<WavReader> reader (new WavReader);
+	if (!reader->file.open (path))
+	{
+		error = "could not open '" + path + "'";
+		return nullptr;
+	}
+	auto data = reader->file.data ();
+	auto size = reader->file.size ();
+	if (size < 12 || memcmp (data, "RIFF", 4) != 0 || memcmp (data + 8, "WAVE", 4) != 0)
+	{
+		error = "'" + path + "' is not a WAV file";
+		return nullptr;
+	}
+
+	bool haveFormat = false;
+	uint64_t offset = 12;
+	while (offset + 8 <= size)
+	{
+		auto chunkID = data + offset;
+		uint64_t chunkSize = readLE32 (data + offset + 4);
+		auto chunkData = data + offset + 8;
+		if (offset + 8 + chunkSize > size)
+			chunkSize = size - offset - 8;
+
+		if (memcmp (chunkID, "fmt ", 4) == 0 && chunkSize >= 16)
+		{
+			auto formatTag = readLE16 (chunkData);
+			auto numChannels = readLE16 (chunkData + 2);
+			auto sampleRate = readLE32 (chunkData + 4);
+			auto bitsPerSample = readLE16 (chunkData + 14);
+			if (formatTag == kWaveFormatExtensible && chunkSize >= 26)
+				formatTag = readLE16 (chunkData + 24);
+
+			auto& format = reader->format;
+			format.numChannels = numChannels;
+			format.sampleRate = sampleRate;
+			if (formatTag == kWaveFormatPCM && bitsPerSample == 16)
+				format.sampleFormat = SampleFormat::Int16;
+			else if (formatTag == kWaveFormatPCM && bitsPerSample == 24)
+				format.sampleFormat = SampleFormat::Int24;
+			else if (formatTag == kWaveFormatPCM && bitsPerSample == 32)
+				format.sampleFormat = SampleFormat::Int32;
+			else if (formatTag == kWaveFormatIEEEFloat && bitsPerSample == 32)
+				format.sampleFormat = SampleFormat::Float32;
+			else if (formatTag == kWaveFormatIEEEFloat && bitsPerSample == 64)
+				format.sampleFormat = SampleFormat::Float64;
+			else
+			{
+				error = "unsupported sample format in '" + path + "'";
+				return nullptr;
+			}
+			if (numChannels == 0 || sampleRate == 0)
+			{
+				error = "invalid format chunk in '" + path + "'";
+				return nullptr;
+			}
+			haveFormat = true;
+		}
+		else if (memcmp (chunkID, "data", 4) == 0)
+		{
+			if (!haveFormat)
+			{
+				error = "data chunk before format chunk in '" + path + "'";
+				return nullptr;
+			}
+			auto frameSize = reader->format.bytesPerSample () * reader->format.numChannels;
+			reader->sampleData = chunkData;
+			reader->numFrames = chunkSize / frameSize;
+			return reader;
+		}
+		offset += 8 + chunkSize + (chunkSize & 1);
+	}
+	error = "no audio data found in '" + path + "'";
+	return nullptr;
+}
+
+//------------------------------------------------------------------------
+size_t WavReader::read (float* const* channels, size_t numFramesToRead)
+{
+	auto count = static_cast<size_t> (std::min<uint64_t> (numFramesToRead, numFrames - position));
+	auto bytesPerSample = format.bytesPerSample ();
+	auto src = sampleData + position * bytesPerSample * format.numChannels;
+	switch (format.sampleFormat)
+	{
+		case SampleFormat::Int16:
+			deinterleave<SampleFormat::Int16> (src, channels, format.numChannels, count, bytesPerSample);
+			break;
+		case SampleFormat::Int24:
+			deinterleave<SampleFormat::Int24> (src, channels, format.numChannels, count, bytesPerSample);
+			break;
+		case SampleFormat::Int32:
+			deinterleave<SampleFormat::Int32> (src, channels, format.numChannels, count, bytesPerSample);
+			break;
+		case SampleFormat::Float32:
+			deinterleave<SampleFormat::Float32> (src, channels, format.numChannels, count, bytesPerSample);
+			break;
+		case SampleFormat::Float64:
+			deinterleave<SampleFormat::Float64> (src, channels, format.numChannels, count, bytesPerSample);
+			break;
+	}
+	position += count;
+	return count;
+}
+
+//------------------------------------------------------------------------
+// WavWriter
+//------------------------------------------------------------------------
+WavWriter::~WavWriter ()
+{
+	close ();
+}
+
+//------------------------------------------------------------------------
+std::unique_ptr<WavWriter> WavWriter::create (const std::string& path, const WavFormat& format,
+                                              std::string& error)
+{
+	std::unique_ptr<WavWriter> writer (new WavWriter);
+	writer->format = format;
+	writer->file = fopen (path.data (), "wb");
+	if (!writer->file)
+	{
+		error = "could not create '" + path + "'";
+		return nullptr;
+	}
+	setvbuf (writer->file, nullptr, _IOFBF, 1 << 20);
+	if (!writer->writeHeader (0))
+	{
+		error = "could not write to '" + path + "'";
+		return nullptr;
+	}
+	return writer;
+}
+
+//------------------------------------------------------------------------
+bool WavWriter::writeHeader (uint64_t dataSize)
+{
+	auto isFloat =
+	    format.sampleFormat == SampleFormat::Float32 || format.sampleFormat == SampleFormat::Float64;
+	auto bytesPerSample = format.bytesPerSample ();
+	auto blockAlign = bytesPerSample * format.numChannels;
+	auto riffSize = std::min<uint64_t> (dataSize + 36, 0xFFFFFFFFu);
+
+	uint8_t header[44];
+	memcpy (header, "RIFF", 4);
+	writeLE32 (header + 4, static_cast<uint32_t> (riffSize));
+	memcpy (header + 8, "WAVE", 4);
+	memcpy (header + 12, "fmt ", 4);
+	writeLE32 (header + 16, 16);
+	writeLE16 (header + 20, isFloat ? kWaveFormatIEEEFloat : kWaveFormatPCM);
+	writeLE16 (header + 22, format.numChannels);
+	writeLE32 (header + 24, format.sampleRate);
+	writeLE32 (header + 28, format.sampleRate * blockAlign);
+	writeLE16 (header + 32, static_cast<uint16_t> (blockAlign));
+	writeLE16 (header + 34, static_cast<uint16_t> (bytesPerSample * 8));
+	memcpy (header + 36, "data", 4);
+	writeLE32 (header + 40, static_cast<uint32_t> (std::min<uint64_t> (dataSize, 0xFFFFFFFFu)));
+	return fwrite (header, sizeof (header), 1, file) == 1;
+}
+
+//------------------------------------------------------------------------
+bool WavWriter::write (const float* const* channels, size_t numFrames)
+{
+	auto bytesPerSample = format.bytesPerSample ();
+	scratch.resize (numFrames * bytesPerSample * format.numChannels);
+	auto dst = scratch.data ();
+	switch (format.sampleFormat)
+	{
+		case SampleFormat::Int16:
+			interleave<SampleFormat::Int16> (channels, dst, format.numChannels, numFrames, bytesPerSample);
+			break;
+		case SampleFormat::Int24:
+			interleave<SampleFormat::Int24> (channels, dst, format.numChannels, numFrames, bytesPerSample);
+			break;
+		case SampleFormat::Int32:
+			interleave<SampleFormat::Int32> (channels, dst, format.numChannels, numFrames, bytesPerSample);
+			break;
+		case SampleFormat::Float32:
+			interleave<SampleFormat::Float32> (channels, dst, format.numChannels, numFrames, bytesPerSample);
+			break;
+		case SampleFormat::Float64:
+			interleave<SampleFormat::Float64> (channels, dst, format.numChannels, numFrames, bytesPerSample);
+			break;
+	}
+	numFramesWritten += numFrames;
+	return fwrite (scratch.data (), 1, scratch.size (), file) == scratch.size ();
+}
+
+//------------------------------------------------------------------------
+bool WavWriter::close ()
+{
+	if (!file)
+		return true;
+	auto dataSize = numFramesWritten * format.bytesPerSample () * format.numChannels;
+	bool result = true;
+	if (dataSize & 1)
+		result = fputc (0, file) != EOF;
+	result = result && fseek (file, 0, SEEK_SET) == 0 && writeHeader (dataSize);
+	result = (fclose (file) == 0) && result;
+	file = nullptr;
+	return result;
+}
+
+//------------------------------------------------------------------------
+} // namespace mverb
@@ -0,0 +1,122 @@
+//  Copyright (c) 2022 Arne Scheffler
+//  This code is distributed under the terms of the GNU General Public License
+
+//  MVerb is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  at your option) any later version.
+//
+//  MVerb is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this MVerb.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mverb {
+
+//------------------------------------------------------------------------
+enum class SampleFormat
+{
+	Int16,
+	Int24,
+	Int32,
+	Float32,
+	Float64,
+};
+
+//------------------------------------------------------------------------
+struct WavFormat
+{
+	SampleFormat sampleFormat {SampleFormat::Float32};
+	uint32_t sampleRate {44100};
+	uint16_t numChannels {2};
+
+	uint32_t bytesPerSample () const;
+};
+
+//------------------------------------------------------------------------
+/** Read only memory mapping of a whole file. */
+class MappedFile
+{
+public:
+	MappedFile () = default;
+	~MappedFile ();
+	MappedFile (const MappedFile&) = delete;
+	MappedFile& operator= (const MappedFile&) = delete;
+
+	bool open (const std::string& path);
+
+	const uint8_t* data () const { return bytes; }
+	uint64_t size () const { return numBytes; }
+
+private:
+	const uint8_t* bytes {nullptr};
+	uint64_t numBytes {0};
+#if defined(_WIN32)
+	void* fileHandle {nullptr};
+	void* mappingHandle {nullptr};
+#endif
+};
+
+//------------------------------------------------------------------------
+/** WAV file reader working directly on a memory mapping of the file.
+ *
+ *	Supports 16/24/32 bit integer and 32/64 bit float PCM, including WAVE_FORMAT_EXTENSIBLE.
+ */
+class WavReader
+{
+public:
+	static std::unique_ptr<WavReader> open (const std::string& path, std::string& error);
+
+	const WavFormat& getFormat () const { return format; }
+	uint64_t getNumFrames () const { return numFrames; }
+
+	/** read up to numFrames frames deinterleaved into channels, returns the number of frames read */
+	size_t read (float* const* channels, size_t numFrames);
+
+private:
+	MappedFile file;
+	WavFormat format;
+	const uint8_t* sampleData {nullptr};
+	uint64_t numFrames {0};
+	uint64_t position {0};
+};
+
+//------------------------------------------------------------------------
+/** WAV file writer. The header is patched with the final sizes in close (). */
+class WavWriter
+{
+public:
+	~WavWriter ();
+
+	static std::unique_ptr<WavWriter> create (const std::string& path, const WavFormat& format,
+	                                          std::string& error);
+
+	const WavFormat& getFormat () const { return format; }
+
+	bool write (const float* const* channels, size_t numFrames);
+	bool close ();
+
+private:
+	WavWriter () = default;
+
+	bool writeHeader (uint64_t dataSize);
+
+	FILE* file {nullptr};
+	WavFormat format;
+	uint64_t numFramesWritten {0};
+	std::vector<uint8_t> scratch;
+};
+
+//------------------------------------------------------------------------
+} // namespace mverb
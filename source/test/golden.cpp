@@ -0,0 +1,1193 @@
+//  Copyright (c) 2022 Arne Scheffler
+//  This code is distributed under the terms of the GNU General Public License
+
+//  MVerb is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  at your option) any later version.
+//
+//  MVerb is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this MVerb.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "DenormalGuard.h"
+#include "MVerb.h"
+#include "MVerbBatch.h"
+#include "MVerbDispatch.h"
+#include "MVerbSurround.h"
+#include "bench/results.h"
+#include "render/vstpreset.h"
+#include "test/MVerbBaseline.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace mverb {
+namespace {
+
+//------------------------------------------------------------------------
+/* Golden output regression test.
+ *
+ *	Every engine type renders an impulse, a noise burst and a sine sweep for every preset, a grid of
+ *	parameter settings and a few automated settings. Full renders would make a huge reference, so each render is stored
+ *	as a fingerprint: a hash of the output samples (bit-exact mode), the level of every 100 ms
+ *	block, the level in third octave bands and the RT60 of the energy decay (tolerance mode).
+ *
+ *	Besides the float and double engines the reference holds the reduced rate, mono, surround,
+ *	TptLowpass and baseline types. The baseline types render the engine as it was before the
+ *	optimisations (MVerbBaseline.h), --baseline compares the current engines against them.
+ */
+
+constexpr double kSampleRate = 48000.;
+constexpr int kRenderLength = 3 * 48000;
+constexpr int kBlockSize = 256;
+constexpr int kLevelBlock = 4800;
+constexpr int kFFTSize = 4096;
+constexpr double kFloorDB = -140.;
+// levels further below the loudest block or band are dominated by rounding noise
+constexpr double kCompareRange = 60.;
+
+constexpr int kExitFailed = 1;
+constexpr int kExitUsage = 2;
+constexpr int kExitSkipped = 77;
+
+using MixedVerb = MVerb<float, MVerbNullProbe, WideStateVariable>;
+template<typename Storage>
+using StorageVerb = MVerb<float, MVerbNullProbe, OversampledStateVariable, Storage>;
+template<typename T>
+using TptVerb = MVerb<T, MVerbNullProbe, TptLowpass>;
+using SurroundVerb = MVerbSurround<double>;
+// L R C LFE Ls Rs, 7.1.4 adds the side and the top pairs
+const std::vector<int> layout51 = {SurroundVerb::SPEAKER_LEFT,   SurroundVerb::SPEAKER_RIGHT,
+                                   SurroundVerb::SPEAKER_CENTER, SurroundVerb::SPEAKER_LFE,
+                                   SurroundVerb::SPEAKER_LEFT,   SurroundVerb::SPEAKER_RIGHT};
+const std::vector<int> layout714 = {SurroundVerb::SPEAKER_LEFT,   SurroundVerb::SPEAKER_RIGHT,
+                                    SurroundVerb::SPEAKER_CENTER, SurroundVerb::SPEAKER_LFE,
+                                    SurroundVerb::SPEAKER_LEFT,   SurroundVerb::SPEAKER_RIGHT,
+                                    SurroundVerb::SPEAKER_LEFT,   SurroundVerb::SPEAKER_RIGHT,
+                                    SurroundVerb::SPEAKER_LEFT,   SurroundVerb::SPEAKER_RIGHT,
+                                    SurroundVerb::SPEAKER_LEFT,   SurroundVerb::SPEAKER_RIGHT};
+using BatchVerb = MVerbBatch<float, 4>;
+
+//------------------------------------------------------------------------
+struct EngineType
+{
+	const char* name;
+	const char* reference;
+};
+
+// the types with a reference of their own and the variants compared against another one: the mixed
+// engine sets up its delay lines in double and must match the double engine within the tolerances
+// (--check-mixed holds it to a tighter bound), the 16 bit delay storage and every lane of the batch
+// must match the float engine. The dispatched engine is the float engine built for another
+// instruction set and has to match it bit for bit.
+const EngineType engineTypes[] = {
+    {"float", "float"},
+    {"double", "double"},
+    {"reduced2", "reduced2"},
+    {"reduced4", "reduced4"},
+    {"mono-in", "mono-in"},
+    {"mono", "mono"},
+    {"surround", "surround"},
+    {"baseline-float", "baseline-float"},
+    {"baseline-double", "baseline-double"},
+    {"mixed", "double"},
+    {"half", "float"},
+    {"dispatch", "float"},
+    {"batch", "float"},
+    {"tpt-float", "tpt-float"},
+    {"tpt-double", "tpt-double"},
+};
+
+//------------------------------------------------------------------------
+const EngineType* findEngineType (const std::string& name)
+{
+	for (const auto& type : engineTypes)
+	{
+		if (name == type.name)
+			return &type;
+	}
+	return nullptr;
+}
+
+//------------------------------------------------------------------------
+/** a parameter change during the render, applied between two host blocks like the plug-in does */
+struct ParameterChange
+{
+	// the sample the change takes effect at, a multiple of kBlockSize
+	int position;
+	int index;
+	double value;
+};
+
+//------------------------------------------------------------------------
+struct Setting
+{
+	std::string name;
+	ParameterValues values;
+	std::vector<ParameterChange> changes {};
+	// samples of silence before the input
+	int inputDelay {0};
+};
+
+// normalized values in the order of MVerb's parameter enum:
+// damping, density, bandwidth, decay, predelay, size, gain, mix, earlymix
+const std::vector<Setting> gridSettings = {
+    {"grid-mid", {{0.25, 0.25, 0.5, 0.35, 0.25, 0.75, 0.75, 0.5, 0.5}}},
+    {"grid-small", {{0.5, 0.5, 1., 0.2, 0., 0.1, 1., 1., 0.5}}},
+    {"grid-large", {{0.2, 0.8, 0.9, 0.9, 0.2, 1., 1., 1., 0.75}}},
+    {"grid-dark", {{1., 0.3, 0.1, 0.6, 0.5, 0.6, 1., 1., 0.25}}},
+    {"grid-bright", {{0., 1., 1., 0.7, 0., 0.4, 1., 1., 1.}}},
+    {"grid-late", {{0.5, 0.5, 0.8, 0.5, 1., 0.5, 0.5, 1., 0.}}},
+};
+
+// automation, rendered like the other settings. Gain, mix and early mix change while the tail
+// rings and must follow the baseline. The baseline clears its tank for a new size where the current
+// engines crossfade it, so the size changes happen before the input: the tank has to end up with
+// the lengths and taps of the baseline.
+using Parameters = MVerb<float>;
+const std::vector<Setting> automationSettings = {
+    {"automation-gain-mix",
+     {{0.25, 0.25, 0.5, 0.35, 0.25, 0.75, 0.75, 0.5, 0.5}},
+     {{12288, Parameters::GAIN, 0.4},
+      {24064, Parameters::MIX, 1.},
+      {36096, Parameters::EARLYMIX, 0.2},
+      {48128, Parameters::GAIN, 1.},
+      {72192, Parameters::MIX, 0.3},
+      {72192, Parameters::EARLYMIX, 0.8}}},
+    {"automation-size", {{0.5, 0.5, 0.8, 0.5, 0.1, 0.9, 1., 1., 0.5}}, {{6144, Parameters::SIZE, 0.3}}, 24000},
+    {"automation-size-steps",
+     {{0.2, 0.8, 0.9, 0.7, 0., 0.2, 1., 1., 0.75}},
+     {{2560, Parameters::SIZE, 0.1}, {7680, Parameters::SIZE, 1.}, {12800, Parameters::SIZE, 0.6}},
+     24000},
+};
+
+// the plug-in's defaults, fully wet and without early reflections, which all channels of a side share
+const Setting decorrelationSetting = {"decorrelation", {{0., 0.5, 1., 0.5, 0., 0.5, 1., 1., 1.}}};
+
+//------------------------------------------------------------------------
+enum class Input
+{
+	Impulse,
+	Noise,
+	Sweep,
+};
+
+const char* inputName (Input input)
+{
+	switch (input)
+	{
+		case Input::Impulse: return "impulse";
+		case Input::Noise: return "noise";
+		case Input::Sweep: return "sweep";
+	}
+	return "";
+}
+
+//------------------------------------------------------------------------
+/** the same input for every engine type, computed in double and rounded to the sample type */
+std::vector<double> makeInput (Input input, int channel)
+{
+	std::vector<double> signal (kRenderLength, 0.);
+	switch (input)
+	{
+		case Input::Impulse:
+		{
+			signal[0] = 0.5;
+			break;
+		}
+		case Input::Noise:
+		{
+			// 250 ms of white noise, different for both channels
+			uint32_t state = 0x12345678u + static_cast<uint32_t> (channel) * 0x9e3779b9u;
+			for (auto index = 0; index < kRenderLength / 12; ++index)
+			{
+				state = state * 1664525u + 1013904223u;
+				signal[index] = 0.25 * (static_cast<double> (state >> 8) / 8388608. - 1.);
+			}
+			break;
+		}
+		case Input::Sweep:
+		{
+			// 1 s exponential sweep from 20 Hz to 20 kHz
+			constexpr double f0 = 20.;
+			constexpr double f1 = 20000.;
+			const auto length = static_cast<int> (kSampleRate);
+			const auto rate = std::log (f1 / f0);
+			for (auto index = 0; index < length; ++index)
+			{
+				auto t = index / kSampleRate;
+				auto phase = 2. * M_PI * f0 * (std::exp (t * rate) - 1.) / rate;
+				signal[index] = 0.5 * std::sin (phase);
+			}
+			break;
+		}
+	}
+	return signal;
+}
+
+//------------------------------------------------------------------------
+struct Render
+{
+	std::vector<std::vector<double>> channels;
+	uint64_t hash {14695981039346656037ull};
+
+	void hashBytes (const void* data, size_t size)
+	{
+		auto bytes = static_cast<const unsigned char*> (data);
+		for (size_t index = 0; index < size; ++index)
+		{
+			hash ^= bytes[index];
+			hash *= 1099511628211ull;
+		}
+	}
+};
+
+//------------------------------------------------------------------------
+/** renders like the plug-in: one frame to settle the smoothers, then host blocks. Input channel c
+ *	gets the signal of channel c % 2 or silence if bit c of silentInputs is set, process (inputs,
+ *	outputs, numSamples) runs the engine and setParameter (index, value) applies the changes of the
+ *	setting before the block they are due with. */
+template<typename Sample, typename Process, typename SetParameter>
+Render renderChannels (const Setting& setting, Input input, int numInputs, int numOutputs, Process process,
+                       SetParameter setParameter, unsigned silentInputs = 0)
+{
+	std::vector<std::vector<Sample>> inputs (numInputs, std::vector<Sample> (kRenderLength));
+	std::vector<std::vector<Sample>> outputs (numOutputs, std::vector<Sample> (kRenderLength));
+	for (auto channel = 0; channel < numInputs; ++channel)
+	{
+		if (silentInputs & (1u << channel))
+			continue;
+		auto signal = makeInput (input, channel % 2);
+		std::copy (signal.begin (), signal.end () - setting.inputDelay,
+		           inputs[channel].begin () + setting.inputDelay);
+	}
+
+	std::vector<Sample> silence (std::max (numInputs, numOutputs));
+	std::vector<Sample*> inputPointers (numInputs);
+	std::vector<Sample*> outputPointers (numOutputs);
+	for (auto channel = 0; channel < numInputs; ++channel)
+		inputPointers[channel] = &silence[channel];
+	for (auto channel = 0; channel < numOutputs; ++channel)
+		outputPointers[channel] = &silence[channel];
+	process (inputPointers.data (), outputPointers.data (), 1);
+
+	for (auto position = 0; position < kRenderLength; position += kBlockSize)
+	{
+		for (const auto& change : setting.changes)
+		{
+			if (change.position == position)
+				setParameter (change.index, static_cast<float> (change.value));
+		}
+		auto numSamples = std::min (kBlockSize, kRenderLength - position);
+		for (auto channel = 0; channel < numInputs; ++channel)
+			inputPointers[channel] = inputs[channel].data () + position;
+		for (auto channel = 0; channel < numOutputs; ++channel)
+			outputPointers[channel] = outputs[channel].data () + position;
+		process (inputPointers.data (), outputPointers.data (), numSamples);
+	}
+
+	Render result;
+	for (const auto& output : outputs)
+	{
+		result.hashBytes (output.data (), output.size () * sizeof (Sample));
+		result.channels.emplace_back (output.begin (), output.end ());
+	}
+	return result;
+}
+
+//------------------------------------------------------------------------
+template<typename Verb>
+void setParameters (Verb& verb, const ParameterValues& values)
+{
+	for (auto index = 0; index < static_cast<int> (values.size ()); ++index)
+		verb.setParameter (index, static_cast<float> (values[index]));
+}
+
+//------------------------------------------------------------------------
+template<typename Sample, typename Verb>
+Render render (const Setting& setting, Input input, std::unique_ptr<Verb> verb = std::make_unique<Verb> ())
+{
+	DenormalGuard denormalGuard;
+	setParameters (*verb, setting.values);
+	verb->setSampleRate (static_cast<float> (kSampleRate));
+	return renderChannels<Sample> (
+	    setting, input, 2, 2, [&] (Sample** inputs, Sample** outputs, int n) { verb->process (inputs, outputs, n); },
+	    [&] (int index, float value) { verb->setParameter (index, value); });
+}
+
+//------------------------------------------------------------------------
+/** MVerb<float> with numInputs and numOutputs (see MVerb::setChannels), a divider above 1 runs the
+ *	tank and the early reflections at the reduced rate like the plug-in does */
+Render renderFloat (const Setting& setting, Input input, int divider, int numInputs, int numOutputs)
+{
+	DenormalGuard denormalGuard;
+	auto verb = std::make_unique<MVerb<float>> ();
+	verb->setChannels (numInputs, numOutputs);
+	setParameters (*verb, setting.values);
+	verb->setSampleRate (static_cast<float> (kSampleRate), divider, true);
+	return renderChannels<float> (
+	    setting, input, numInputs, numOutputs,
+	    [&] (float** inputs, float** outputs, int n) { verb->process (inputs, outputs, n); },
+	    [&] (int index, float value) { verb->setParameter (index, value); });
+}
+
+//------------------------------------------------------------------------
+/** MVerbSurround<double> on a layout (see MVerbSurround::setLayout), input channel c is silent if bit
+ *	c of silentInputs is set */
+Render renderSurround (const Setting& setting, Input input, const std::vector<int>& speakers,
+                       unsigned silentInputs = 0)
+{
+	DenormalGuard denormalGuard;
+	auto verb = std::make_unique<SurroundVerb> ();
+	verb->setLayout (speakers.data (), static_cast<int> (speakers.size ()));
+	setParameters (*verb, setting.values);
+	verb->setSampleRate (kSampleRate);
+	auto numChannels = verb->getNumChannels ();
+	return renderChannels<double> (
+	    setting, input, numChannels, numChannels,
+	    [&] (double** inputs, double** outputs, int n) { verb->process (inputs, outputs, n); },
+	    [&] (int index, double value) { verb->setParameter (index, value); }, silentInputs);
+}
+
+//------------------------------------------------------------------------
+/** every lane of MVerbBatch with the same setting and input, so each one has to follow the float
+ *	engine */
+Render renderBatch (const Setting& setting, Input input)
+{
+	DenormalGuard denormalGuard;
+	auto batch = std::make_unique<BatchVerb> ();
+	auto setParameter = [&] (int index, float value) {
+		for (auto lane = 0; lane < BatchVerb::NUM_LANES; ++lane)
+			batch->setParameter (lane, index, value);
+	};
+	for (auto lane = 0; lane < BatchVerb::NUM_LANES; ++lane)
+		batch->addLane ();
+	for (auto index = 0; index < static_cast<int> (setting.values.size ()); ++index)
+		setParameter (index, static_cast<float> (setting.values[index]));
+	batch->setSampleRate (static_cast<float> (kSampleRate));
+	constexpr auto numChannels = 2 * BatchVerb::NUM_LANES;
+	return renderChannels<float> (setting, input, numChannels, numChannels, [&] (float** inputs, float** outputs, int n) {
+		float** laneInputs[BatchVerb::NUM_LANES];
+		float** laneOutputs[BatchVerb::NUM_LANES];
+		for (auto lane = 0; lane < BatchVerb::NUM_LANES; ++lane)
+		{
+			laneInputs[lane] = inputs + 2 * lane;
+			laneOutputs[lane] = outputs + 2 * lane;
+		}
+		batch->process (laneInputs, laneOutputs, n);
+	}, setParameter);
+}
+
+//------------------------------------------------------------------------
+double toDB (double power) { return std::max (kFloorDB, 10. * std::log10 (power + 1e-30)); }
+
+//------------------------------------------------------------------------
+/** energy of all channels at index */
+double frameEnergy (const Render& render, int index)
+{
+	double energy = 0.;
+	for (const auto& channel : render.channels)
+		energy += channel[index] * channel[index];
+	return energy;
+}
+
+//------------------------------------------------------------------------
+std::vector<double> blockLevels (const Render& render)
+{
+	const auto numChannels = static_cast<double> (render.channels.size ());
+	std::vector<double> levels;
+	for (auto start = 0; start < kRenderLength; start += kLevelBlock)
+	{
+		double energy = 0.;
+		for (auto index = start; index < start + kLevelBlock; ++index)
+			energy += frameEnergy (render, index);
+		levels.push_back (toDB (energy / (numChannels * kLevelBlock)));
+	}
+	return levels;
+}
+
+//------------------------------------------------------------------------
+void fft (std::vector<std::complex<double>>& data)
+{
+	const auto size = data.size ();
+	for (size_t i = 1, j = 0; i < size; ++i)
+	{
+		auto bit = size >> 1;
+		for (; j & bit; bit >>= 1)
+			j ^= bit;
+		j ^= bit;
+		if (i < j)
+			std::swap (data[i], data[j]);
+	}
+	for (size_t length = 2; length <= size; length <<= 1)
+	{
+		auto angle = -2. * M_PI / static_cast<double> (length);
+		std::complex<double> step (std::cos (angle), std::sin (angle));
+		for (size_t start = 0; start < size; start += length)
+		{
+			std::complex<double> twiddle (1.);
+			for (size_t k = 0; k < length / 2; ++k)
+			{
+				auto even = data[start + k];
+				auto odd = data[start + k + length / 2] * twiddle;
+				data[start + k] = even + odd;
+				data[start + k + length / 2] = even - odd;
+				twiddle *= step;
+			}
+		}
+	}
+}
+
+//------------------------------------------------------------------------
+/** Welch power spectrum (Hann window, 50% overlap) summed into third octave bands from 25 Hz to 20 kHz,
+ *	scaled to a stereo pair */
+std::vector<double> bandLevels (const Render& render)
+{
+	std::vector<double> window (kFFTSize);
+	for (auto index = 0; index < kFFTSize; ++index)
+		window[index] = 0.5 - 0.5 * std::cos (2. * M_PI * index / kFFTSize);
+
+	std::vector<double> power (kFFTSize / 2 + 1, 0.);
+	std::vector<std::complex<double>> data (kFFTSize);
+	for (const auto& channel : render.channels)
+	{
+		for (auto start = 0; start + kFFTSize <= kRenderLength; start += kFFTSize / 2)
+		{
+			for (auto index = 0; index < kFFTSize; ++index)
+				data[index] = channel[start + index] * window[index];
+			fft (data);
+			for (size_t bin = 0; bin < power.size (); ++bin)
+				power[bin] += std::norm (data[bin]);
+		}
+	}
+
+	std::vector<double> levels;
+	constexpr auto numBands = 30;
+	for (auto band = 0; band < numBands; ++band)
+	{
+		auto center = 25. * std::pow (2., band / 3.);
+		auto low = center * std::pow (2., -1. / 6.);
+		auto high = center * std::pow (2., 1. / 6.);
+		double sum = 0.;
+		for (size_t bin = 1; bin < power.size (); ++bin)
+		{
+			auto frequency = bin * kSampleRate / kFFTSize;
+			if (frequency >= low && frequency < high)
+				sum += power[bin];
+		}
+		levels.push_back (toDB (sum * 2. / render.channels.size () / (kFFTSize * kFFTSize)));
+	}
+	return levels;
+}
+
+//------------------------------------------------------------------------
+/** Schroeder backward integration, T30 fit (T20 if the decay does not reach -35 dB), 0 if neither */
+double rt60 (const Render& render)
+{
+	std::vector<double> decay (kRenderLength);
+	double energy = 0.;
+	for (auto index = kRenderLength - 1; index >= 0; --index)
+	{
+		energy += frameEnergy (render, index);
+		decay[index] = energy;
+	}
+	if (energy <= 0.)
+		return 0.;
+	for (auto& value : decay)
+		value = 10. * std::log10 (value / energy + 1e-30);
+
+	auto fit = [&] (double top, double bottom) {
+		double sumX = 0., sumY = 0., sumXX = 0., sumXY = 0.;
+		auto count = 0;
+		for (auto index = 0; index < kRenderLength; ++index)
+		{
+			if (decay[index] > top)
+				continue;
+			if (decay[index] < bottom)
+				break;
+			auto x = index / kSampleRate;
+			sumX += x;
+			sumY += decay[index];
+			sumXX += x * x;
+			sumXY += x * decay[index];
+			++count;
+		}
+		if (count < 2 || decay.back () > bottom)
+			return 0.;
+		auto slope = (count * sumXY - sumX * sumY) / (count * sumXX - sumX * sumX);
+		return slope < 0. ? -60. / slope : 0.;
+	};
+	auto t30 = fit (-5., -35.);
+	return t30 > 0. ? t30 : fit (-5., -25.);
+}
+
+//------------------------------------------------------------------------
+BenchResult fingerprint (const std::string& name, const Render& render)
+{
+	BenchResult result;
+	result.name = name;
+	result.add ("hash_hi", static_cast<double> (render.hash >> 32));
+	result.add ("hash_lo", static_cast<double> (render.hash & 0xffffffffu));
+	auto levels = blockLevels (render);
+	for (size_t index = 0; index < levels.size (); ++index)
+		result.add ("level_" + std::to_string (index), levels[index]);
+	auto bands = bandLevels (render);
+	for (size_t index = 0; index < bands.size (); ++index)
+		result.add ("band_" + std::to_string (index), bands[index]);
+	result.add ("rt60", rt60 (render));
+	return result;
+}
+
+//------------------------------------------------------------------------
+/** compiler, architecture and the floating point contraction relevant flags: bit-exact references
+ *	are only comparable between identical toolchains */
+std::string toolchain ()
+{
+	std::string name;
+#if defined(__clang__)
+	name = "clang-" __clang_version__;
+#elif defined(__GNUC__)
+	name = "gcc-" __VERSION__;
+#elif defined(_MSC_FULL_VER)
+	name = "msvc-" + std::to_string (_MSC_FULL_VER);
+#else
+	name = "unknown";
+#endif
+#if defined(__x86_64__) || defined(_M_X64)
+	name += "/x86_64";
+#elif defined(__aarch64__) || defined(_M_ARM64)
+	name += "/arm64";
+#elif defined(__i386__) || defined(_M_IX86)
+	name += "/x86";
+#endif
+#if defined(__FMA__)
+	name += "/fma";
+#endif
+#if defined(__AVX__)
+	name += "/avx";
+#endif
+	for (auto& c : name)
+	{
+		if (c == '"' || c == '\\')
+			c = '_';
+	}
+	return name;
+}
+
+//------------------------------------------------------------------------
+struct Options
+{
+	std::string presetDir;
+	std::string referencePath;
+	std::string savePath;
+	std::vector<std::string> types {"float",          "double",          "mixed",     "reduced2",
+	                                "reduced4",       "mono-in",         "mono",      "surround",
+	                                "batch",          "baseline-float",  "baseline-double",
+	                                "tpt-float",      "tpt-double"};
+	bool exact {false};
+	bool baseline {false};
+	bool checkSurround {false};
+	bool checkMixed {false};
+	double surroundSnr {144.};
+	double surroundCorrelation {0.07};
+	double mixedError {-130.};
+	double levelTolerance {0.05};
+	double spectralTolerance {0.05};
+	double rt60Tolerance {1.};
+};
+
+//------------------------------------------------------------------------
+void printUsage ()
+{
+	printf ("usage: mverb-golden --presets DIR (--reference FILE | --save FILE) [options]\n");
+	printf ("       mverb-golden --presets DIR --check-surround [options]\n");
+	printf ("       mverb-golden --presets DIR --check-mixed [options]\n");
+	printf ("\n");
+	printf ("Renders an impulse, a noise burst and a sine sweep for every preset, a grid of parameter\n");
+	printf ("settings and a few automated settings and compares the output against a stored reference.\n");
+	printf ("\n");
+	printf ("  --presets DIR                 folder with the .vstpreset files\n");
+	printf ("  --reference FILE              compare against this reference\n");
+	printf ("  --save FILE                   write a new reference\n");
+	printf ("  --exact                       compare the output hashes (same toolchain only)\n");
+	printf ("  --baseline                    compare float, double and mixed against the baseline\n");
+	printf ("                                types instead of the float and double reference\n");
+	printf ("  --types LIST                  float,double,mixed,half,dispatch,reduced2,reduced4,\n");
+	printf ("                                mono-in,mono,surround,batch,baseline-float,\n");
+	printf ("                                baseline-double,tpt-float,tpt-double (default all but\n");
+	printf ("                                half and dispatch)\n");
+	printf ("\n");
+	printf ("reduced2 and reduced4 run the tank and the early reflections at 1/2 and 1/4 of the rate,\n");
+	printf ("mono-in and mono the mono to stereo and the mono kernel, surround MVerbSurround<double>\n");
+	printf ("on a 5.1 bed, tpt-float and tpt-double the engine with the TptLowpass filters and the\n");
+	printf ("baseline types the engine before the optimisations. mixed is compared against the double\n");
+	printf ("reference, half (16 bit delay lines), dispatch (the float engine for the instruction set\n");
+	printf ("MVerbSelectIsa picks) and batch (every lane of MVerbBatch<float, 4>) against the float\n");
+	printf ("reference.\n");
+	printf ("\n");
+	printf ("  --level-tolerance DB          max per block level error (default 0.05)\n");
+	printf ("  --spectral-tolerance DB       max RMS error of the band levels (default 0.05)\n");
+	printf ("  --rt60-tolerance PERCENT      max RT60 deviation (default 1)\n");
+	printf ("\n");
+	printf ("--check-surround renders every setting and input through MVerbSurround<double> instead:\n");
+	printf ("a stereo layout has to match MVerb<double> and the LFE has to pass only the dry\n");
+	printf ("signal. The wet channels of a 7.1.4 bed must not correlate for the noise burst at the\n");
+	printf ("plug-in's defaults and setLayout has to reject more than 2 * NUM_TAP_GROUPS speakers\n");
+	printf ("on one side.\n");
+	printf ("\n");
+	printf ("  --surround-snr DB             min SNR of the stereo layout (default 144)\n");
+	printf ("  --surround-correlation R      max |r| of two wet channels (default 0.07)\n");
+	printf ("\n");
+	printf ("--check-mixed renders every setting and input through the 64 bit engine (MVerb<float> on\n");
+	printf ("double buffers) and MVerb<double>, the peak of their difference has to stay below the\n");
+	printf ("peak of MVerb<double> by --mixed-error.\n");
+	printf ("\n");
+	printf ("  --mixed-error DB              max peak error relative to the peak (default -130)\n");
+	printf ("\n");
+	printf ("exit code: 0 passed, 1 failed, 2 usage error, 77 exact mode with a foreign reference\n");
+}
+
+//------------------------------------------------------------------------
+bool parseTolerance (const char* text, double& value)
+{
+	char* end = nullptr;
+	value = strtod (text, &end);
+	return end != text && *end == 0 && value >= 0.;
+}
+
+//------------------------------------------------------------------------
+bool parseArguments (int argc, char* argv[], Options& options)
+{
+	for (auto index = 1; index < argc; ++index)
+	{
+		std::string arg = argv[index];
+		if (arg == "--exact")
+		{
+			options.exact = true;
+			continue;
+		}
+		if (arg == "--baseline")
+		{
+			options.baseline = true;
+			continue;
+		}
+		if (arg == "--check-surround")
+		{
+			options.checkSurround = true;
+			continue;
+		}
+		if (arg == "--check-mixed")
+		{
+			options.checkMixed = true;
+			continue;
+		}
+		if (index + 1 >= argc)
+			return false;
+		const char* value = argv[++index];
+		if (arg == "--presets")
+			options.presetDir = value;
+		else if (arg == "--reference")
+			options.referencePath = value;
+		else if (arg == "--save")
+			options.savePath = value;
+		else if (arg == "--types")
+		{
+			options.types.clear ();
+			std::stringstream stream (value);
+			std::string item;
+			while (std::getline (stream, item, ','))
+			{
+				if (!findEngineType (item))
+					return false;
+				options.types.push_back (item);
+			}
+			if (options.types.empty ())
+				return false;
+		}
+		else if (arg == "--level-tolerance")
+		{
+			if (!parseTolerance (value, options.levelTolerance))
+				return false;
+		}
+		else if (arg == "--spectral-tolerance")
+		{
+			if (!parseTolerance (value, options.spectralTolerance))
+				return false;
+		}
+		else if (arg == "--rt60-tolerance")
+		{
+			if (!parseTolerance (value, options.rt60Tolerance))
+				return false;
+		}
+		else if (arg == "--surround-snr")
+		{
+			if (!parseTolerance (value, options.surroundSnr))
+				return false;
+		}
+		else if (arg == "--surround-correlation")
+		{
+			if (!parseTolerance (value, options.surroundCorrelation))
+				return false;
+		}
+		else if (arg == "--mixed-error")
+		{
+			// a level below the peak, given with or without its sign
+			if (!parseTolerance (value[0] == '-' ? value + 1 : value, options.mixedError))
+				return false;
+			options.mixedError = -options.mixedError;
+		}
+		else
+			return false;
+	}
+	if (options.baseline)
+	{
+		// the other types have no baseline to compare to
+		if (options.exact || !options.savePath.empty ())
+			return false;
+		for (const auto& type : options.types)
+		{
+			if (type != "float" && type != "double" && type != "mixed")
+				return false;
+		}
+	}
+	if (options.checkSurround && options.checkMixed)
+		return false;
+	if (options.checkSurround || options.checkMixed)
+		return !options.presetDir.empty () && options.referencePath.empty () && options.savePath.empty ();
+	return !options.presetDir.empty () &&
+	       (options.referencePath.empty () != options.savePath.empty ());
+}
+
+//------------------------------------------------------------------------
+bool loadSettings (const std::string& presetDir, std::vector<Setting>& settings)
+{
+	std::error_code ec;
+	std::vector<std::filesystem::path> paths;
+	for (const auto& entry : std::filesystem::directory_iterator (presetDir, ec))
+	{
+		if (entry.path ().extension () == ".vstpreset")
+			paths.push_back (entry.path ());
+	}
+	if (ec || paths.empty ())
+	{
+		fprintf (stderr, "error: no presets found in '%s'\n", presetDir.data ());
+		return false;
+	}
+	std::sort (paths.begin (), paths.end ());
+	for (const auto& path : paths)
+	{
+		Setting setting;
+		setting.name = path.stem ().string ();
+		std::string error;
+		if (!loadVstPreset (path.string (), setting.values, error))
+		{
+			fprintf (stderr, "error: %s\n", error.data ());
+			return false;
+		}
+		settings.push_back (setting);
+	}
+	settings.insert (settings.end (), gridSettings.begin (), gridSettings.end ());
+	return true;
+}
+
+//------------------------------------------------------------------------
+Render renderType (const std::string& type, const Setting& setting, Input input)
+{
+	if (type == "float")
+		return render<float, MVerb<float>> (setting, input);
+	if (type == "double")
+		return render<double, MVerb<double>> (setting, input);
+	if (type == "half")
+		return render<float, StorageVerb<HalfSample>> (setting, input);
+	if (type == "dispatch")
+		return render<float> (setting, input, MVerbCreateFloatKernel (MVerbSelectIsa ()));
+	if (type == "reduced2")
+		return renderFloat (setting, input, 2, 2, 2);
+	if (type == "reduced4")
+		return renderFloat (setting, input, 4, 2, 2);
+	if (type == "mono-in")
+		return renderFloat (setting, input, 1, 1, 2);
+	if (type == "mono")
+		return renderFloat (setting, input, 1, 1, 1);
+	if (type == "surround")
+		return renderSurround (setting, input, layout51);
+	if (type == "batch")
+		return renderBatch (setting, input);
+	if (type == "baseline-float")
+		return render<float, mverb_baseline::MVerb<float>> (setting, input);
+	if (type == "baseline-double")
+		return render<double, mverb_baseline::MVerb<double>> (setting, input);
+	if (type == "tpt-float")
+		return render<float, TptVerb<float>> (setting, input);
+	if (type == "tpt-double")
+		return render<double, TptVerb<double>> (setting, input);
+	return render<double, MixedVerb> (setting, input);
+}
+
+//------------------------------------------------------------------------
+struct Deviation
+{
+	double level {0.};
+	double spectral {0.};
+	double rt60 {0.};
+};
+
+/** Per block level error on blocks within 60 dB of the loudest one, RMS error of the band levels
+ *	within 60 dB of the loudest band and relative RT60 deviation in percent. */
+Deviation compare (const BenchResult& result, const BenchResult& reference)
+{
+	auto collect = [] (const BenchResult& r, const std::string& prefix) {
+		std::vector<double> values;
+		while (auto value = r.find (prefix + std::to_string (values.size ())))
+			values.push_back (*value);
+		return values;
+	};
+
+	Deviation deviation;
+	for (const auto* prefix : {"level_", "band_"})
+	{
+		auto values = collect (result, prefix);
+		auto expected = collect (reference, prefix);
+		if (values.size () != expected.size ())
+			return {kFloorDB, kFloorDB, 100.};
+		auto floor = *std::max_element (expected.begin (), expected.end ()) - kCompareRange;
+		double maxError = 0.;
+		double sumSquares = 0.;
+		auto count = 0;
+		for (size_t index = 0; index < values.size (); ++index)
+		{
+			if (expected[index] < floor)
+				continue;
+			auto error = std::abs (values[index] - expected[index]);
+			maxError = std::max (maxError, error);
+			sumSquares += error * error;
+			++count;
+		}
+		if (prefix[0] == 'l')
+			deviation.level = maxError;
+		else
+			deviation.spectral = count ? std::sqrt (sumSquares / count) : 0.;
+	}
+	auto time = result.find ("rt60");
+	auto expectedTime = reference.find ("rt60");
+	if (time && expectedTime && *expectedTime > 0.)
+		deviation.rt60 = 100. * std::abs (*time - *expectedTime) / *expectedTime;
+	else if (!time || !expectedTime || *time != *expectedTime)
+		deviation.rt60 = 100.;
+	return deviation;
+}
+
+//------------------------------------------------------------------------
+/** Pearson correlation of two channels */
+double correlation (const std::vector<double>& a, const std::vector<double>& b)
+{
+	double sumA = 0., sumB = 0., sumAA = 0., sumBB = 0., sumAB = 0.;
+	for (size_t index = 0; index < a.size (); ++index)
+	{
+		sumA += a[index];
+		sumB += b[index];
+		sumAA += a[index] * a[index];
+		sumBB += b[index] * b[index];
+		sumAB += a[index] * b[index];
+	}
+	auto count = static_cast<double> (a.size ());
+	auto covariance = sumAB - sumA * sumB / count;
+	auto variance = (sumAA - sumA * sumA / count) * (sumBB - sumB * sumB / count);
+	return variance > 0. ? covariance / std::sqrt (variance) : 0.;
+}
+
+//------------------------------------------------------------------------
+/** Checks MVerbSurround<double> for every setting and input: a stereo layout has to match
+ *	MVerb<double> and the LFE has to pass the dry signal only. Also checks that the wet channels of a
+ *	7.1.4 bed do not correlate and that setLayout rejects too many speakers on one side. */
+int checkSurround (const Options& options, const std::vector<Setting>& settings)
+{
+	auto failures = 0;
+	auto checked = 0;
+	double worstSnr = 1000.;
+	double worstLfe = 0.;
+	for (const auto& setting : settings)
+	{
+		for (auto input : {Input::Impulse, Input::Noise, Input::Sweep})
+		{
+			auto name = setting.name + "/" + inputName (input);
+			++checked;
+			auto failed = false;
+
+			auto stereo = render<double, MVerb<double>> (setting, input);
+			auto surround = renderSurround (setting, input,
+			                                {SurroundVerb::SPEAKER_LEFT, SurroundVerb::SPEAKER_RIGHT});
+			double signal = 0., error = 0.;
+			for (auto channel = 0; channel < 2; ++channel)
+			{
+				for (auto index = 0; index < kRenderLength; ++index)
+				{
+					auto expected = stereo.channels[channel][index];
+					auto difference = surround.channels[channel][index] - expected;
+					signal += expected * expected;
+					error += difference * difference;
+				}
+			}
+			auto snr = error > 0. ? 10. * std::log10 (signal / error) : 1000.;
+			worstSnr = std::min (worstSnr, snr);
+			if (snr < options.surroundSnr)
+			{
+				printf ("FAIL %s: stereo layout %.1f dB from MVerb<double>\n", name.data (), snr);
+				failed = true;
+			}
+
+			// the LFE alone: it reaches no other channel and leaves with the level of the dry signal
+			auto lfe = static_cast<size_t> (std::find (layout51.begin (), layout51.end (), SurroundVerb::SPEAKER_LFE) -
+			                                layout51.begin ());
+			auto lfeOnly = renderSurround (setting, input, layout51, ~(1u << lfe));
+			auto dryGain = (1. - setting.values[SurroundVerb::MIX]) * setting.values[SurroundVerb::GAIN];
+			auto dry = makeInput (input, lfe % 2);
+			double lfeError = 0.;
+			for (size_t channel = 0; channel < layout51.size (); ++channel)
+			{
+				for (auto index = 0; index < kRenderLength; ++index)
+				{
+					auto expected = channel == lfe ? dry[index] * dryGain : 0.;
+					lfeError = std::max (lfeError, std::abs (lfeOnly.channels[channel][index] - expected));
+				}
+			}
+			worstLfe = std::max (worstLfe, lfeError);
+			if (lfeError > 1e-12)
+			{
+				printf ("FAIL %s: the LFE is %g from its dry signal\n", name.data (), lfeError);
+				failed = true;
+			}
+			failures += failed;
+		}
+	}
+
+	// the wet channels of a 7.1.4 bed with the noise burst. Darker and smaller settings correlate more,
+	// a few low modes dominate their tail
+	auto bed = renderSurround (decorrelationSetting, Input::Noise, layout714);
+	double worstCorrelation = 0.;
+	for (size_t a = 0; a < layout714.size (); ++a)
+	{
+		for (size_t b = a + 1; b < layout714.size (); ++b)
+		{
+			if (layout714[a] != SurroundVerb::SPEAKER_LFE && layout714[b] != SurroundVerb::SPEAKER_LFE)
+				worstCorrelation =
+				    std::max (worstCorrelation, std::abs (correlation (bed.channels[a], bed.channels[b])));
+		}
+	}
+	if (worstCorrelation > options.surroundCorrelation)
+		printf ("FAIL wet channels of 7.1.4 correlate by %.4f\n", worstCorrelation);
+
+	// one speaker more than the tap groups can serve on the left side, and all of them
+	auto layoutFailures = 0;
+	constexpr auto maxPerSide = 2 * MVerbSurroundTopology::NUM_TAP_GROUPS;
+	for (auto numLeft : {maxPerSide, maxPerSide + 1})
+	{
+		std::vector<int> speakers (numLeft, SurroundVerb::SPEAKER_LEFT);
+		speakers.push_back (SurroundVerb::SPEAKER_RIGHT);
+		auto verb = std::make_unique<SurroundVerb> ();
+		auto accepted = verb->setLayout (speakers.data (), static_cast<int> (speakers.size ()));
+		// a rejected layout leaves the default 5.1 one in place
+		auto expected = numLeft <= maxPerSide;
+		auto numChannels = expected ? speakers.size () : layout51.size ();
+		if (accepted != expected || verb->getNumChannels () != static_cast<int> (numChannels))
+		{
+			printf ("FAIL setLayout with %d speakers on one side %s\n", numLeft,
+			        accepted ? "accepted" : "rejected");
+			++layoutFailures;
+		}
+	}
+
+	printf ("%d of %d renders passed (worst: stereo layout %.1f dB, LFE %g), 7.1.4 correlation %.4f, "
+	        "setLayout %s\n",
+	        checked - failures, checked, worstSnr, worstLfe, worstCorrelation,
+	        layoutFailures ? "failed" : "passed");
+	return failures || layoutFailures || worstCorrelation > options.surroundCorrelation ? kExitFailed : 0;
+}
+
+//------------------------------------------------------------------------
+/** Checks the 64 bit engine against MVerb<double> for every setting and input. It keeps its delay
+ *	lines and its arithmetic in float but sets up the delay lengths, the fades and the filters in
+ *	double, so its lines have the lengths of MVerb<double> and only the float rounding remains. */
+int checkMixed (const Options& options, const std::vector<Setting>& settings)
+{
+	auto failures = 0;
+	auto checked = 0;
+	double worstError = kFloorDB;
+	for (const auto& setting : settings)
+	{
+		for (auto input : {Input::Impulse, Input::Noise, Input::Sweep})
+		{
+			auto name = setting.name + "/" + inputName (input);
+			++checked;
+			auto expected = render<double, MVerb<double>> (setting, input);
+			auto mixed = render<double, MixedVerb> (setting, input);
+			double peak = 0., error = 0.;
+			for (auto channel = 0; channel < 2; ++channel)
+			{
+				for (auto index = 0; index < kRenderLength; ++index)
+				{
+					peak = std::max (peak, std::abs (expected.channels[channel][index]));
+					error = std::max (error, std::abs (mixed.channels[channel][index] -
+					                                   expected.channels[channel][index]));
+				}
+			}
+			auto relative = error > 0. ? 20. * std::log10 (error / peak) : kFloorDB;
+			worstError = std::max (worstError, relative);
+			if (relative > options.mixedError)
+			{
+				printf ("FAIL %s: peak error %.1f dB from MVerb<double>\n", name.data (), relative);
+				++failures;
+			}
+		}
+	}
+	printf ("%d of %d renders passed (worst: peak error %.1f dB)\n", checked - failures, checked, worstError);
+	return failures ? kExitFailed : 0;
+}
+
+//------------------------------------------------------------------------
+int run (const Options& options)
+{
+	std::vector<Setting> settings;
+	if (!loadSettings (options.presetDir, settings))
+		return kExitUsage;
+	if (options.checkSurround)
+		return checkSurround (options, settings);
+	// the surround check compares against the dry signal at a constant gain and mix
+	settings.insert (settings.end (), automationSettings.begin (), automationSettings.end ());
+	if (options.checkMixed)
+		return checkMixed (options, settings);
+
+	BenchResults reference;
+	if (!options.referencePath.empty ())
+	{
+		std::string error;
+		if (!readBenchResults (options.referencePath, reference, error))
+		{
+			fprintf (stderr, "error: %s\n", error.data ());
+			return kExitUsage;
+		}
+	}
+	auto findReference = [&] (const std::string& name) -> const BenchResult* {
+		auto it = std::find_if (reference.begin (), reference.end (),
+		                        [&] (const BenchResult& r) { return r.name == name; });
+		return it != reference.end () ? &*it : nullptr;
+	};
+
+	auto exact = options.exact;
+	if (exact && !options.referencePath.empty () && !findReference ("toolchain/" + toolchain ()))
+	{
+		printf ("skipped: the reference was not written by %s\n", toolchain ().data ());
+		return kExitSkipped;
+	}
+
+	BenchResults results;
+	results.push_back ({"toolchain/" + toolchain (), {}});
+	auto failures = 0;
+	auto checked = 0;
+	Deviation worst;
+	for (const auto& type : options.types)
+	{
+		// variants have no reference of their own, see engineTypes
+		std::string referenceType = findEngineType (type)->reference;
+		auto variant = referenceType != type;
+		if (options.baseline)
+			referenceType = "baseline-" + referenceType;
+		if (variant && !options.savePath.empty ())
+			continue;
+		if (variant && exact && type != "dispatch")
+			continue;
+		if (type == "dispatch")
+			printf ("dispatch runs the %s engine\n", MVerbIsaName (MVerbSelectIsa ()));
+		for (const auto& setting : settings)
+		{
+			for (auto input : {Input::Impulse, Input::Noise, Input::Sweep})
+			{
+				auto name = type + "/" + setting.name + "/" + inputName (input);
+				auto result = fingerprint (name, renderType (type, setting, input));
+				if (!options.savePath.empty ())
+				{
+					results.push_back (result);
+					continue;
+				}
+				auto referenceName = referenceType + "/" + setting.name + "/" + inputName (input);
+				auto expected = findReference (referenceName);
+				++checked;
+				if (!expected)
+				{
+					printf ("FAIL %s: no reference %s\n", name.data (), referenceName.data ());
+					++failures;
+					continue;
+				}
+				if (exact)
+				{
+					if (*result.find ("hash_hi") != *expected->find ("hash_hi") ||
+					    *result.find ("hash_lo") != *expected->find ("hash_lo"))
+					{
+						printf ("FAIL %s: output differs from the reference\n", name.data ());
+						++failures;
+					}
+					continue;
+				}
+				auto deviation = compare (result, *expected);
+				worst.level = std::max (worst.level, deviation.level);
+				worst.spectral = std::max (worst.spectral, deviation.spectral);
+				worst.rt60 = std::max (worst.rt60, deviation.rt60);
+				if (deviation.level > options.levelTolerance ||
+				    deviation.spectral > options.spectralTolerance ||
+				    deviation.rt60 > options.rt60Tolerance)
+				{
+					printf ("FAIL %s: block level %.4f dB, spectrum %.4f dB, RT60 %.3f %%\n",
+					        name.data (), deviation.level, deviation.spectral, deviation.rt60);
+					++failures;
+				}
+			}
+		}
+	}
+
+	if (!options.savePath.empty ())
+	{
+		if (!writeBenchResults (options.savePath, results))
+		{
+			fprintf (stderr, "error: could not write '%s'\n", options.savePath.data ());
+			return kExitFailed;
+		}
+		printf ("wrote %zu renders to %s\n", results.size () - 1, options.savePath.data ());
+		return 0;
+	}
+	if (exact)
+		printf ("%d of %d renders bit-exact\n", checked - failures, checked);
+	else
+		printf ("%d of %d renders within tolerance (worst: block level %.6f dB, spectrum %.6f dB, "
+		        "RT60 %.4f %%)\n",
+		        checked - failures, checked, worst.level, worst.spectral, worst.rt60);
+	return failures ? kExitFailed : 0;
+}
+
+//------------------------------------------------------------------------
+} // anonymous
+} // namespace mverb
+
+//------------------------------------------------------------------------
+int main (int argc, char* argv[])
+{
+	mverb::Options options;
+	if (!mverb::parseArguments (argc, argv, options))
+	{
+		mverb::printUsage ();
+		return mverb::kExitUsage;
+	}
+	return mverb::run (options);
+}
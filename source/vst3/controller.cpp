@@ -20,6 +20,8 @@
 #include "vstgui/plugin-bindings/vst3editor.h"
 #include "public.sdk/source/vst/utility/vst2persistence.h"
 
+#include <cmath>
+
 using namespace Steinberg;
 
 namespace mverb {
@@ -52,7 +54,7 @@ tresult PLUGIN_API Controller::initialize (FUnknown* context)
 	                         Vst::ParameterInfo::kCanAutomate | Vst::ParameterInfo::kIsBypass,
 	                         BypassParamID);
 
-	
+	updateTail ();
 	return result;
 }
 
@@ -82,6 +84,7 @@ tresult PLUGIN_API Controller::setComponentState (IBStream* state)
 				param->setNormalized (stateData->programs[0].values[idx]);
 			}
 		}
+		updateTail ();
 		return kResultTrue;
 	}
 	return kResultFalse;
@@ -104,6 +107,34 @@ tresult PLUGIN_API Controller::getState (IBStream* state)
 	return kResultTrue;
 }
 
+//------------------------------------------------------------------------
+tresult PLUGIN_API Controller::setParamNormalized (Vst::ParamID tag, Vst::ParamValue value)
+{
+	auto result = EditControllerEx1::setParamNormalized (tag, value);
+	if (result == kResultTrue &&
+	    (tag == FloatMVerb::DECAY || tag == FloatMVerb::SIZE || tag == FloatMVerb::PREDELAY ||
+	     tag == FloatMVerb::GAIN))
+		updateTail ();
+	return result;
+}
+
+//------------------------------------------------------------------------
+void Controller::updateTail ()
+{
+	// the processor reports the exact tail, the host is asked to query it again only when it
+	// moved by a quarter second so that automating the parameters does not flood it
+	auto tail = FloatMVerb::getTailTime (getParamNormalized (FloatMVerb::DECAY),
+	                                     getParamNormalized (FloatMVerb::SIZE),
+	                                     getParamNormalized (FloatMVerb::PREDELAY),
+	                                     getParamNormalized (FloatMVerb::GAIN));
+	auto quarters = static_cast<int> (std::ceil (tail * 4.));
+	if (quarters == tailQuarters)
+		return;
+	tailQuarters = quarters;
+	if (componentHandler)
+		componentHandler->restartComponent (Vst::kLatencyChanged);
+}
+
 //------------------------------------------------------------------------
 IPlugView* PLUGIN_API Controller::createView (FIDString name)
 {
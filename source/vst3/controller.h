@@ -45,6 +45,8 @@ public:
 	Steinberg::IPlugView* PLUGIN_API createView (Steinberg::FIDString name) SMTG_OVERRIDE;
 	Steinberg::tresult PLUGIN_API setState (Steinberg::IBStream* state) SMTG_OVERRIDE;
 	Steinberg::tresult PLUGIN_API getState (Steinberg::IBStream* state) SMTG_OVERRIDE;
+	Steinberg::tresult PLUGIN_API setParamNormalized (Steinberg::Vst::ParamID tag,
+	                                                  Steinberg::Vst::ParamValue value) SMTG_OVERRIDE;
 
  	//---Interface---------
 	DEFINE_INTERFACES
@@ -55,6 +57,10 @@ public:
 
 //------------------------------------------------------------------------
 protected:
+	void updateTail ();
+
+	// tail length in quarter seconds the host was last told about
+	int tailQuarters {0};
 };
 
 //------------------------------------------------------------------------
@@ -16,18 +16,51 @@
 
 #include "processor.h"
 #include "cids.h"
+#include "../DenormalGuard.h"
 #include "base/source/fstreamer.h"
 #include "pluginterfaces/vst/ivstparameterchanges.h"
-#include "public.sdk/source/vst/utility/processdataslicer.h"
 #include "public.sdk/source/vst/utility/audiobuffers.h"
 #include "public.sdk/source/vst/utility/vst2persistence.h"
 
 #include <algorithm>
+#include <cmath>
+#include <type_traits>
 
 using namespace Steinberg;
 
 namespace mverb {
 
+//------------------------------------------------------------------------
+// bus arrangements besides stereo, they run on MVerbSurround
+static bool isSurroundArrangement (Vst::SpeakerArrangement arrangement)
+{
+	return arrangement == Vst::SpeakerArr::k51 || arrangement == Vst::SpeakerArr::k71Cine ||
+	       arrangement == Vst::SpeakerArr::k71Music || arrangement == Vst::SpeakerArr::k71_4;
+}
+
+//------------------------------------------------------------------------
+static int getSurroundSpeaker (Vst::Speaker speaker)
+{
+	switch (speaker)
+	{
+		case Vst::kSpeakerL:
+		case Vst::kSpeakerLs:
+		case Vst::kSpeakerLc:
+		case Vst::kSpeakerSl:
+		case Vst::kSpeakerTfl:
+		case Vst::kSpeakerTrl: return FloatMVerbSurround::SPEAKER_LEFT;
+		case Vst::kSpeakerR:
+		case Vst::kSpeakerRs:
+		case Vst::kSpeakerRc:
+		case Vst::kSpeakerSr:
+		case Vst::kSpeakerTfr:
+		case Vst::kSpeakerTrr: return FloatMVerbSurround::SPEAKER_RIGHT;
+		case Vst::kSpeakerLfe:
+		case Vst::kSpeakerLfe2: return FloatMVerbSurround::SPEAKER_LFE;
+	}
+	return FloatMVerbSurround::SPEAKER_CENTER;
+}
+
 //------------------------------------------------------------------------
 // mverbProcessor
 //------------------------------------------------------------------------
@@ -49,6 +82,14 @@ Processor::Processor ()
 	params[FloatMVerb::GAIN].setValue (1.);
 	params[FloatMVerb::MIX].setValue (0.15);
 	params[FloatMVerb::EARLYMIX].setValue (0.75);
+
+	// until setupProcessing creates the engine, estimated from the parameters
+	tailSamples = static_cast<uint32> (
+	    std::ceil (FloatMVerb::getTailTime (params[FloatMVerb::DECAY].getValue (),
+	                                        params[FloatMVerb::SIZE].getValue (),
+	                                        params[FloatMVerb::PREDELAY].getValue (),
+	                                        params[FloatMVerb::GAIN].getValue ()) *
+	               processSetup.sampleRate));
 }
 
 //------------------------------------------------------------------------
@@ -69,8 +110,8 @@ tresult PLUGIN_API Processor::initialize (FUnknown* context)
 	}
 
 	//--- create Audio IO ------
-	addAudioInput (STR16 ("Stereo In"), Steinberg::Vst::SpeakerArr::kStereo);
-	addAudioOutput (STR16 ("Stereo Out"), Steinberg::Vst::SpeakerArr::kStereo);
+	addAudioInput (STR16 ("Audio In"), Steinberg::Vst::SpeakerArr::kStereo);
+	addAudioOutput (STR16 ("Audio Out"), Steinberg::Vst::SpeakerArr::kStereo);
 
 	return kResultOk;
 }
@@ -88,10 +129,26 @@ tresult PLUGIN_API Processor::terminate ()
 tresult PLUGIN_API Processor::setActive (TBool state)
 {
 	//--- called when the Plug-in is enable/disable (On/Off) -----
-	lastBlockWasSilent = false;
 	return AudioEffect::setActive (state);
 }
 
+//------------------------------------------------------------------------
+int32 Processor::nextPointOffset (AutomatedParameter& parameter, int32 position, int32 numSamples)
+{
+	auto numPoints = parameter.queue->getPointCount ();
+	while (parameter.nextPoint < numPoints)
+	{
+		int32 offset = 0;
+		Vst::ParamValue value = 0.;
+		if (parameter.queue->getPoint (parameter.nextPoint, offset, value) != kResultTrue)
+			break;
+		if (offset > position)
+			return std::min (offset, numSamples);
+		++parameter.nextPoint;
+	}
+	return numSamples;
+}
+
 //------------------------------------------------------------------------
 template<typename T, Vst::SymbolicSampleSizes SampleSize>
 void Processor::processT (Vst::ProcessData& data)
@@ -106,98 +163,219 @@ void Processor::processT (Vst::ProcessData& data)
 		}
 	});
 
+	auto flushAutomation = [&] () {
+		for (auto index = 0; index < numAutomated; ++index)
+		{
+			auto& p = params[automated[index].paramIndex];
+			p.flushChanges ([&] (auto value) { mVerb->setParameter (p.getParamID (), value); });
+		}
+	};
+
 	if (data.numSamples == 0)
 	{
-		std::for_each (params.begin (), params.end (), [&] (auto& p) {
-			p.flushChanges ([&] (auto value) { mVerb->setParameter (p.getParamID (), value); });
-		});
+		flushAutomation ();
 	}
 	else
 	{
-		bool inputSilent = data.inputs[0].silenceFlags != 0;
+		const auto numChannels = data.outputs[0].numChannels;
+		const auto numInputChannels = data.inputs[0].numChannels;
+		const uint64 allChannels = ((uint64)1 << numChannels) - 1;
+		const uint64 allInputChannels = ((uint64)1 << numInputChannels) - 1;
+		auto inputs = Vst::getChannelBuffers<SampleSize> (data.inputs[0]);
+		auto outputs = Vst::getChannelBuffers<SampleSize> (data.outputs[0]);
+		bool inputSilent = (data.inputs[0].silenceFlags & allInputChannels) == allInputChannels;
 		bool doBypass = params[BypassParamID].flushChanges () > 0.5;
-		if (doBypass || (lastBlockWasSilent && inputSilent))
+		if (doBypass || (inputSilent && mVerb->isSleeping ()))
 		{
-			std::for_each (params.begin (), params.end (), [&] (auto& p) {
-				p.flushChanges ([&] (auto value) { mVerb->setParameter (p.getParamID (), value); });
-			});
-			for (auto channel = 0; channel < 2; ++channel)
+			flushAutomation ();
+			// the tail has decayed, a sleeping reverb outputs silence for silent input. A mono
+			// input is copied to both sides in bypass.
+			for (auto channel = 0; channel < numChannels; ++channel)
 			{
-				if (Vst::getChannelBuffers<SampleSize> (data.inputs[0])[channel] !=
-				    Vst::getChannelBuffers<SampleSize> (data.outputs[0])[channel])
-					memcpy (Vst::getChannelBuffers<SampleSize> (data.outputs[0])[channel],
-					        Vst::getChannelBuffers<SampleSize> (data.inputs[0])[channel],
-					        data.numSamples * sizeof (float));
+				auto input = inputs[std::min (channel, numInputChannels - 1)];
+				if (!doBypass)
+					memset (outputs[channel], 0, data.numSamples * sizeof (*outputs[channel]));
+				else if (input != outputs[channel])
+					memcpy (outputs[channel], input, data.numSamples * sizeof (*outputs[channel]));
 			}
-			data.outputs[0].silenceFlags = data.inputs[0].silenceFlags;
+			if (!doBypass)
+				data.outputs[0].silenceFlags = allChannels;
+			else if (numInputChannels < numChannels)
+				data.outputs[0].silenceFlags = (data.inputs[0].silenceFlags & 1) ? allChannels : 0;
+			else
+				data.outputs[0].silenceFlags = data.inputs[0].silenceFlags;
 		}
 		else
 		{
-			bool blockSilent = false;
-			Vst::ProcessDataSlicer slicer (8);
-			slicer.process<SampleSize> (data, [&] (auto& data) {
-				std::for_each (params.begin (), params.end (), [&] (auto& p) {
-					p.advance (data.numSamples,
-					           [&] (auto value) { mVerb->setParameter (p.getParamID (), value); });
-				});
-				blockSilent |= mVerb->process (Vst::getChannelBuffers<SampleSize> (data.inputs[0]),
-				                               Vst::getChannelBuffers<SampleSize> (data.outputs[0]),
-				                               data.numSamples);
-			});
-			lastBlockWasSilent = blockSilent;
-			if (blockSilent)
+			// the block is only cut at the points of the automated parameters. Each of them is set
+			// to its value at the end of a slice, the engine ramps to it from the value at the
+			// start over the slice, which is the linear ramp between two points. A point at offset
+			// 0 is a step from the value of the last block: it gets a slice of one sample, so the
+			// engine has taken it at the first sample instead of ramping to it over the next
+			// slice. Without automation the block is one slice. A channel is silent only if it was
+			// silent in every slice.
+			bool stepAtStart = false;
+			for (auto index = 0; index < numAutomated; ++index)
+				stepAtStart |= nextPointOffset (automated[index], -1, data.numSamples) == 0;
+			uint64 silentChannels = allChannels;
+			using Buffer = std::remove_reference_t<decltype (*inputs)>;
+			Buffer sliceInputs[FloatMVerbSurround::MaxChannels];
+			Buffer sliceOutputs[FloatMVerbSurround::MaxChannels];
+			for (auto start = 0; start < data.numSamples;)
 			{
-				data.outputs[0].silenceFlags = ((uint64)1 << 2) - 1;
+				auto end = start == 0 && stepAtStart ? 1 : data.numSamples;
+				for (auto index = 0; index < numAutomated; ++index)
+					end = std::min (end, nextPointOffset (automated[index], start, data.numSamples));
+				for (auto index = 0; index < numAutomated; ++index)
+				{
+					auto& p = params[automated[index].paramIndex];
+					p.advance (end - start,
+					           [&] (auto value) { mVerb->setParameter (p.getParamID (), value); });
+				}
+				for (auto channel = 0; channel < numInputChannels; ++channel)
+					sliceInputs[channel] = inputs[channel] + start;
+				for (auto channel = 0; channel < numChannels; ++channel)
+					sliceOutputs[channel] = outputs[channel] + start;
+				mVerb->process (sliceInputs, sliceOutputs, end - start);
+				silentChannels &= mVerb->getSilentChannels ();
+				start = end;
 			}
+			data.outputs[0].silenceFlags = silentChannels;
 		}
 	}
+	tailSamples.store (mVerb->getTailSamples (), std::memory_order_relaxed);
 }
 
 //------------------------------------------------------------------------
 tresult PLUGIN_API Processor::process (Vst::ProcessData& data)
 {
+	DenormalGuard denormalGuard;
+
+	// only the parameters with a queue are visited while processing, bypass is read once
+	numAutomated = 0;
 	if (data.inputParameterChanges)
 	{
 		auto numChanges = data.inputParameterChanges->getParameterCount ();
 		for (auto index = 0; index < numChanges; ++index)
 		{
 			if (auto queue = data.inputParameterChanges->getParameterData (index))
-				params[queue->getParameterId ()].beginChanges (queue);
+			{
+				auto paramIndex = static_cast<int32> (queue->getParameterId ());
+				params[paramIndex].beginChanges (queue);
+				if (paramIndex != BypassParamID && numAutomated < static_cast<int32> (automated.size ()))
+					automated[numAutomated++] = {queue, paramIndex, 0};
+			}
 		}
 	}
 
+	bool surround = std::holds_alternative<std::unique_ptr<FloatMVerbSurround>> (verb) ||
+	                std::holds_alternative<std::unique_ptr<DoubleMVerbSurround>> (verb);
 	if (data.symbolicSampleSize == Vst::SymbolicSampleSizes::kSample32)
-		processT<FloatMVerb, Vst::SymbolicSampleSizes::kSample32> (data);
+	{
+		if (surround)
+			processT<FloatMVerbSurround, Vst::SymbolicSampleSizes::kSample32> (data);
+		else
+			processT<FloatMVerbKernel, Vst::SymbolicSampleSizes::kSample32> (data);
+	}
 	else
-		processT<DoubleMVerb, Vst::SymbolicSampleSizes::kSample64> (data);
+	{
+		if (surround)
+			processT<DoubleMVerbSurround, Vst::SymbolicSampleSizes::kSample64> (data);
+		else
+			processT<MixedMVerbKernel, Vst::SymbolicSampleSizes::kSample64> (data);
+	}
 
-	std::for_each (params.begin (), params.end (), [] (auto& p) { p.endChanges (); });
+	for (auto index = 0; index < numAutomated; ++index)
+		params[automated[index].paramIndex].endChanges ();
+	params[BypassParamID].endChanges ();
 
 	return kResultOk;
 }
 
+//------------------------------------------------------------------------
+uint32 PLUGIN_API Processor::getTailSamples ()
+{
+	// the engine's state belongs to the audio thread, see tailSamples
+	return tailSamples.load (std::memory_order_relaxed);
+}
+
+//------------------------------------------------------------------------
+/** the stereo engines come from mverb-dispatch, built for isa */
+template<typename T>
+static std::unique_ptr<T> createVerb (MVerbIsa isa)
+{
+	if constexpr (std::is_same_v<T, FloatMVerbKernel>)
+		return MVerbCreateFloatKernel (isa);
+	else if constexpr (std::is_same_v<T, MixedMVerbKernel>)
+		return MVerbCreateMixedKernel (isa);
+	else
+		return std::make_unique<T> ();
+}
+
 //------------------------------------------------------------------------
 template<typename T>
-void Processor::setupProcessingT (Steinberg::Vst::ProcessSetup& newSetup)
+void Processor::setupProcessingT (Steinberg::Vst::ProcessSetup& newSetup,
+                                  Vst::SpeakerArrangement inputArrangement,
+                                  Vst::SpeakerArrangement outputArrangement, MVerbIsa isa)
 {
-	verb = std::make_unique<T> ();
+	auto mVerb = createVerb<T> (isa);
+	if constexpr (!std::is_same_v<T, FloatMVerbKernel> && !std::is_same_v<T, MixedMVerbKernel>)
+	{
+		int speakers[T::MaxChannels];
+		auto numChannels = Vst::SpeakerArr::getChannelCount (outputArrangement);
+		for (auto channel = 0; channel < numChannels; ++channel)
+			speakers[channel] =
+			    getSurroundSpeaker (Vst::SpeakerArr::getSpeaker (outputArrangement, channel));
+		mVerb->setLayout (speakers, numChannels);
+	}
+	else
+	{
+		mVerb->setChannels (Vst::SpeakerArr::getChannelCount (inputArrangement),
+		                    Vst::SpeakerArr::getChannelCount (outputArrangement));
+	}
 	std::for_each (params.begin (), params.end (), [&] (auto& p) {
-		std::get<std::unique_ptr<T>> (verb)->setParameter (p.getParamID (), p.getValue ());
+		mVerb->setParameter (p.getParamID (), p.getValue ());
 	});
-	std::get<std::unique_ptr<T>> (verb)->setSampleRate (newSetup.sampleRate);
+#if MVERB_REDUCED_RATE
+	if constexpr (std::is_same_v<T, FloatMVerbKernel> || std::is_same_v<T, MixedMVerbKernel>)
+	{
+		// above 88.2 kHz the tank and the early reflections run at half or a quarter of the rate,
+		// set along with the rate so the delay lines are allocated once
+		mVerb->setSampleRate (newSetup.sampleRate,
+		                      FloatMVerb::getDefaultRateDivider (newSetup.sampleRate), true);
+	}
+	else
+#endif
+		mVerb->setSampleRate (newSetup.sampleRate);
+	tailSamples.store (mVerb->getTailSamples (), std::memory_order_relaxed);
+	verb = std::move (mVerb);
 }
 
 //------------------------------------------------------------------------
 tresult PLUGIN_API Processor::setupProcessing (Vst::ProcessSetup& newSetup)
 {
 	//--- called before any processing ----
+	Vst::SpeakerArrangement input = Vst::SpeakerArr::kStereo;
+	Vst::SpeakerArrangement output = Vst::SpeakerArr::kStereo;
+	getBusArrangement (Vst::kInput, 0, input);
+	getBusArrangement (Vst::kOutput, 0, output);
+	bool surround = isSurroundArrangement (output);
+	// the instruction set of the stereo engine, the best one of the machine unless MVERB_ISA asks
+	// for a lower one
+	auto isa = MVerbSelectIsa ();
 	if (newSetup.symbolicSampleSize == Vst::SymbolicSampleSizes::kSample32)
 	{
-		setupProcessingT<FloatMVerb> (newSetup);
+		if (surround)
+			setupProcessingT<FloatMVerbSurround> (newSetup, input, output, isa);
+		else
+			setupProcessingT<FloatMVerbKernel> (newSetup, input, output, isa);
 	}
 	else
 	{
-		setupProcessingT<DoubleMVerb> (newSetup);
+		if (surround)
+			setupProcessingT<DoubleMVerbSurround> (newSetup, input, output, isa);
+		else
+			setupProcessingT<MixedMVerbKernel> (newSetup, input, output, isa);
 	}
 
 	return AudioEffect::setupProcessing (newSetup);
@@ -220,8 +398,18 @@ tresult PLUGIN_API Processor::setBusArrangements (Vst::SpeakerArrangement* input
                                                        Vst::SpeakerArrangement* outputs,
                                                        int32 numOuts)
 {
-	if (numIns != numOuts || numIns != 1 || inputs[0] != Vst::SpeakerArr::kStereo ||
-	    outputs[0] != Vst::SpeakerArr::kStereo)
+	// stereo, mono to stereo and mono run on MVerb, 5.1, 7.1 and 7.1.4 on MVerbSurround.
+	// Surround input and output are the same.
+	if (numIns != numOuts || numIns != 1)
+		return kResultFalse;
+	bool stereoOut = outputs[0] == Vst::SpeakerArr::kStereo;
+	bool monoOut = outputs[0] == Vst::SpeakerArr::kMono;
+	if (inputs[0] == Vst::SpeakerArr::kMono)
+	{
+		if (!stereoOut && !monoOut)
+			return kResultFalse;
+	}
+	else if (inputs[0] != outputs[0] || (!stereoOut && !isSurroundArrangement (inputs[0])))
 		return kResultFalse;
 	return AudioEffect::setBusArrangements (inputs, numIns, outputs, numOuts);
 }
@@ -20,6 +20,7 @@
 #include "public.sdk/source/vst/utility/sampleaccurate.h"
 #include "public.sdk/source/vst/utility/rttransfer.h"
 #include "shared.h"
+#include <atomic>
 #include <variant>
 #include <memory>
 
@@ -65,6 +66,9 @@ public:
 
 	/** Here we go...the process call */
 	Steinberg::tresult PLUGIN_API process (Steinberg::Vst::ProcessData& data) SMTG_OVERRIDE;
+
+	/** Length of the reverb tail at the current settings */
+	Steinberg::uint32 PLUGIN_API getTailSamples () SMTG_OVERRIDE;
 		
 	/** For persistence */
 	Steinberg::tresult PLUGIN_API setState (Steinberg::IBStream* state) SMTG_OVERRIDE;
@@ -73,20 +77,43 @@ public:
 //------------------------------------------------------------------------
 protected:
 	template<typename T>
-	void setupProcessingT (Steinberg::Vst::ProcessSetup& newSetup);
+	void setupProcessingT (Steinberg::Vst::ProcessSetup& newSetup,
+	                       Steinberg::Vst::SpeakerArrangement inputArrangement,
+	                       Steinberg::Vst::SpeakerArrangement outputArrangement, MVerbIsa isa);
 
 	template<typename T, Steinberg::Vst::SymbolicSampleSizes SampleSize>
 	void processT (Steinberg::Vst::ProcessData& data);
 	
 	using Parameter = Steinberg::Vst::SampleAccurate::Parameter;
 
+	// a parameter with a queue in the current process call
+	struct AutomatedParameter
+	{
+		Steinberg::Vst::IParamValueQueue* queue;
+		Steinberg::int32 paramIndex;
+		// the first point that may still lie after the current position
+		Steinberg::int32 nextPoint;
+	};
+
+	/** offset of the first point after position, numSamples if there is none */
+	static Steinberg::int32 nextPointOffset (AutomatedParameter& parameter, Steinberg::int32 position,
+	                                         Steinberg::int32 numSamples);
+
 	std::array<Parameter, FloatMVerb::NUM_PARAMS + 1> params;
-	std::variant<std::unique_ptr<FloatMVerb>, std::unique_ptr<DoubleMVerb>> verb;
+	std::array<AutomatedParameter, FloatMVerb::NUM_PARAMS> automated;
+	Steinberg::int32 numAutomated {0};
+	// the stereo engine for a stereo bus, the surround engine for all other arrangements. The
+	// stereo engine is FloatMVerb or MixedMVerb from mverb-dispatch, built for the instruction set
+	// of the machine.
+	std::variant<std::unique_ptr<FloatMVerbKernel>, std::unique_ptr<MixedMVerbKernel>,
+	             std::unique_ptr<FloatMVerbSurround>, std::unique_ptr<DoubleMVerbSurround>>
+	    verb;
 
 	using StateData = std::array<double, FloatMVerb::NUM_PARAMS + 1>;
 	Steinberg::Vst::RTTransferT<StateData> stateTransfer;
-
-	bool lastBlockWasSilent {false};
+	// the engine's tail, published by setupProcessing and by every process call for
+	// getTailSamples, which the host calls from another thread
+	std::atomic<Steinberg::uint32> tailSamples {0};
 };
 
 //------------------------------------------------------------------------
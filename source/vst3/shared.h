@@ -16,16 +16,21 @@
 
 #pragma once
 
-#include <cmath>
+#include "../MVerb.h"
+#include "../MVerbDispatch.h"
+#include "../MVerbSurround.h"
+
 #include <array>
 
 //------------------------------------------------------------------------
 namespace mverb {
 
-#include "../MVerb.h"
-
-using DoubleMVerb = MVerb<double>;
-using FloatMVerb = MVerb<float>;
+// 64 bit processing runs the float engine on double buffers, only the dry signal, the mix
+// and the filter integrators are computed in double
+using MixedMVerb = ::MVerb<float, ::MVerbNullProbe, ::WideStateVariable>;
+using FloatMVerb = ::MVerb<float>;
+using DoubleMVerbSurround = ::MVerbSurround<double>;
+using FloatMVerbSurround = ::MVerbSurround<float>;
 
 static constexpr int BypassParamID = FloatMVerb::NUM_PARAMS;
 